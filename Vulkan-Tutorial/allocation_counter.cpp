@@ -0,0 +1,31 @@
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Relaxed is enough, it's only ever read as a running total
+static std::atomic<uint64_t> heap_allocation_count{ 0 };
+
+uint64_t get_heap_allocation_count() {
+	return heap_allocation_count.load(std::memory_order_relaxed);
+}
+
+// The array and nothrow forms forward to these by default
+void* operator new(std::size_t size) {
+	heap_allocation_count.fetch_add(1, std::memory_order_relaxed);
+	void* memory = std::malloc(size != 0 ? size : 1);
+	if (memory == nullptr) {
+		throw std::bad_alloc();
+	}
+
+	return memory;
+}
+
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+	std::free(memory);
+}
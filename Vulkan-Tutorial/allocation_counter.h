@@ -0,0 +1,11 @@
+// Counts calls to the global operator new, which allocation_counter.cpp replaces, across every thread.
+// draw_frame takes the difference over each frame and benchmarks report it (see benchmark.h), so steady state
+// frames can be checked for heap allocations, including the ones made by job workers while they rasterize
+// occluders or record command buffers. Background threads that allocate during the frame, like the batch
+// encoders, are counted as well, so the count can only err on the high side. Aligned operator new isn't
+// counted, the only user is the host allocator (see host_allocator.h) which already pools it.
+
+#pragma once
+#include <cstdint>
+
+uint64_t get_heap_allocation_count();
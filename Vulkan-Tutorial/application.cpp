@@ -11,7 +11,7 @@ void run_application(HWND& hwnd, HINSTANCE& hinst) {
 	GLFWwindow* window = glfwCreateWindow(WIN_HEIGHT, WIN_WIDTH, "Vulkan", nullptr, nullptr);
 	*/
 
-	Vulkan vulkan = init_vulkan(hinst, hwnd);
+	Vulkan vulkan = init_vulkan(create_win32_platform(hinst, hwnd), Settings{});
 
 	// Message handling
 	MSG msg = { 0 };
@@ -39,7 +39,7 @@ void run_application(HWND& hwnd, HINSTANCE& hinst) {
 	glfwTerminate(); */
 
 	// cleanup Vulkan
-	vkDestroyDevice(vulkan.device, nullptr);
-	vkDestroySurfaceKHR(vulkan.instance, vulkan.surface, nullptr);
-	vkDestroyInstance(vulkan.instance, nullptr);
+	vkDestroyDevice(vulkan.device, get_host_allocator(HOST_ARENA_DEVICE));
+	vkDestroySurfaceKHR(vulkan.instance, vulkan.surface, get_host_allocator(HOST_ARENA_INSTANCE));
+	vkDestroyInstance(vulkan.instance, get_host_allocator(HOST_ARENA_INSTANCE));
 }
\ No newline at end of file
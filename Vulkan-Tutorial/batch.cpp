@@ -0,0 +1,285 @@
+#include "batch.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+#include "log.h"
+
+static bool has_memory_type(VkPhysicalDevice physical_device, VkMemoryPropertyFlags properties) {
+	VkPhysicalDeviceMemoryProperties mem_properties;
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_properties);
+
+	for (uint32_t i = 0; i < mem_properties.memoryTypeCount; ++i) {
+		if ((mem_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static std::string get_frame_path(const BatchRenderer& batch, uint32_t frame) {
+	std::ostringstream path;
+	path << batch.output_directory << "/frame_" << std::setw(5) << std::setfill('0') << frame << (batch.write_raw ? ".rgba" : ".png");
+
+	return path.str();
+}
+
+static void run_encoder(BatchRenderer* batch) {
+	set_profile_thread_name("Encoder");
+	while (true) {
+		EncodeJob job;
+		{
+			std::unique_lock<std::mutex> lock(batch->mutex);
+			batch->condition.wait(lock, [batch] { return batch->stopping || !batch->jobs.empty(); });
+			if (batch->jobs.empty()) {
+				return;
+			}
+
+			job = batch->jobs.front();
+			batch->jobs.pop_front();
+		}
+
+		// The slot belongs to this thread until encoding is cleared, so the mapped memory can be read unlocked
+		PROFILE_ZONE("encode frame");
+		const ReadbackSlot& slot = batch->slots[job.slot];
+		std::string path = get_frame_path(*batch, job.frame);
+		bool written = false;
+		if (batch->write_raw) {
+			std::ofstream file(path, std::ios::binary);
+			if (file.is_open()) {
+				file.write(static_cast<const char*>(slot.mapped), static_cast<std::streamsize>(batch->frame_size));
+				file.close(); // flushes, so a full disk shows up here rather than being lost in the destructor
+				written = !file.fail();
+			}
+		}
+		else {
+			int stride = static_cast<int>(batch->extent.width * 4);
+			written = stbi_write_png(path.c_str(), batch->extent.width, batch->extent.height, 4, slot.mapped, stride) != 0;
+		}
+		if (!written) {
+			LOG_RATE_LIMITED(LOG_LEVEL_ERROR, 5, "Failed to write %s", path.c_str());
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(batch->mutex);
+			batch->slots[job.slot].encoding = false;
+			if (written) {
+				batch->frames_written++;
+			}
+			else {
+				batch->frames_failed++;
+			}
+		}
+		batch->condition.notify_all();
+	}
+}
+
+void init_batch_renderer(BatchRenderer& batch, Vulkan& vulkan, const Settings& settings) {
+	// Better to stop here than to render the whole path and fail every write
+	std::error_code error;
+	std::filesystem::create_directories(settings.output_directory, error);
+	if (error || !std::filesystem::is_directory(settings.output_directory, error)) {
+		throw std::runtime_error("Failed to create output directory " + settings.output_directory + (error ? ": " + error.message() : ""));
+	}
+
+	batch.output_directory = settings.output_directory;
+	batch.write_raw = settings.output_raw;
+	batch.extent = vulkan.swap_chain_extent;
+	batch.frame_size = static_cast<VkDeviceSize>(batch.extent.width) * batch.extent.height * 4; // RGBA8, see create_offscreen_images
+
+	uint32_t encoder_count = std::clamp(std::thread::hardware_concurrency(), 2u, MAX_ENCODER_THREADS + 1) - 1; // leave the main thread its core
+	batch.command_pool = create_command_pool(vulkan.physical_device, vulkan.surface, vulkan.device, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+
+	// Cached memory makes the CPU reads in the encoders much faster, uncached is the fallback
+	VkMemoryPropertyFlags memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	if (!has_memory_type(vulkan.physical_device, memory_properties)) {
+		memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	}
+
+	// Enough slots that every encoder can be busy while the GPU is copying the next frames
+	batch.slots.resize(encoder_count + 2);
+	for (ReadbackSlot& slot : batch.slots) {
+		slot.buffer = create_vulkan_buffer(vulkan.device, vulkan.physical_device, batch.frame_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, memory_properties,
+			MEMORY_CATEGORY_READBACK, slot.memory);
+		vkMapMemory(vulkan.device, slot.memory, 0, batch.frame_size, 0, &slot.mapped);
+
+		VkCommandBufferAllocateInfo allocate_info{};
+		allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocate_info.commandPool = batch.command_pool;
+		allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocate_info.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(vulkan.device, &allocate_info, &slot.command_buffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate readback command buffer!");
+		}
+	}
+
+	for (uint32_t i = 0; i < encoder_count; ++i) {
+		batch.encoders.emplace_back(run_encoder, &batch);
+	}
+}
+
+// Copies the image draw_frame just rendered into the next slot of the ring
+void submit_readback(BatchRenderer& batch, Vulkan& vulkan, uint32_t frame) {
+	ReadbackSlot& slot = batch.slots[batch.next_slot];
+
+	// The ring has wrapped around, the previous frame in this slot has to be out of the way first
+	if (slot.copy_pending) {
+		wait_for_timeline_value(vulkan.device, vulkan.timeline, slot.timeline_value);
+		collect_readbacks(batch, vulkan, false);
+	}
+	{
+		std::unique_lock<std::mutex> lock(batch.mutex);
+		batch.condition.wait(lock, [&slot] { return !slot.encoding; });
+	}
+
+	VkImage image = vulkan.swap_chain_images[vulkan.last_image_index];
+	VkCommandBuffer command_buffer = slot.command_buffer;
+	vkResetCommandBuffer(command_buffer, 0);
+
+	VkCommandBufferBeginInfo begin_info{};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(command_buffer, &begin_info);
+
+	// The upscale left the image in TRANSFER_SRC, this only orders the copy after its writes
+	VkImageMemoryBarrier image_barrier{};
+	image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	image_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	image_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	image_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	image_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	image_barrier.image = image;
+	image_barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	image_barrier.subresourceRange.baseMipLevel = 0;
+	image_barrier.subresourceRange.levelCount = 1;
+	image_barrier.subresourceRange.baseArrayLayer = 0;
+	image_barrier.subresourceRange.layerCount = 1;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &image_barrier);
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0; // tightly packed
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { batch.extent.width, batch.extent.height, 1 };
+	vkCmdCopyImageToBuffer(command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &region);
+
+	// Make the copy visible to the host, and keep the next render into this image from overwriting it mid copy
+	VkBufferMemoryBarrier host_barrier{};
+	host_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	host_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	host_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	host_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	host_barrier.buffer = slot.buffer;
+	host_barrier.offset = 0;
+	host_barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr, 1, &host_barrier, 0, nullptr);
+
+	slot.timeline_value = submit_single_time_commands(command_buffer, vulkan.graphics_queue, vulkan.timeline);
+	slot.frame = frame;
+	slot.copy_pending = true;
+	batch.next_slot = (batch.next_slot + 1) % batch.slots.size();
+}
+
+// Hands every slot whose copy has finished to the encoders, in frame order
+void collect_readbacks(BatchRenderer& batch, Vulkan& vulkan, bool wait_for_all) {
+	uint64_t completed_value = get_completed_timeline_value(vulkan.device, vulkan.timeline);
+	for (uint32_t i = 0; i < batch.slots.size(); ++i) {
+		// Oldest first, starting from the slot that will be reused next
+		uint32_t slot_index = (batch.next_slot + i) % batch.slots.size();
+		ReadbackSlot& slot = batch.slots[slot_index];
+		if (!slot.copy_pending) {
+			continue;
+		}
+
+		if (slot.timeline_value > completed_value) {
+			if (!wait_for_all) {
+				break;
+			}
+			wait_for_timeline_value(vulkan.device, vulkan.timeline, slot.timeline_value);
+		}
+
+		// Harmless on coherent memory, required on cached memory that isn't
+		VkMappedMemoryRange range{};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = slot.memory;
+		range.offset = 0;
+		range.size = VK_WHOLE_SIZE;
+		vkInvalidateMappedMemoryRanges(vulkan.device, 1, &range);
+
+		slot.copy_pending = false;
+		{
+			std::lock_guard<std::mutex> lock(batch.mutex);
+			slot.encoding = true;
+			batch.jobs.push_back(EncodeJob{ slot_index, slot.frame });
+		}
+		batch.condition.notify_all();
+	}
+
+	if (wait_for_all) {
+		std::unique_lock<std::mutex> lock(batch.mutex);
+		batch.condition.wait(lock, [&batch] {
+			for (const ReadbackSlot& slot : batch.slots) {
+				if (slot.encoding) {
+					return false;
+				}
+			}
+			return true;
+		});
+	}
+}
+
+void shutdown_batch_renderer(BatchRenderer& batch, Vulkan& vulkan) {
+	collect_readbacks(batch, vulkan, true);
+	{
+		std::lock_guard<std::mutex> lock(batch.mutex);
+		batch.stopping = true;
+	}
+	batch.condition.notify_all();
+	for (std::thread& encoder : batch.encoders) {
+		encoder.join();
+	}
+
+	for (ReadbackSlot& slot : batch.slots) {
+		vkUnmapMemory(vulkan.device, slot.memory);
+		vkDestroyBuffer(vulkan.device, slot.buffer, get_host_allocator(HOST_ARENA_BUFFER));
+		free_device_memory(vulkan.device, slot.memory);
+	}
+	vkDestroyCommandPool(vulkan.device, batch.command_pool, get_host_allocator(HOST_ARENA_COMMAND));
+
+	LOG_INFO("Wrote %llu frames to %s", static_cast<unsigned long long>(batch.frames_written), batch.output_directory.c_str());
+	if (batch.frames_failed > 0) {
+		LOG_ERROR("Failed to write %llu frames", static_cast<unsigned long long>(batch.frames_failed));
+	}
+}
+
+// One camera position per line
+std::vector<double> load_camera_script(const std::string& path) {
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open camera script " + path);
+	}
+
+	std::vector<double> positions;
+	double position;
+	while (file >> position) {
+		positions.push_back(position);
+	}
+
+	return positions;
+}
@@ -0,0 +1,60 @@
+// Offline rendering of a scripted camera path to image files. After each headless frame the rendered
+// image is copied into one of a ring of host visible buffers, and once the copy has finished the buffer
+// is handed to an encoder thread that writes it out. Encoding overlaps with rendering of the following
+// frames and a buffer is only waited on when the ring wraps around to it, so as long as there are enough
+// slots and encoders the GPU sets the pace.
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "vulkan.h"
+
+const uint32_t MAX_ENCODER_THREADS = 8;
+
+struct ReadbackSlot {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	void* mapped = nullptr;
+	VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+	uint64_t timeline_value = 0; // signaled when the copy into this slot has finished
+	uint32_t frame = 0;
+	bool copy_pending = false; // submitted, not yet handed to an encoder
+	bool encoding = false; // owned by an encoder thread, guarded by BatchRenderer::mutex
+};
+
+struct EncodeJob {
+	uint32_t slot;
+	uint32_t frame;
+};
+
+// Not copyable because of the mutex, so it is set up in place with init_batch_renderer
+struct BatchRenderer {
+	std::string output_directory;
+	bool write_raw = false;
+	VkExtent2D extent;
+	VkDeviceSize frame_size = 0;
+
+	VkCommandPool command_pool = VK_NULL_HANDLE;
+	std::vector<ReadbackSlot> slots;
+	uint32_t next_slot = 0;
+
+	std::vector<std::thread> encoders;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<EncodeJob> jobs;
+	bool stopping = false;
+	uint64_t frames_written = 0; // only frames that made it to disk
+	uint64_t frames_failed = 0;
+};
+
+void init_batch_renderer(BatchRenderer& batch, Vulkan& vulkan, const Settings& settings);
+void submit_readback(BatchRenderer& batch, Vulkan& vulkan, uint32_t frame);
+void collect_readbacks(BatchRenderer& batch, Vulkan& vulkan, bool wait_for_all);
+void shutdown_batch_renderer(BatchRenderer& batch, Vulkan& vulkan);
+std::vector<double> load_camera_script(const std::string& path);
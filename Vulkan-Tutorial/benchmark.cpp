@@ -0,0 +1,151 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+#include "log.h"
+
+double get_benchmark_camera_position(uint32_t frame) {
+	return 2.5 + 0.5 * std::sin(frame * 0.01);
+}
+
+Benchmark create_benchmark(uint32_t warmup_frames, uint32_t measured_frames) {
+	Benchmark benchmark;
+	benchmark.warmup_frames = warmup_frames;
+	benchmark.measured_frames = measured_frames;
+	benchmark.frames.reserve(measured_frames);
+
+	return benchmark;
+}
+
+// Returns true once all measured frames have been recorded
+bool record_benchmark_frame(Benchmark& benchmark, const FrameTimings& timings) {
+	benchmark.frames_seen++;
+	if (benchmark.frames_seen > benchmark.warmup_frames && benchmark.frames.size() < benchmark.measured_frames) {
+		benchmark.frames.push_back(timings);
+	}
+
+	return benchmark.frames.size() >= benchmark.measured_frames;
+}
+
+TimingSummary summarize_timings(std::vector<double> seconds) {
+	TimingSummary summary;
+	if (seconds.empty()) {
+		return summary;
+	}
+
+	std::sort(seconds.begin(), seconds.end());
+	double sum = 0.0;
+	for (double value : seconds) {
+		sum += value;
+	}
+
+	// Nearest rank
+	auto percentile = [&seconds](double p) {
+		size_t rank = static_cast<size_t>(std::ceil(p * seconds.size()));
+		return seconds[std::clamp(rank, static_cast<size_t>(1), seconds.size()) - 1];
+	};
+
+	summary.min = seconds.front();
+	summary.mean = sum / seconds.size();
+	summary.p50 = percentile(0.50);
+	summary.p95 = percentile(0.95);
+	summary.p99 = percentile(0.99);
+
+	return summary;
+}
+
+const char* get_frame_phase_name(FramePhase phase) {
+	switch (phase) {
+	case FRAME_PHASE_WAIT:
+		return "wait";
+	case FRAME_PHASE_ACQUIRE:
+		return "acquire";
+	case FRAME_PHASE_UPDATE:
+		return "update";
+	case FRAME_PHASE_CULL:
+		return "cull";
+	case FRAME_PHASE_RECORD:
+		return "record";
+	case FRAME_PHASE_SUBMIT:
+		return "submit";
+	case FRAME_PHASE_PRESENT:
+		return "present";
+	default:
+		return "unknown";
+	}
+}
+
+// Prints the summary and, given a report path, writes <path>.csv with every measured frame and
+// <path>.json with the summary. All times are in milliseconds
+void report_benchmark(const Benchmark& benchmark, const std::string& report_path) {
+	std::array<TimingSummary, FRAME_PHASE_COUNT> phase_summaries;
+	for (uint32_t phase = 0; phase < FRAME_PHASE_COUNT; ++phase) {
+		std::vector<double> seconds;
+		seconds.reserve(benchmark.frames.size());
+		for (const FrameTimings& frame : benchmark.frames) {
+			seconds.push_back(frame.phase_seconds[phase]);
+		}
+		phase_summaries[phase] = summarize_timings(seconds);
+	}
+
+	std::vector<double> total_seconds;
+	total_seconds.reserve(benchmark.frames.size());
+	for (const FrameTimings& frame : benchmark.frames) {
+		total_seconds.push_back(frame.total_seconds);
+	}
+	TimingSummary total_summary = summarize_timings(total_seconds);
+
+	// Steady state frames should make none
+	uint64_t heap_allocations = 0;
+	uint64_t max_frame_heap_allocations = 0;
+	uint32_t allocating_frames = 0;
+	for (const FrameTimings& frame : benchmark.frames) {
+		heap_allocations += frame.heap_allocations;
+		max_frame_heap_allocations = std::max(max_frame_heap_allocations, frame.heap_allocations);
+		allocating_frames += frame.heap_allocations > 0 ? 1 : 0;
+	}
+
+	std::cout << "Benchmark, " << benchmark.frames.size() << " frames after " << benchmark.warmup_frames << " warm-up (phase / min / mean / p50 / p95 / p99 ms):\n";
+	for (uint32_t phase = 0; phase <= FRAME_PHASE_COUNT; ++phase) {
+		const TimingSummary& summary = phase < FRAME_PHASE_COUNT ? phase_summaries[phase] : total_summary;
+		const char* name = phase < FRAME_PHASE_COUNT ? get_frame_phase_name(static_cast<FramePhase>(phase)) : "total";
+		std::cout << '\t' << name << " / " << summary.min * 1000.0 << " / " << summary.mean * 1000.0 << " / " << summary.p50 * 1000.0
+			<< " / " << summary.p95 * 1000.0 << " / " << summary.p99 * 1000.0 << '\n';
+	}
+	std::cout << "Heap allocations during frames: " << heap_allocations << " in " << allocating_frames << " of " << benchmark.frames.size()
+		<< " frames, at most " << max_frame_heap_allocations << " in one frame\n";
+
+	if (report_path.empty()) {
+		return;
+	}
+
+	std::ofstream csv(report_path + ".csv");
+	csv << "frame";
+	for (uint32_t phase = 0; phase < FRAME_PHASE_COUNT; ++phase) {
+		csv << ',' << get_frame_phase_name(static_cast<FramePhase>(phase));
+	}
+	csv << ",total,heap_allocations\n";
+	for (size_t i = 0; i < benchmark.frames.size(); ++i) {
+		csv << i;
+		for (double seconds : benchmark.frames[i].phase_seconds) {
+			csv << ',' << seconds * 1000.0;
+		}
+		csv << ',' << benchmark.frames[i].total_seconds * 1000.0 << ',' << benchmark.frames[i].heap_allocations << '\n';
+	}
+
+	std::ofstream json(report_path + ".json");
+	json << "{\n\t\"warmup_frames\": " << benchmark.warmup_frames << ",\n\t\"measured_frames\": " << benchmark.frames.size() << ",\n\t\"phases_ms\": {\n";
+	for (uint32_t phase = 0; phase <= FRAME_PHASE_COUNT; ++phase) {
+		const TimingSummary& summary = phase < FRAME_PHASE_COUNT ? phase_summaries[phase] : total_summary;
+		const char* name = phase < FRAME_PHASE_COUNT ? get_frame_phase_name(static_cast<FramePhase>(phase)) : "total";
+		json << "\t\t\"" << name << "\": { \"min\": " << summary.min * 1000.0 << ", \"mean\": " << summary.mean * 1000.0 << ", \"p50\": " << summary.p50 * 1000.0
+			<< ", \"p95\": " << summary.p95 * 1000.0 << ", \"p99\": " << summary.p99 * 1000.0 << " }" << (phase < FRAME_PHASE_COUNT ? "," : "") << '\n';
+	}
+	json << "\t},\n\t\"heap_allocations\": { \"total\": " << heap_allocations << ", \"allocating_frames\": " << allocating_frames
+		<< ", \"max_per_frame\": " << max_frame_heap_allocations << " }\n}\n";
+
+	LOG_INFO("Wrote %s.csv and %s.json", report_path.c_str(), report_path.c_str());
+}
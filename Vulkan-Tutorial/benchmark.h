@@ -0,0 +1,49 @@
+// Frame time benchmark. draw_frame times each of its phases on the CPU, the benchmark drops a number of
+// warm-up frames, collects the rest and reports min/mean/p50/p95/p99 per phase, plus how many heap allocations
+// the measured frames made. The camera follows a fixed path so runs are comparable. Deliberately has no Vulkan
+// dependency.
+
+#pragma once
+#include <cstdint>
+#include <array>
+#include <string>
+#include <vector>
+
+enum FramePhase {
+	FRAME_PHASE_WAIT, // frame slot wait and deletion queue
+	FRAME_PHASE_ACQUIRE,
+	FRAME_PHASE_UPDATE, // uniform buffer
+	FRAME_PHASE_CULL,
+	FRAME_PHASE_RECORD,
+	FRAME_PHASE_SUBMIT,
+	FRAME_PHASE_PRESENT,
+	FRAME_PHASE_COUNT
+};
+
+struct FrameTimings {
+	std::array<double, FRAME_PHASE_COUNT> phase_seconds{};
+	double total_seconds = 0.0;
+	uint64_t heap_allocations = 0; // operator new calls on any thread during draw_frame, see allocation_counter.h
+};
+
+struct Benchmark {
+	uint32_t warmup_frames = 0;
+	uint32_t measured_frames = 0;
+	uint32_t frames_seen = 0;
+	std::vector<FrameTimings> frames;
+};
+
+struct TimingSummary {
+	double min = 0.0;
+	double mean = 0.0;
+	double p50 = 0.0;
+	double p95 = 0.0;
+	double p99 = 0.0;
+};
+
+double get_benchmark_camera_position(uint32_t frame);
+Benchmark create_benchmark(uint32_t warmup_frames, uint32_t measured_frames);
+bool record_benchmark_frame(Benchmark& benchmark, const FrameTimings& timings);
+TimingSummary summarize_timings(std::vector<double> seconds);
+void report_benchmark(const Benchmark& benchmark, const std::string& report_path);
+const char* get_frame_phase_name(FramePhase phase);
@@ -0,0 +1,19 @@
+#include "camera.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// The model spins around z
+glm::quat get_model_rotation(float time) {
+	return glm::angleAxis(time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+}
+
+// The camera looks at the origin from the (cam_position, cam_position, cam_position) diagonal
+UniformBufferObject build_uniform_buffer_object(const glm::mat4& model, float aspect_ratio, double cam_position) {
+	UniformBufferObject ubo{};
+	ubo.model = model;
+	ubo.view = glm::lookAt(glm::vec3(cam_position, cam_position, cam_position), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	ubo.proj = glm::perspective(glm::radians(45.0f), aspect_ratio, 0.1f, 10.0f);
+	ubo.proj[1][1] *= -1; // GLM was written for OpenGL, where clip space y points up
+
+	return ubo;
+}
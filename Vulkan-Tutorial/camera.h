@@ -0,0 +1,15 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+struct UniformBufferObject {
+	glm::mat4 model;
+	glm::mat4 view;
+	glm::mat4 proj;
+};
+
+glm::quat get_model_rotation(float time);
+UniformBufferObject build_uniform_buffer_object(const glm::mat4& model, float aspect_ratio, double cam_position);
@@ -0,0 +1,92 @@
+#include "deletion_queue.h"
+
+#include "host_allocator.h"
+#include "memory_tracker.h"
+
+static PendingDeletion& push_deletion(DeletionQueue& queue, const Timeline& timeline, DeletionType type) {
+	PendingDeletion deletion{};
+	deletion.timeline_value = timeline.last_submitted_value;
+	deletion.type = type;
+	queue.pending.push_back(deletion);
+
+	return queue.pending.back();
+}
+
+void defer_destroy_swap_chain(DeletionQueue& queue, const Timeline& timeline, VkSwapchainKHR swap_chain) {
+	push_deletion(queue, timeline, DELETION_SWAP_CHAIN).swap_chain = swap_chain;
+}
+
+void defer_destroy_framebuffer(DeletionQueue& queue, const Timeline& timeline, VkFramebuffer framebuffer) {
+	push_deletion(queue, timeline, DELETION_FRAMEBUFFER).framebuffer = framebuffer;
+}
+
+void defer_destroy_image_view(DeletionQueue& queue, const Timeline& timeline, VkImageView image_view) {
+	push_deletion(queue, timeline, DELETION_IMAGE_VIEW).image_view = image_view;
+}
+
+void defer_destroy_image(DeletionQueue& queue, const Timeline& timeline, VkImage image) {
+	push_deletion(queue, timeline, DELETION_IMAGE).image = image;
+}
+
+void defer_free_memory(DeletionQueue& queue, const Timeline& timeline, VkDeviceMemory memory) {
+	push_deletion(queue, timeline, DELETION_MEMORY).memory = memory;
+}
+
+void defer_destroy_buffer(DeletionQueue& queue, const Timeline& timeline, VkBuffer buffer) {
+	push_deletion(queue, timeline, DELETION_BUFFER).buffer = buffer;
+}
+
+void defer_destroy_pipeline(DeletionQueue& queue, const Timeline& timeline, VkPipeline pipeline) {
+	push_deletion(queue, timeline, DELETION_PIPELINE).pipeline = pipeline;
+}
+
+// The pool must only be used from the thread that processes the queue
+void defer_free_command_buffer(DeletionQueue& queue, const Timeline& timeline, VkCommandPool command_pool, VkCommandBuffer command_buffer) {
+	PendingDeletion& deletion = push_deletion(queue, timeline, DELETION_COMMAND_BUFFER);
+	deletion.command_buffer.pool = command_pool;
+	deletion.command_buffer.buffer = command_buffer;
+}
+
+static void destroy_pending(VkDevice device, const PendingDeletion& deletion) {
+	switch (deletion.type) {
+	case DELETION_SWAP_CHAIN:
+		vkDestroySwapchainKHR(device, deletion.swap_chain, get_host_allocator(HOST_ARENA_SWAP_CHAIN));
+		break;
+	case DELETION_FRAMEBUFFER:
+		vkDestroyFramebuffer(device, deletion.framebuffer, get_host_allocator(HOST_ARENA_FRAMEBUFFER));
+		break;
+	case DELETION_IMAGE_VIEW:
+		vkDestroyImageView(device, deletion.image_view, get_host_allocator(HOST_ARENA_IMAGE));
+		break;
+	case DELETION_IMAGE:
+		vkDestroyImage(device, deletion.image, get_host_allocator(HOST_ARENA_IMAGE));
+		break;
+	case DELETION_MEMORY:
+		free_device_memory(device, deletion.memory);
+		break;
+	case DELETION_BUFFER:
+		vkDestroyBuffer(device, deletion.buffer, get_host_allocator(HOST_ARENA_BUFFER));
+		break;
+	case DELETION_PIPELINE:
+		vkDestroyPipeline(device, deletion.pipeline, get_host_allocator(HOST_ARENA_PIPELINE));
+		break;
+	case DELETION_COMMAND_BUFFER:
+		vkFreeCommandBuffers(device, deletion.command_buffer.pool, 1, &deletion.command_buffer.buffer);
+		break;
+	}
+}
+
+void process_deletion_queue(DeletionQueue& queue, VkDevice device, uint64_t completed_value) {
+	while (!queue.pending.empty() && queue.pending.front().timeline_value <= completed_value) {
+		destroy_pending(device, queue.pending.front());
+		queue.pending.pop_front();
+	}
+}
+
+// Only for shutdown, once the device is idle
+void flush_deletion_queue(DeletionQueue& queue, VkDevice device) {
+	for (const PendingDeletion& deletion : queue.pending) {
+		destroy_pending(device, deletion);
+	}
+	queue.pending.clear();
+}
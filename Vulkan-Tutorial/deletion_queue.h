@@ -0,0 +1,57 @@
+// Vulkan objects that have been replaced or unloaded but may still be in use by submitted work. Each one is
+// tagged with the timeline value of the newest submission at the time it was retired and destroyed once the
+// timeline reaches that value, so replacing something (a resized swap chain, a reloaded model, a staging
+// buffer whose upload is still running) never has to wait for the GPU.
+
+#pragma once
+#include <cstdint>
+#include <deque>
+
+#include <vulkan/vulkan.h>
+
+#include "timeline.h"
+
+enum DeletionType {
+	DELETION_SWAP_CHAIN,
+	DELETION_FRAMEBUFFER,
+	DELETION_IMAGE_VIEW,
+	DELETION_IMAGE,
+	DELETION_MEMORY,
+	DELETION_BUFFER,
+	DELETION_PIPELINE,
+	DELETION_COMMAND_BUFFER
+};
+
+struct PendingDeletion {
+	uint64_t timeline_value;
+	DeletionType type;
+	union {
+		VkSwapchainKHR swap_chain;
+		VkFramebuffer framebuffer;
+		VkImageView image_view;
+		VkImage image;
+		VkDeviceMemory memory;
+		VkBuffer buffer;
+		VkPipeline pipeline;
+		struct {
+			VkCommandPool pool;
+			VkCommandBuffer buffer;
+		} command_buffer;
+	};
+};
+
+struct DeletionQueue {
+	std::deque<PendingDeletion> pending; // in retirement order, so timeline values never decrease
+};
+
+// Retired at the timeline's last submitted value, i.e. after everything already submitted has finished
+void defer_destroy_swap_chain(DeletionQueue& queue, const Timeline& timeline, VkSwapchainKHR swap_chain);
+void defer_destroy_framebuffer(DeletionQueue& queue, const Timeline& timeline, VkFramebuffer framebuffer);
+void defer_destroy_image_view(DeletionQueue& queue, const Timeline& timeline, VkImageView image_view);
+void defer_destroy_image(DeletionQueue& queue, const Timeline& timeline, VkImage image);
+void defer_free_memory(DeletionQueue& queue, const Timeline& timeline, VkDeviceMemory memory);
+void defer_destroy_buffer(DeletionQueue& queue, const Timeline& timeline, VkBuffer buffer);
+void defer_destroy_pipeline(DeletionQueue& queue, const Timeline& timeline, VkPipeline pipeline);
+void defer_free_command_buffer(DeletionQueue& queue, const Timeline& timeline, VkCommandPool command_pool, VkCommandBuffer command_buffer);
+void process_deletion_queue(DeletionQueue& queue, VkDevice device, uint64_t completed_value);
+void flush_deletion_queue(DeletionQueue& queue, VkDevice device);
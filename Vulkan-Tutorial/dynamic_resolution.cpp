@@ -0,0 +1,86 @@
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+static float quantize_scale(const DynamicResolution& resolution, float scale) {
+	float steps = std::floor(scale / DYNAMIC_RESOLUTION_SCALE_STEP + 0.5f);
+	return std::clamp(steps * DYNAMIC_RESOLUTION_SCALE_STEP, resolution.min_scale, resolution.max_scale);
+}
+
+DynamicResolution create_dynamic_resolution(uint32_t target_frame_rate, float min_scale, float max_scale) {
+	DynamicResolution resolution;
+	resolution.max_scale = std::clamp(max_scale, DYNAMIC_RESOLUTION_SCALE_STEP, 1.0f);
+	resolution.min_scale = std::clamp(min_scale, DYNAMIC_RESOLUTION_SCALE_STEP, resolution.max_scale);
+	resolution.enabled = target_frame_rate > 0 && resolution.min_scale < resolution.max_scale;
+	resolution.target_gpu_seconds = target_frame_rate > 0 ? 1.0 / target_frame_rate : 0.0;
+	resolution.scale = resolution.max_scale;
+	resolution.lowest_scale = resolution.scale;
+
+	return resolution;
+}
+
+bool update_dynamic_resolution(DynamicResolution& resolution, double gpu_seconds) {
+	if (!resolution.enabled) {
+		return false;
+	}
+
+	resolution.frames_since_change++;
+	if (resolution.frames_since_change <= DYNAMIC_RESOLUTION_SETTLE_FRAMES) {
+		return false;
+	}
+	resolution.window_gpu_seconds += gpu_seconds;
+	resolution.window_frame_count++;
+	if (resolution.window_frame_count < DYNAMIC_RESOLUTION_WINDOW_FRAMES) {
+		return false;
+	}
+
+	double mean_gpu_seconds = resolution.window_gpu_seconds / resolution.window_frame_count;
+	resolution.window_gpu_seconds = 0.0;
+	resolution.window_frame_count = 0;
+	bool over_budget = mean_gpu_seconds > resolution.target_gpu_seconds;
+	bool under_budget = mean_gpu_seconds < resolution.target_gpu_seconds * DYNAMIC_RESOLUTION_UPSCALE_THRESHOLD;
+	if (!over_budget && !under_budget) {
+		return false;
+	}
+
+	// Down as far as the estimate says in one go, since every frame over budget is a dropped frame, but only
+	// up a step at a time since the estimate is least reliable at the small scales it is coming up from
+	float ideal_scale = resolution.scale * static_cast<float>(std::sqrt(resolution.target_gpu_seconds * DYNAMIC_RESOLUTION_HEADROOM / std::max(mean_gpu_seconds, 1e-6)));
+	float new_scale = over_budget ? quantize_scale(resolution, std::min(ideal_scale, resolution.scale - DYNAMIC_RESOLUTION_SCALE_STEP))
+		: quantize_scale(resolution, std::min(ideal_scale, resolution.scale + DYNAMIC_RESOLUTION_SCALE_STEP));
+	if (new_scale == resolution.scale) {
+		return false;
+	}
+
+	resolution.scale = new_scale;
+	resolution.frames_since_change = 0;
+	resolution.change_count++;
+	resolution.lowest_scale = std::min(resolution.lowest_scale, new_scale);
+	return true;
+}
+
+IVec2 get_render_size(const DynamicResolution& resolution, IVec2 full_size) {
+	IVec2 size;
+	size.x = std::clamp(static_cast<uint32_t>(full_size.x * resolution.scale + 0.5f), 1u, std::max(full_size.x, 1u));
+	size.y = std::clamp(static_cast<uint32_t>(full_size.y * resolution.scale + 0.5f), 1u, std::max(full_size.y, 1u));
+
+	return size;
+}
+
+void record_dynamic_resolution_frame(DynamicResolution& resolution) {
+	resolution.frame_count++;
+	resolution.scale_sum += resolution.scale;
+}
+
+void report_dynamic_resolution(const DynamicResolution& resolution) {
+	if (!resolution.enabled) {
+		std::cout << "Render scale: " << resolution.max_scale << " (fixed)\n";
+		return;
+	}
+
+	double mean_scale = resolution.frame_count > 0 ? resolution.scale_sum / resolution.frame_count : resolution.scale;
+	std::cout << "Dynamic resolution, " << resolution.target_gpu_seconds * 1000.0 << " ms GPU budget (mean scale / lowest / final / changes): "
+		<< mean_scale << " / " << resolution.lowest_scale << " / " << resolution.scale << " / " << resolution.change_count << '\n';
+}
@@ -0,0 +1,46 @@
+// Dynamic resolution. The scene is drawn into the top left part of an offscreen target and then scaled up
+// to the swap chain image, and the size of that part is picked from how long the GPU took over recent
+// frames. GPU time is taken to grow with the pixel count, so the scale moves by the square root of how far
+// the measured time is off the frame budget. Changes are quantized to whole steps and only made once a
+// window of frames rendered at the current scale has been measured, and the scale only goes back up once
+// there's clear headroom, so it doesn't flip between two steps every other frame. Each change costs a re-record
+// of the cached command buffers, which is another reason to keep them rare.
+// Deliberately has no Vulkan dependency.
+
+#pragma once
+#include <cstdint>
+
+#include "vec2.h"
+
+const float DYNAMIC_RESOLUTION_SCALE_STEP = 1.0f / 16.0f;
+const uint32_t DYNAMIC_RESOLUTION_SETTLE_FRAMES = 8; // ignored after a change, they may have been recorded at the old scale
+const uint32_t DYNAMIC_RESOLUTION_WINDOW_FRAMES = 16; // averaged before deciding on a change
+const double DYNAMIC_RESOLUTION_HEADROOM = 0.9; // aim for this fraction of the budget when changing
+const double DYNAMIC_RESOLUTION_UPSCALE_THRESHOLD = 0.7; // only scale up when the window took less than this fraction
+
+struct DynamicResolution {
+	bool enabled = false; // when off the scale stays at max_scale
+	double target_gpu_seconds = 0.0;
+	float min_scale = 1.0f;
+	float max_scale = 1.0f;
+	float scale = 1.0f;
+
+	uint32_t frames_since_change = 0;
+	double window_gpu_seconds = 0.0;
+	uint32_t window_frame_count = 0;
+
+	// For the report
+	uint64_t frame_count = 0;
+	double scale_sum = 0.0;
+	float lowest_scale = 1.0f;
+	uint32_t change_count = 0;
+};
+
+// A target frame rate of 0 renders at max_scale all the time
+DynamicResolution create_dynamic_resolution(uint32_t target_frame_rate, float min_scale, float max_scale);
+// Takes the GPU time of one completed frame, returns true when the scale changed
+bool update_dynamic_resolution(DynamicResolution& resolution, double gpu_seconds);
+// Never zero, and never larger than full_size
+IVec2 get_render_size(const DynamicResolution& resolution, IVec2 full_size);
+void record_dynamic_resolution_frame(DynamicResolution& resolution);
+void report_dynamic_resolution(const DynamicResolution& resolution);
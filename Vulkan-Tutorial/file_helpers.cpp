@@ -1,5 +1,7 @@
 #include "file_helpers.h"
 
+#include <stdexcept>
+
 std::vector<char> read_file(const std::string& filename) {
     std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
@@ -0,0 +1,43 @@
+#include "frame_arena.h"
+
+#include <new>
+
+FrameArena create_frame_arena(size_t capacity) {
+	FrameArena arena;
+	arena.memory.resize(capacity);
+
+	return arena;
+}
+
+void* allocate_from_frame_arena(FrameArena& arena, size_t size, size_t alignment) {
+	arena.frame_bytes += size + alignment - 1;
+
+	uintptr_t base = reinterpret_cast<uintptr_t>(arena.memory.data());
+	uintptr_t aligned = (base + arena.offset + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+	size_t start = static_cast<size_t>(aligned - base);
+	if (start + size <= arena.memory.size()) {
+		arena.offset = start + size;
+		return arena.memory.data() + start;
+	}
+
+	// Out of room for this frame. Over-allocated so it can be aligned by hand and freed without knowing the alignment
+	char* memory = static_cast<char*>(::operator new(size + alignment - 1));
+	arena.overflow.push_back(memory);
+	arena.overflow_count++;
+
+	return reinterpret_cast<void*>((reinterpret_cast<uintptr_t>(memory) + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1));
+}
+
+void reset_frame_arena(FrameArena& arena) {
+	for (void* memory : arena.overflow) {
+		::operator delete(memory);
+	}
+	arena.overflow.clear();
+
+	// Sized for the busiest frame so far, with some headroom so a slowly growing frame doesn't reallocate every time
+	if (arena.frame_bytes > arena.memory.size()) {
+		arena.memory = std::vector<char>(arena.frame_bytes + arena.frame_bytes / 4);
+	}
+	arena.offset = 0;
+	arena.frame_bytes = 0;
+}
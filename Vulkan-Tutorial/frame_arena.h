@@ -0,0 +1,57 @@
+// Bump allocator for memory that only lives for one frame. There is one arena per frame slot, reset in
+// draw_frame once the slot's timeline value has been reached. Allocating is a pointer bump and freeing
+// individual allocations does nothing, everything goes at once on reset. A frame that runs past the end
+// falls back to the heap for the rest of it and the arena grows on the next reset, so after the first few
+// frames the frame path allocates nothing (see allocation_counter.h). Only used from the thread running
+// draw_frame, and deliberately has no Vulkan dependency.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+const size_t FRAME_ARENA_CAPACITY = 64 * 1024;
+
+struct FrameArena {
+	std::vector<char> memory;
+	size_t offset = 0;
+	size_t frame_bytes = 0; // requested since the last reset, with worst case alignment padding
+	std::vector<void*> overflow; // heap allocations made once the arena ran out, freed on reset
+	uint64_t overflow_count = 0;
+};
+
+FrameArena create_frame_arena(size_t capacity);
+void* allocate_from_frame_arena(FrameArena& arena, size_t size, size_t alignment);
+void reset_frame_arena(FrameArena& arena);
+
+// Lets standard containers allocate from an arena, e.g. ArenaVector<uint32_t> visible(arena)
+template<typename T>
+struct ArenaAllocator {
+	using value_type = T;
+
+	FrameArena* arena;
+
+	ArenaAllocator(FrameArena& arena) : arena(&arena) {}
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+	T* allocate(size_t count) {
+		return static_cast<T*>(allocate_from_frame_arena(*arena, count * sizeof(T), alignof(T)));
+	}
+
+	// Released by reset_frame_arena
+	void deallocate(T*, size_t) {}
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+	return a.arena == b.arena;
+}
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+	return a.arena != b.arena;
+}
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
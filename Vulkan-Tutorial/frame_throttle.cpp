@@ -0,0 +1,154 @@
+#include "frame_throttle.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <timeapi.h>
+#else
+#include <time.h>
+#endif
+
+FrameThrottle create_frame_throttle(uint32_t max_frame_rate) {
+	FrameThrottle throttle;
+	throttle.max_frame_rate = max_frame_rate;
+	if (max_frame_rate > 0) {
+		throttle.frame_interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / max_frame_rate));
+#ifdef _WIN32
+		// The default 15.6 ms timer would leave most of each frame to the spin
+		timeBeginPeriod(1);
+#endif
+	}
+	throttle.next_frame_time = std::chrono::steady_clock::now();
+	throttle.mode_start = throttle.next_frame_time;
+	throttle.mode_start_cpu_seconds = get_process_cpu_seconds();
+
+	return throttle;
+}
+
+void destroy_frame_throttle(FrameThrottle& throttle) {
+#ifdef _WIN32
+	if (throttle.max_frame_rate > 0) {
+		timeEndPeriod(1);
+	}
+#endif
+	throttle.max_frame_rate = 0;
+}
+
+// Adds the time since the mode was last closed out to its stats
+static void close_throttle_mode(FrameThrottle& throttle) {
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	double cpu_seconds = get_process_cpu_seconds();
+	ThrottleModeStats& stats = throttle.stats[throttle.mode];
+	stats.wall_seconds += std::chrono::duration<double>(now - throttle.mode_start).count();
+	stats.cpu_seconds += cpu_seconds - throttle.mode_start_cpu_seconds;
+
+	throttle.mode_start = now;
+	throttle.mode_start_cpu_seconds = cpu_seconds;
+}
+
+void set_throttle_mode(FrameThrottle& throttle, ThrottleMode mode) {
+	if (mode != throttle.mode) {
+		close_throttle_mode(throttle);
+		throttle.mode = mode;
+	}
+}
+
+// Sleeps 1 ms at a time while more is left than a sleep is likely to take, then spins the rest
+static void sleep_until_precise(FrameThrottle& throttle, std::chrono::steady_clock::time_point target) {
+	while (true) {
+		std::chrono::steady_clock::time_point sleep_start = std::chrono::steady_clock::now();
+		double remaining_seconds = std::chrono::duration<double>(target - sleep_start).count();
+		if (remaining_seconds <= throttle.sleep_mean_seconds + 2.0 * throttle.sleep_deviation_seconds) {
+			break;
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		double slept_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - sleep_start).count();
+		double error = slept_seconds - throttle.sleep_mean_seconds;
+		throttle.sleep_mean_seconds += error * SLEEP_ESTIMATE_WEIGHT;
+		throttle.sleep_deviation_seconds += (std::abs(error) - throttle.sleep_deviation_seconds) * SLEEP_ESTIMATE_WEIGHT;
+	}
+
+	while (std::chrono::steady_clock::now() < target) {
+		std::this_thread::yield();
+	}
+}
+
+bool wait_for_frame_slot(FrameThrottle& throttle) {
+	if (throttle.max_frame_rate == 0 || std::chrono::steady_clock::now() >= throttle.next_frame_time) {
+		return false;
+	}
+
+	sleep_until_precise(throttle, throttle.next_frame_time);
+	return true;
+}
+
+// A frame that ran late pushes the schedule back rather than letting the next few run early to catch up
+void record_throttled_frame(FrameThrottle& throttle) {
+	throttle.stats[throttle.mode].frame_count++;
+	if (throttle.max_frame_rate > 0) {
+		throttle.next_frame_time = std::max(throttle.next_frame_time + throttle.frame_interval, std::chrono::steady_clock::now());
+	}
+}
+
+// CPU is a percentage of one core, so a fully busy loop plus its worker threads can go over 100
+void report_frame_throttle(FrameThrottle& throttle) {
+	close_throttle_mode(throttle);
+
+	std::cout << "Frame throttle, ";
+	if (throttle.max_frame_rate > 0) {
+		std::cout << "capped at " << throttle.max_frame_rate << " fps";
+	}
+	else {
+		std::cout << "uncapped";
+	}
+	std::cout << " (mode / seconds / frames / fps / CPU %):\n";
+	for (uint32_t i = 0; i < THROTTLE_MODE_COUNT; ++i) {
+		const ThrottleModeStats& stats = throttle.stats[i];
+		if (stats.wall_seconds <= 0.0) {
+			continue;
+		}
+
+		std::cout << '\t' << get_throttle_mode_name(static_cast<ThrottleMode>(i)) << " / " << stats.wall_seconds << " / " << stats.frame_count
+			<< " / " << stats.frame_count / stats.wall_seconds << " / " << stats.cpu_seconds / stats.wall_seconds * 100.0 << '\n';
+	}
+}
+
+const char* get_throttle_mode_name(ThrottleMode mode) {
+	switch (mode) {
+	case THROTTLE_MODE_RENDERING:
+		return "rendering";
+	case THROTTLE_MODE_IDLE:
+		return "idle";
+	case THROTTLE_MODE_HIDDEN:
+		return "hidden";
+	default:
+		return "unknown";
+	}
+}
+
+// User plus kernel time of every thread in the process
+double get_process_cpu_seconds() {
+#ifdef _WIN32
+	FILETIME creation_time, exit_time, kernel_time, user_time;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time)) {
+		return 0.0;
+	}
+
+	// FILETIMEs count 100 ns intervals
+	ULARGE_INTEGER kernel{}, user{};
+	kernel.LowPart = kernel_time.dwLowDateTime;
+	kernel.HighPart = kernel_time.dwHighDateTime;
+	user.LowPart = user_time.dwLowDateTime;
+	user.HighPart = user_time.dwHighDateTime;
+	return (kernel.QuadPart + user.QuadPart) * 1e-7;
+#else
+	timespec time{};
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+	return time.tv_sec + time.tv_nsec * 1e-9;
+#endif
+}
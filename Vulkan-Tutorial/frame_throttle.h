@@ -0,0 +1,52 @@
+// Keeps the windowed loop from burning CPU it doesn't need. With a frame rate cap, frames start on a fixed
+// interval and the time in between is slept off: short sleeps while there's plenty of time left, then a spin
+// for the last bit, since how late a sleep wakes up depends on the OS timer. The loop also tells the throttle
+// which mode it's in (drawing, idling on a static scene, or hidden), and the wall and process CPU time spent
+// in each is reported at exit, so the effect of the cap and of idling can be measured.
+// Deliberately has no Vulkan dependency.
+
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+const double SLEEP_ESTIMATE_WEIGHT = 0.1; // how quickly the sleep estimate follows what sleeps actually take
+
+enum ThrottleMode {
+	THROTTLE_MODE_RENDERING,
+	THROTTLE_MODE_IDLE, // the scene is static, the loop blocks until a message arrives
+	THROTTLE_MODE_HIDDEN, // minimized, nothing to draw into
+	THROTTLE_MODE_COUNT
+};
+
+struct ThrottleModeStats {
+	double wall_seconds = 0.0;
+	double cpu_seconds = 0.0; // every thread in the process, not just the loop
+	uint64_t frame_count = 0;
+};
+
+struct FrameThrottle {
+	uint32_t max_frame_rate = 0; // 0 for no cap
+	std::chrono::steady_clock::duration frame_interval{ 0 };
+	std::chrono::steady_clock::time_point next_frame_time;
+
+	// How long a 1 ms sleep really takes, mean and mean deviation
+	double sleep_mean_seconds = 0.001;
+	double sleep_deviation_seconds = 0.0;
+
+	ThrottleMode mode = THROTTLE_MODE_RENDERING;
+	std::chrono::steady_clock::time_point mode_start;
+	double mode_start_cpu_seconds = 0.0;
+	std::array<ThrottleModeStats, THROTTLE_MODE_COUNT> stats;
+};
+
+FrameThrottle create_frame_throttle(uint32_t max_frame_rate);
+void destroy_frame_throttle(FrameThrottle& throttle);
+void set_throttle_mode(FrameThrottle& throttle, ThrottleMode mode);
+// Returns true if it slept, in which case the caller should handle whatever input arrived in the meantime
+// before drawing. The slot stays open until record_throttled_frame, so the next call returns false
+bool wait_for_frame_slot(FrameThrottle& throttle);
+void record_throttled_frame(FrameThrottle& throttle);
+void report_frame_throttle(FrameThrottle& throttle);
+const char* get_throttle_mode_name(ThrottleMode mode);
+double get_process_cpu_seconds();
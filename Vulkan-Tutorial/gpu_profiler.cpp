@@ -0,0 +1,162 @@
+#include "gpu_profiler.h"
+#include "vulkan.h"
+
+GpuProfiler create_gpu_profiler(VkDevice device, VkPhysicalDevice physical_device, uint32_t queue_family, uint32_t frame_zone_count,
+VkCommandPool command_pool, VkQueue graphics_queue, Timeline& timeline, const std::string& trace_path, bool time_frames) {
+	GpuProfiler profiler;
+	profiler.trace_path = trace_path;
+	if (trace_path.empty() && !time_frames) {
+		return profiler;
+	}
+
+	uint32_t queue_family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, nullptr);
+	std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, queue_families.data());
+	uint32_t valid_bits = queue_families[queue_family].timestampValidBits;
+	if (valid_bits == 0) {
+		LOG_WARNING("Graphics queue doesn't support timestamps, GPU zones disabled");
+		return profiler;
+	}
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	profiler.nanoseconds_per_tick = properties.limits.timestampPeriod;
+	profiler.timestamp_mask = valid_bits >= 64 ? UINT64_MAX : (1ull << valid_bits) - 1;
+	profiler.frame_zone_count = frame_zone_count;
+
+	VkQueryPoolCreateInfo pool_info{};
+	pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	pool_info.queryCount = (frame_zone_count + GPU_UPLOAD_ZONE_COUNT) * 2;
+
+	if (vkCreateQueryPool(device, &pool_info, get_host_allocator(HOST_ARENA_QUERY), &profiler.query_pool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create timestamp query pool!");
+	}
+
+	// GPU and CPU clocks are unrelated, so pin one GPU timestamp to the CPU time halfway through the round
+	// trip. Good to within the submit latency, which is plenty for lining zones up by eye
+	uint32_t query = allocate_upload_zone(profiler);
+	VkCommandBuffer command_buffer = begin_single_time_commands(command_pool, device);
+	vkCmdResetQueryPool(command_buffer, profiler.query_pool, query, 2);
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, profiler.query_pool, query);
+	std::chrono::steady_clock::time_point submit_time = std::chrono::steady_clock::now();
+	end_single_time_commands(command_buffer, graphics_queue, timeline, device, command_pool);
+	std::chrono::steady_clock::time_point complete_time = std::chrono::steady_clock::now();
+
+	if (vkGetQueryPoolResults(device, profiler.query_pool, query, 1, sizeof(uint64_t), &profiler.calibration_ticks, sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to read calibration timestamp!");
+	}
+	profiler.calibration_us = (to_trace_microseconds(submit_time) + to_trace_microseconds(complete_time)) * 0.5;
+
+	return profiler;
+}
+
+// Expects the device to be idle, so every zone can be collected before the trace is written
+void destroy_gpu_profiler(GpuProfiler& profiler, VkDevice device) {
+	// CPU zones are still written when the queue has no timestamps
+	std::vector<TraceThread> threads;
+	if (profiler.query_pool != VK_NULL_HANDLE) {
+		collect_gpu_zones(profiler, device, UINT64_MAX);
+		vkDestroyQueryPool(device, profiler.query_pool, get_host_allocator(HOST_ARENA_QUERY));
+		profiler.query_pool = VK_NULL_HANDLE;
+		threads.push_back({ TRACE_GPU_THREAD_ID, "GPU" });
+	}
+	if (profiler.trace_path.empty()) {
+		return;
+	}
+	stop_profile_collector(profiler.events, threads);
+	write_chrome_trace(profiler.trace_path, profiler.events, threads);
+	profiler.trace_path.clear();
+}
+
+// A frame slot's zone is only rewritten after the slot's previous timeline value has been waited on
+uint32_t get_frame_zone_query(const GpuProfiler& profiler, uint32_t frame) {
+	return profiler.query_pool == VK_NULL_HANDLE ? GPU_ZONE_NONE : frame * 2;
+}
+
+// Round robin over the upload zones, skipping the zone rather than waiting when it is still pending
+uint32_t allocate_upload_zone(GpuProfiler& profiler) {
+	if (profiler.query_pool == VK_NULL_HANDLE) {
+		return GPU_ZONE_NONE;
+	}
+
+	uint32_t query = (profiler.frame_zone_count + profiler.next_upload_zone) * 2;
+	for (const GpuZone& zone : profiler.pending_zones) {
+		if (zone.first_query == query) {
+			return GPU_ZONE_NONE;
+		}
+	}
+	profiler.next_upload_zone = (profiler.next_upload_zone + 1) % GPU_UPLOAD_ZONE_COUNT;
+	return query;
+}
+
+// The reset is recorded with the zone, so replayed command buffers reset their own queries every submission
+void cmd_begin_gpu_zone(VkCommandBuffer command_buffer, VkQueryPool query_pool, uint32_t first_query) {
+	if (first_query == GPU_ZONE_NONE) {
+		return;
+	}
+	vkCmdResetQueryPool(command_buffer, query_pool, first_query, 2);
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool, first_query);
+}
+
+void cmd_end_gpu_zone(VkCommandBuffer command_buffer, VkQueryPool query_pool, uint32_t first_query) {
+	if (first_query == GPU_ZONE_NONE) {
+		return;
+	}
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool, first_query + 1);
+}
+
+void add_gpu_zone(GpuProfiler& profiler, const char* name, uint32_t first_query, uint64_t timeline_value) {
+	if (first_query == GPU_ZONE_NONE) {
+		return;
+	}
+	profiler.pending_zones.push_back({ name, first_query, timeline_value });
+}
+
+void collect_gpu_zones(GpuProfiler& profiler, VkDevice device, uint64_t completed_value) {
+	for (size_t i = 0; i < profiler.pending_zones.size();) {
+		const GpuZone& zone = profiler.pending_zones[i];
+		if (zone.timeline_value > completed_value) {
+			++i;
+			continue;
+		}
+
+		// Already complete, so this returns immediately
+		uint64_t ticks[2];
+		VkResult result = vkGetQueryPoolResults(device, profiler.query_pool, zone.first_query, 2, sizeof(ticks), ticks, sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT);
+		if (result == VK_SUCCESS) {
+			uint64_t begin_ticks = (ticks[0] - profiler.calibration_ticks) & profiler.timestamp_mask;
+			uint64_t end_ticks = (ticks[1] - profiler.calibration_ticks) & profiler.timestamp_mask;
+			double begin_us = profiler.calibration_us + begin_ticks * profiler.nanoseconds_per_tick / 1000.0;
+			double duration_us = end_ticks >= begin_ticks ? (end_ticks - begin_ticks) * profiler.nanoseconds_per_tick / 1000.0 : 0.0;
+			if (!profiler.trace_path.empty()) {
+				profiler.events.push_back({ zone.name, "gpu", TRACE_GPU_THREAD_ID, begin_us, duration_us });
+			}
+			if (zone.first_query < profiler.frame_zone_count * 2) {
+				profiler.frame_gpu_seconds.push_back(duration_us * 1e-6);
+			}
+		}
+
+		profiler.pending_zones[i] = profiler.pending_zones.back();
+		profiler.pending_zones.pop_back();
+	}
+}
+
+// draw_frame's phases are back to back, so they are rebuilt from the frame start and the durations
+void add_frame_phase_zones(GpuProfiler& profiler, std::chrono::steady_clock::time_point frame_start, const FrameTimings& timings) {
+	if (profiler.trace_path.empty()) {
+		return;
+	}
+
+	double start_us = to_trace_microseconds(frame_start);
+	for (uint32_t phase = 0; phase < FRAME_PHASE_COUNT; ++phase) {
+		double duration_us = timings.phase_seconds[phase] * 1e6;
+		if (duration_us > 0.0) {
+			profiler.events.push_back({ get_frame_phase_name(static_cast<FramePhase>(phase)), "cpu", 0, start_us, duration_us });
+		}
+		start_us += duration_us;
+	}
+}
@@ -0,0 +1,53 @@
+// GPU timestamp zones. Each zone is a pair of timestamps in one query pool, reset and written by the command
+// buffer that does the work, and read back once the timeline value of its submission has been reached, so
+// reading never stalls. Ticks are converted with the device's timestampPeriod and placed on the CPU timeline
+// using one calibration point taken at startup, then written together with the CPU frame phases and the
+// PROFILE_ZONE events (see profile.h) as a Chrome trace (see trace.h). Off unless a trace path is given or
+// frame timing is asked for, and when off no queries are recorded at all. Frame timing keeps just the GPU
+// time of each frame's render pass zone, for dynamic resolution (see dynamic_resolution.h).
+
+#pragma once
+#include <cstdint>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "timeline.h"
+#include "benchmark.h"
+#include "trace.h"
+
+const uint32_t GPU_ZONE_NONE = UINT32_MAX;
+const uint32_t GPU_UPLOAD_ZONE_COUNT = 32; // upload zones in flight at once, more than that go unprofiled
+
+struct GpuZone {
+	const char* name;
+	uint32_t first_query; // begin timestamp, the end timestamp is the next query
+	uint64_t timeline_value;
+};
+
+struct GpuProfiler {
+	VkQueryPool query_pool = VK_NULL_HANDLE; // null when profiling is off
+	uint32_t frame_zone_count = 0; // one render pass zone per frame slot, upload zones follow them
+	double nanoseconds_per_tick = 1.0;
+	uint64_t timestamp_mask = UINT64_MAX; // timestampValidBits
+	uint64_t calibration_ticks = 0;
+	double calibration_us = 0.0; // trace time of calibration_ticks
+	uint32_t next_upload_zone = 0;
+	std::vector<GpuZone> pending_zones;
+	std::vector<TraceEvent> events;
+	std::string trace_path; // empty when tracing is off
+	std::vector<double> frame_gpu_seconds; // render pass zones collected since the caller last cleared it
+};
+
+GpuProfiler create_gpu_profiler(VkDevice device, VkPhysicalDevice physical_device, uint32_t queue_family, uint32_t frame_zone_count,
+	VkCommandPool command_pool, VkQueue graphics_queue, Timeline& timeline, const std::string& trace_path, bool time_frames);
+void destroy_gpu_profiler(GpuProfiler& profiler, VkDevice device);
+uint32_t get_frame_zone_query(const GpuProfiler& profiler, uint32_t frame);
+uint32_t allocate_upload_zone(GpuProfiler& profiler);
+void cmd_begin_gpu_zone(VkCommandBuffer command_buffer, VkQueryPool query_pool, uint32_t first_query);
+void cmd_end_gpu_zone(VkCommandBuffer command_buffer, VkQueryPool query_pool, uint32_t first_query);
+void add_gpu_zone(GpuProfiler& profiler, const char* name, uint32_t first_query, uint64_t timeline_value);
+void collect_gpu_zones(GpuProfiler& profiler, VkDevice device, uint64_t completed_value);
+void add_frame_phase_zones(GpuProfiler& profiler, std::chrono::steady_clock::time_point frame_start, const FrameTimings& timings);
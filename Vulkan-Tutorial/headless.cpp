@@ -0,0 +1,61 @@
+#include "headless.h"
+
+#include "vulkan.h"
+#include "batch.h"
+
+int run_headless(const Settings& settings) {
+	Platform platform = create_headless_platform(settings.width, settings.height);
+	Vulkan vulkan = init_vulkan(platform, settings);
+
+	// Same camera path every run so runs can be compared
+	std::vector<double> camera_path;
+	if (!settings.camera_script.empty()) {
+		camera_path = load_camera_script(settings.camera_script);
+	}
+	else {
+		uint32_t frame_count = settings.benchmark ? settings.warmup_frames + settings.frame_count : settings.frame_count;
+		for (uint32_t frame = 0; frame < frame_count; ++frame) {
+			camera_path.push_back(get_benchmark_camera_position(frame));
+		}
+	}
+	Benchmark benchmark = create_benchmark(settings.warmup_frames, settings.frame_count);
+
+	bool write_frames = !settings.output_directory.empty();
+	BatchRenderer batch;
+	if (write_frames) {
+		init_batch_renderer(batch, vulkan, settings);
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint32_t frame = 0; frame < camera_path.size(); ++frame) {
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		draw_frame(vulkan, get_still_scene_snapshot(camera_path[frame], seconds));
+		if (settings.benchmark) {
+			record_benchmark_frame(benchmark, vulkan.last_frame_timings);
+		}
+		if (write_frames) {
+			submit_readback(batch, vulkan, frame);
+			collect_readbacks(batch, vulkan, false);
+		}
+	}
+	if (write_frames) {
+		shutdown_batch_renderer(batch, vulkan);
+	}
+	wait_for_timeline_value(vulkan.device, vulkan.timeline, vulkan.timeline.last_submitted_value);
+	stop_logger();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "Rendered " << camera_path.size() << " frames at " << settings.width << "x" << settings.height << " in " << seconds << "s ("
+		<< (seconds > 0.0 ? camera_path.size() / seconds : 0.0) << " fps)\n";
+	report_frame_pacing(vulkan);
+	report_dynamic_resolution(vulkan.dynamic_resolution);
+	report_pipeline_statistics(vulkan.pipeline_statistics);
+	report_memory_usage(vulkan.physical_device);
+	if (settings.benchmark) {
+		report_benchmark(benchmark, settings.report_path);
+	}
+	cleanup_vulkan(vulkan);
+	report_host_allocations();
+
+	return 0;
+}
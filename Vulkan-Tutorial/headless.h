@@ -0,0 +1,9 @@
+// Runs the renderer without a window for a fixed number of frames and reports how long they took.
+// This is the entry point on Linux, where there is no Win32 backend, and can be used on Windows with
+// --headless, and with --output also writes every frame to disk (see batch.h). On Linux it's the
+// Vulkan-Tutorial target in CMakeLists.txt, and picks up lavapipe or SwiftShader through the usual VK_ICD_FILENAMES.
+
+#pragma once
+#include "settings.h"
+
+int run_headless(const Settings& settings);
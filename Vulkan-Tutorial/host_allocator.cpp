@@ -0,0 +1,330 @@
+#include "host_allocator.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// Sits directly in front of every pointer handed to the driver. The pointer is offset into its block by at
+// least the header size and at least the requested alignment, so the block alignment (its size class, or
+// the requested alignment for large allocations) carries over to the pointer
+struct AllocationHeader {
+	uint16_t size_class;
+	uint16_t scope;
+	uint32_t offset; // from the start of the block
+	uint64_t size;
+};
+static_assert(sizeof(AllocationHeader) == 16, "The header must keep 16 byte alignment");
+
+const uint16_t LARGE_ALLOCATION = UINT16_MAX;
+const size_t HOST_HEADER_ALIGNMENT = 16;
+const size_t HOST_POOL_CHUNK_ALIGNMENT = HOST_MIN_BLOCK_SIZE << (HOST_SIZE_CLASS_COUNT - 1);
+
+struct ScopeCounters {
+	uint64_t allocations = 0;
+	uint64_t reallocations = 0;
+	uint64_t frees = 0;
+	size_t live_bytes = 0;
+	size_t peak_bytes = 0;
+	uint64_t internal_allocations = 0; // memory the driver got elsewhere and only told us about
+	size_t internal_live_bytes = 0;
+};
+
+struct HostArenaState {
+	std::mutex mutex;
+	std::array<void*, HOST_SIZE_CLASS_COUNT> free_lists{}; // singly linked through the free blocks themselves
+	std::vector<void*> chunks;
+	std::array<ScopeCounters, HOST_SCOPE_COUNT> scopes;
+	uint64_t pooled_allocations = 0;
+	uint64_t large_allocations = 0;
+	size_t live_bytes = 0;
+	size_t peak_bytes = 0;
+	VkAllocationCallbacks callbacks{};
+};
+
+struct HostAllocator {
+	std::array<HostArenaState, HOST_ARENA_COUNT> arenas;
+	bool enabled = true;
+};
+
+static uint16_t get_size_class(size_t bytes) {
+	for (uint16_t size_class = 0; size_class < HOST_SIZE_CLASS_COUNT; ++size_class) {
+		if (bytes <= HOST_MIN_BLOCK_SIZE << size_class) {
+			return size_class;
+		}
+	}
+
+	return LARGE_ALLOCATION;
+}
+
+// Carves a new chunk into blocks of one size class. Blocks are aligned to their own size, since the
+// chunk is aligned to the largest class
+static bool refill_free_list(HostArenaState& arena, uint16_t size_class) {
+	char* chunk = static_cast<char*>(::operator new(HOST_POOL_CHUNK_SIZE, std::align_val_t(HOST_POOL_CHUNK_ALIGNMENT), std::nothrow));
+	if (chunk == nullptr) {
+		return false;
+	}
+	arena.chunks.push_back(chunk);
+
+	size_t block_size = HOST_MIN_BLOCK_SIZE << size_class;
+	for (size_t offset = HOST_POOL_CHUNK_SIZE; offset >= block_size; offset -= block_size) {
+		void* block = chunk + offset - block_size;
+		*static_cast<void**>(block) = arena.free_lists[size_class];
+		arena.free_lists[size_class] = block;
+	}
+
+	return true;
+}
+
+static void* allocate_locked(HostArenaState& arena, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+	size_t offset = std::max(HOST_HEADER_ALIGNMENT, alignment);
+	uint16_t size_class = get_size_class(offset + size);
+
+	char* block = nullptr;
+	if (size_class != LARGE_ALLOCATION) {
+		if (arena.free_lists[size_class] == nullptr && !refill_free_list(arena, size_class)) {
+			return nullptr;
+		}
+		block = static_cast<char*>(arena.free_lists[size_class]);
+		arena.free_lists[size_class] = *static_cast<void**>(arena.free_lists[size_class]);
+		arena.pooled_allocations++;
+	}
+	else {
+		block = static_cast<char*>(::operator new(offset + size, std::align_val_t(offset), std::nothrow));
+		if (block == nullptr) {
+			return nullptr;
+		}
+		arena.large_allocations++;
+	}
+
+	AllocationHeader* header = reinterpret_cast<AllocationHeader*>(block + offset) - 1;
+	header->size_class = size_class;
+	header->scope = static_cast<uint16_t>(scope);
+	header->offset = static_cast<uint32_t>(offset);
+	header->size = size;
+
+	ScopeCounters& counters = arena.scopes[scope];
+	counters.allocations++;
+	counters.live_bytes += size;
+	counters.peak_bytes = std::max(counters.peak_bytes, counters.live_bytes);
+	arena.live_bytes += size;
+	arena.peak_bytes = std::max(arena.peak_bytes, arena.live_bytes);
+
+	return block + offset;
+}
+
+static void free_locked(HostArenaState& arena, void* memory) {
+	// Copied out, the free list link overwrites the header when it sits at the start of the block
+	AllocationHeader header = *(static_cast<AllocationHeader*>(memory) - 1);
+	char* block = static_cast<char*>(memory) - header.offset;
+
+	ScopeCounters& counters = arena.scopes[header.scope];
+	counters.frees++;
+	counters.live_bytes -= header.size;
+	arena.live_bytes -= header.size;
+
+	if (header.size_class != LARGE_ALLOCATION) {
+		*reinterpret_cast<void**>(block) = arena.free_lists[header.size_class];
+		arena.free_lists[header.size_class] = block;
+	}
+	else {
+		::operator delete(block, std::align_val_t(header.offset));
+	}
+}
+
+static VKAPI_ATTR void* VKAPI_CALL host_allocation(void* user_data, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+	HostArenaState& arena = *static_cast<HostArenaState*>(user_data);
+	std::lock_guard<std::mutex> lock(arena.mutex);
+
+	return allocate_locked(arena, size, alignment, scope);
+}
+
+static VKAPI_ATTR void* VKAPI_CALL host_reallocation(void* user_data, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+	HostArenaState& arena = *static_cast<HostArenaState*>(user_data);
+	std::lock_guard<std::mutex> lock(arena.mutex);
+	if (original == nullptr) {
+		return allocate_locked(arena, size, alignment, scope);
+	}
+	if (size == 0) {
+		free_locked(arena, original);
+		return nullptr;
+	}
+
+	// Grows and shrinks in place while the block is big enough
+	AllocationHeader* header = static_cast<AllocationHeader*>(original) - 1;
+	if (header->size_class != LARGE_ALLOCATION && header->offset + size <= HOST_MIN_BLOCK_SIZE << header->size_class) {
+		ScopeCounters& counters = arena.scopes[header->scope];
+		counters.reallocations++;
+		counters.live_bytes = counters.live_bytes - header->size + size;
+		counters.peak_bytes = std::max(counters.peak_bytes, counters.live_bytes);
+		arena.live_bytes = arena.live_bytes - header->size + size;
+		arena.peak_bytes = std::max(arena.peak_bytes, arena.live_bytes);
+		header->size = size;
+		return original;
+	}
+
+	// On failure the original has to stay valid
+	void* memory = allocate_locked(arena, size, alignment, scope);
+	if (memory == nullptr) {
+		return nullptr;
+	}
+	std::memcpy(memory, original, std::min(static_cast<size_t>(header->size), size));
+	free_locked(arena, original);
+	arena.scopes[scope].reallocations++;
+
+	return memory;
+}
+
+static VKAPI_ATTR void VKAPI_CALL host_free(void* user_data, void* memory) {
+	if (memory == nullptr) {
+		return;
+	}
+
+	HostArenaState& arena = *static_cast<HostArenaState*>(user_data);
+	std::lock_guard<std::mutex> lock(arena.mutex);
+	free_locked(arena, memory);
+}
+
+static VKAPI_ATTR void VKAPI_CALL host_internal_allocation(void* user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope) {
+	HostArenaState& arena = *static_cast<HostArenaState*>(user_data);
+	std::lock_guard<std::mutex> lock(arena.mutex);
+	arena.scopes[scope].internal_allocations++;
+	arena.scopes[scope].internal_live_bytes += size;
+}
+
+static VKAPI_ATTR void VKAPI_CALL host_internal_free(void* user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope) {
+	HostArenaState& arena = *static_cast<HostArenaState*>(user_data);
+	std::lock_guard<std::mutex> lock(arena.mutex);
+	arena.scopes[scope].internal_live_bytes -= size;
+}
+
+static HostAllocator& get_host_allocator_state() {
+	static HostAllocator allocator;
+	[[maybe_unused]] static bool initialized = [] {
+		for (HostArenaState& arena : allocator.arenas) {
+			arena.callbacks.pUserData = &arena;
+			arena.callbacks.pfnAllocation = host_allocation;
+			arena.callbacks.pfnReallocation = host_reallocation;
+			arena.callbacks.pfnFree = host_free;
+			arena.callbacks.pfnInternalAllocation = host_internal_allocation;
+			arena.callbacks.pfnInternalFree = host_internal_free;
+		}
+		return true;
+	}();
+
+	return allocator;
+}
+
+void set_host_allocator_enabled(bool enabled) {
+	get_host_allocator_state().enabled = enabled;
+}
+
+const VkAllocationCallbacks* get_host_allocator(HostArena arena) {
+	HostAllocator& allocator = get_host_allocator_state();
+	return allocator.enabled ? &allocator.arenas[arena].callbacks : nullptr;
+}
+
+static const char* get_host_scope_name(uint32_t scope) {
+	switch (scope) {
+	case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND:
+		return "command";
+	case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT:
+		return "object";
+	case VK_SYSTEM_ALLOCATION_SCOPE_CACHE:
+		return "cache";
+	case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE:
+		return "device";
+	case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE:
+		return "instance";
+	default:
+		return "unknown";
+	}
+}
+
+static double to_kib(size_t bytes) {
+	return bytes / 1024.0;
+}
+
+// Called after cleanup_vulkan, so live bytes left over in the object scope are driver allocations that
+// were never handed back
+void report_host_allocations() {
+	HostAllocator& allocator = get_host_allocator_state();
+	if (!allocator.enabled) {
+		std::cout << "Host allocations went to the system heap, nothing was counted\n";
+		return;
+	}
+
+	std::array<ScopeCounters, HOST_SCOPE_COUNT> scope_totals;
+	std::cout << "Host allocations by arena (arena / allocations / reallocations / pooled % / live KiB / peak KiB / chunks):\n";
+	for (uint32_t i = 0; i < HOST_ARENA_COUNT; ++i) {
+		HostArenaState& arena = allocator.arenas[i];
+		std::lock_guard<std::mutex> lock(arena.mutex);
+
+		uint64_t allocations = 0;
+		uint64_t reallocations = 0;
+		for (uint32_t scope = 0; scope < HOST_SCOPE_COUNT; ++scope) {
+			const ScopeCounters& counters = arena.scopes[scope];
+			allocations += counters.allocations;
+			reallocations += counters.reallocations;
+
+			ScopeCounters& totals = scope_totals[scope];
+			totals.allocations += counters.allocations;
+			totals.reallocations += counters.reallocations;
+			totals.frees += counters.frees;
+			totals.live_bytes += counters.live_bytes;
+			totals.peak_bytes += counters.peak_bytes; // sum of per arena peaks, an upper bound
+			totals.internal_allocations += counters.internal_allocations;
+			totals.internal_live_bytes += counters.internal_live_bytes;
+		}
+		if (allocations == 0) {
+			continue;
+		}
+
+		uint64_t backed = arena.pooled_allocations + arena.large_allocations;
+		std::cout << '\t' << get_host_arena_name(static_cast<HostArena>(i)) << " / " << allocations << " / " << reallocations << " / "
+			<< (backed > 0 ? 100.0 * arena.pooled_allocations / backed : 0.0) << " / " << to_kib(arena.live_bytes) << " / "
+			<< to_kib(arena.peak_bytes) << " / " << arena.chunks.size() << '\n';
+	}
+
+	std::cout << "Host allocations by scope (scope / allocations / reallocations / frees / live KiB / peak KiB / internal allocations / internal live KiB):\n";
+	for (uint32_t scope = 0; scope < HOST_SCOPE_COUNT; ++scope) {
+		const ScopeCounters& totals = scope_totals[scope];
+		std::cout << '\t' << get_host_scope_name(scope) << " / " << totals.allocations << " / " << totals.reallocations << " / " << totals.frees << " / "
+			<< to_kib(totals.live_bytes) << " / " << to_kib(totals.peak_bytes) << " / " << totals.internal_allocations << " / "
+			<< to_kib(totals.internal_live_bytes) << '\n';
+	}
+}
+
+const char* get_host_arena_name(HostArena arena) {
+	switch (arena) {
+	case HOST_ARENA_INSTANCE:
+		return "instance";
+	case HOST_ARENA_DEVICE:
+		return "device";
+	case HOST_ARENA_SWAP_CHAIN:
+		return "swap chain";
+	case HOST_ARENA_IMAGE:
+		return "image";
+	case HOST_ARENA_BUFFER:
+		return "buffer";
+	case HOST_ARENA_MEMORY:
+		return "memory";
+	case HOST_ARENA_FRAMEBUFFER:
+		return "framebuffer";
+	case HOST_ARENA_PIPELINE:
+		return "pipeline";
+	case HOST_ARENA_DESCRIPTOR:
+		return "descriptor";
+	case HOST_ARENA_COMMAND:
+		return "command";
+	case HOST_ARENA_SYNC:
+		return "sync";
+	case HOST_ARENA_QUERY:
+		return "query";
+	default:
+		return "unknown";
+	}
+}
@@ -0,0 +1,40 @@
+// Host memory the driver allocates on our behalf. Every create and destroy call passes the callbacks for
+// the arena matching the object type, and each arena serves small requests from free lists of fixed size
+// blocks carved out of 64 KiB chunks, so objects that are destroyed and recreated (the swap chain and
+// everything hanging off it, streamed buffers and images) reuse the same blocks instead of going back to
+// the system heap. Chunks are kept for the life of the process. Counters are kept per allocation scope
+// and per arena; --system-allocator passes nullptr everywhere instead, for comparison.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+enum HostArena {
+	HOST_ARENA_INSTANCE, // instance and surface
+	HOST_ARENA_DEVICE,
+	HOST_ARENA_SWAP_CHAIN,
+	HOST_ARENA_IMAGE, // images, image views and samplers
+	HOST_ARENA_BUFFER,
+	HOST_ARENA_MEMORY,
+	HOST_ARENA_FRAMEBUFFER, // framebuffers and render passes
+	HOST_ARENA_PIPELINE, // pipelines, layouts and shader modules
+	HOST_ARENA_DESCRIPTOR,
+	HOST_ARENA_COMMAND,
+	HOST_ARENA_SYNC,
+	HOST_ARENA_QUERY,
+	HOST_ARENA_COUNT
+};
+
+const uint32_t HOST_SIZE_CLASS_COUNT = 8; // 32 bytes up to 4 KiB, anything bigger goes to the system heap
+const size_t HOST_MIN_BLOCK_SIZE = 32;
+const size_t HOST_POOL_CHUNK_SIZE = 64 * 1024;
+const uint32_t HOST_SCOPE_COUNT = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+
+// Must be called before the instance is created and not changed afterwards
+void set_host_allocator_enabled(bool enabled);
+// nullptr when disabled
+const VkAllocationCallbacks* get_host_allocator(HostArena arena);
+void report_host_allocations();
+const char* get_host_arena_name(HostArena arena);
@@ -0,0 +1,188 @@
+#include "job_system.h"
+
+#include <algorithm>
+#include <string>
+
+#include "log.h"
+#include "profile.h"
+
+static thread_local const JobSystem* current_job_system = nullptr;
+static thread_local uint32_t current_job_queue = 0;
+
+static bool push_job(JobQueue& queue, const Job& job) {
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.bottom - queue.top == JOB_QUEUE_CAPACITY) {
+		return false;
+	}
+
+	queue.jobs[queue.bottom & (JOB_QUEUE_CAPACITY - 1)] = job;
+	queue.bottom++;
+	return true;
+}
+
+static bool pop_job(JobQueue& queue, Job& out_job) {
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.bottom == queue.top) {
+		return false;
+	}
+
+	queue.bottom--;
+	out_job = queue.jobs[queue.bottom & (JOB_QUEUE_CAPACITY - 1)];
+	return true;
+}
+
+static bool steal_job(JobQueue& queue, Job& out_job) {
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.bottom == queue.top) {
+		return false;
+	}
+
+	out_job = queue.jobs[queue.top & (JOB_QUEUE_CAPACITY - 1)];
+	queue.top++;
+	return true;
+}
+
+// Exceptions stop here rather than unwinding through a worker, or through whichever job was waiting
+static void run_job(const Job& job) {
+	try {
+		job.function(job.data, job.begin, job.end);
+	}
+	catch (...) {
+		if (job.counter == nullptr) {
+			LOG_ERROR("A job with no counter threw, nothing is waiting to see it");
+		}
+		else if (!job.counter->failed.exchange(true)) {
+			job.counter->error = std::current_exception();
+		}
+	}
+	if (job.counter != nullptr) {
+		job.counter->remaining.fetch_sub(1, std::memory_order_release);
+	}
+}
+
+// Own queue first, then the others starting with the next one along so thieves don't all pile onto queue 0.
+// Threads outside the system have no queue of their own and only steal
+static bool run_next_job(JobSystem& system, uint32_t queue_index) {
+	uint32_t queue_count = static_cast<uint32_t>(system.queues.size());
+	Job job;
+	bool found = queue_index < queue_count && pop_job(*system.queues[queue_index], job);
+	for (uint32_t i = 1; !found && i <= queue_count; ++i) {
+		found = steal_job(*system.queues[(queue_index + i) % queue_count], job);
+		if (found) {
+			system.steal_count.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	if (!found) {
+		return false;
+	}
+
+	system.queued_count.fetch_sub(1);
+	run_job(job);
+	return true;
+}
+
+static void run_job_worker(JobSystem& system, uint32_t queue_index) {
+	current_job_system = &system;
+	current_job_queue = queue_index;
+	set_profile_thread_name(("Job worker " + std::to_string(queue_index)).c_str());
+
+	uint32_t idle_rounds = 0;
+	while (system.running.load(std::memory_order_relaxed)) {
+		if (run_next_job(system, queue_index)) {
+			idle_rounds = 0;
+			continue;
+		}
+		if (++idle_rounds < JOB_IDLE_SPIN_COUNT) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		// Counted as sleeping before checking for work, and submit_job counts the job before checking for
+		// sleepers, so one of the two always sees the other and a wake up can't be missed
+		idle_rounds = 0;
+		std::unique_lock<std::mutex> lock(system.sleep_mutex);
+		system.sleeping_count.fetch_add(1);
+		system.wake.wait(lock, [&system] { return !system.running.load() || system.queued_count.load() > 0; });
+		system.sleeping_count.fetch_sub(1);
+	}
+}
+
+void start_job_system(JobSystem& system, uint32_t thread_count) {
+	thread_count = std::max(1u, std::min(thread_count, MAX_JOB_THREADS));
+	for (uint32_t i = 0; i < thread_count; ++i) {
+		system.queues.push_back(std::make_unique<JobQueue>());
+	}
+
+	current_job_system = &system;
+	current_job_queue = 0;
+	system.running.store(true);
+	for (uint32_t i = 1; i < thread_count; ++i) {
+		system.workers.emplace_back(run_job_worker, std::ref(system), i);
+	}
+}
+
+void stop_job_system(JobSystem& system) {
+	{
+		std::lock_guard<std::mutex> lock(system.sleep_mutex);
+		system.running.store(false);
+	}
+	system.wake.notify_all();
+	for (std::thread& worker : system.workers) {
+		worker.join();
+	}
+	system.workers.clear();
+	system.queues.clear();
+	system.queued_count.store(0);
+
+	if (current_job_system == &system) {
+		current_job_system = nullptr;
+	}
+}
+
+// Runs the job right away when the queue is full, which is slower than spreading it but never wrong
+void submit_job(JobSystem& system, const Job& job) {
+	if (job.counter != nullptr) {
+		job.counter->remaining.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	uint32_t queue_count = static_cast<uint32_t>(system.queues.size());
+	uint32_t queue_index = current_job_system == &system ? current_job_queue
+		: system.next_outside_queue.fetch_add(1, std::memory_order_relaxed) % queue_count;
+	// Counted before it's visible so a thief can never take the count below zero
+	system.queued_count.fetch_add(1);
+	if (!push_job(*system.queues[queue_index], job)) {
+		system.queued_count.fetch_sub(1);
+		run_job(job);
+		return;
+	}
+
+	if (system.sleeping_count.load() > 0) {
+		std::lock_guard<std::mutex> lock(system.sleep_mutex);
+		system.wake.notify_one();
+	}
+}
+
+void wait_for_jobs(JobSystem& system, JobCounter& counter) {
+	uint32_t queue_index = get_job_thread_index(system);
+	while (counter.remaining.load(std::memory_order_acquire) != 0) {
+		// Nothing left to take means the last few jobs are running elsewhere
+		if (!run_next_job(system, queue_index)) {
+			std::this_thread::yield();
+		}
+	}
+
+	if (counter.failed.load(std::memory_order_relaxed)) {
+		std::exception_ptr error = counter.error;
+		counter.error = nullptr;
+		counter.failed.store(false, std::memory_order_relaxed);
+		std::rethrow_exception(error);
+	}
+}
+
+uint32_t get_job_thread_count(const JobSystem& system) {
+	return static_cast<uint32_t>(system.queues.size());
+}
+
+uint32_t get_job_thread_index(const JobSystem& system) {
+	return current_job_system == &system ? current_job_queue : get_job_thread_count(system);
+}
@@ -0,0 +1,118 @@
+// Work stealing job system. Every thread in the system owns a queue: it pushes and pops its own jobs at the
+// bottom (newest first, so its caches stay warm) and, once its queue is empty, steals from the top of the
+// others (oldest first, which tend to be the biggest pieces of work). Jobs are a function pointer plus a range
+// so submitting one never allocates, and a JobCounter tracks how many of a group are still outstanding.
+// wait_for_jobs runs other jobs while it waits instead of blocking, so waiting from inside a job is fine.
+// A job that throws never takes down the thread running it, see JobCounter.
+// Startup (see task_graph.h), occluder rasterization and command recording all run on it. Tested without a
+// GPU in job_system_tests.cpp.
+// Deliberately has no Vulkan dependency.
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+const uint32_t MAX_JOB_THREADS = 16;
+const uint32_t JOB_QUEUE_CAPACITY = 1024; // per thread, must be a power of two
+const uint32_t JOB_IDLE_SPIN_COUNT = 64; // rounds an idle worker yields before it goes to sleep
+
+typedef void (*JobFunction)(void* data, uint32_t begin, uint32_t end);
+
+// Must outlive every job submitted with it. The first exception one of its jobs throws is kept here and
+// rethrown by wait_for_jobs once the rest have finished
+struct JobCounter {
+	std::atomic<uint32_t> remaining{ 0 };
+	std::atomic<bool> failed{ false };
+	std::exception_ptr error; // written by the first job to set failed, read once remaining is 0
+};
+
+struct Job {
+	JobFunction function;
+	void* data;
+	uint32_t begin;
+	uint32_t end;
+	JobCounter* counter;
+};
+
+// A lock per queue rather than a lock free deque. The owner is the only one pushing, and thieves only show up
+// when they're out of work, so the lock is almost never contended
+struct JobQueue {
+	std::mutex mutex;
+	std::array<Job, JOB_QUEUE_CAPACITY> jobs;
+	uint32_t top = 0; // thieves take from here
+	uint32_t bottom = 0; // the owner pushes and pops here
+};
+
+struct JobSystem {
+	std::vector<std::unique_ptr<JobQueue>> queues; // one per thread, 0 belongs to the thread that started the system
+	std::vector<std::thread> workers;
+	std::atomic<bool> running{ false };
+	std::atomic<uint32_t> queued_count{ 0 }; // across every queue, lets sleeping workers tell if there's anything to do
+	std::atomic<uint32_t> sleeping_count{ 0 };
+	std::atomic<uint32_t> next_outside_queue{ 0 }; // threads outside the system spread their jobs round robin
+	std::atomic<uint64_t> steal_count{ 0 };
+	std::mutex sleep_mutex;
+	std::condition_variable wake;
+};
+
+// thread_count includes the calling thread, which only runs jobs while it waits in wait_for_jobs
+void start_job_system(JobSystem& system, uint32_t thread_count);
+// Every counter has to have been waited on, queued jobs are dropped
+void stop_job_system(JobSystem& system);
+void submit_job(JobSystem& system, const Job& job);
+// Rethrows the first exception the counter's jobs threw, and leaves the counter ready for reuse
+void wait_for_jobs(JobSystem& system, JobCounter& counter);
+uint32_t get_job_thread_count(const JobSystem& system);
+// The calling thread's queue, or the thread count for threads outside the system
+uint32_t get_job_thread_index(const JobSystem& system);
+
+// Splits [0, count) into chunks of at most grain_size and calls body(begin, end) once per chunk, spread across
+// the system. The calling thread runs the first chunk itself and returns once every chunk is done. The first
+// exception a chunk throws is rethrown here, after the rest have finished
+template<typename Body>
+void parallel_for(JobSystem& system, uint32_t count, uint32_t grain_size, const Body& body) {
+	struct ParallelFor {
+		const Body* body;
+		std::atomic<bool> failed{ false };
+		std::exception_ptr error;
+	};
+
+	JobFunction run_chunk = [](void* data, uint32_t begin, uint32_t end) {
+		ParallelFor& parallel = *static_cast<ParallelFor*>(data);
+		try {
+			(*parallel.body)(begin, end);
+		}
+		catch (...) {
+			if (!parallel.failed.exchange(true)) {
+				parallel.error = std::current_exception();
+			}
+		}
+	};
+
+	if (count == 0) {
+		return;
+	}
+	grain_size = grain_size > 0 ? grain_size : 1;
+
+	ParallelFor parallel;
+	parallel.body = &body;
+	JobCounter counter;
+	uint32_t first_end = count < grain_size ? count : grain_size;
+	for (uint32_t begin = first_end; begin < count; begin += grain_size) {
+		uint32_t end = count - begin < grain_size ? count : begin + grain_size;
+		submit_job(system, Job{ run_chunk, &parallel, begin, end, &counter });
+	}
+	run_chunk(&parallel, 0, first_end);
+	wait_for_jobs(system, counter);
+
+	if (parallel.error) {
+		std::rethrow_exception(parallel.error);
+	}
+}
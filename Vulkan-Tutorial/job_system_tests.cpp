@@ -0,0 +1,239 @@
+// Tests for the work stealing job system. Ordering is only checked on systems with a single thread, where
+// nothing runs until the test asks for it, everything else runs on several threads.
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "job_system.h"
+#include "test_helpers.h"
+
+const uint32_t TEST_THREAD_COUNT = 4;
+
+// Appends the job's begin to a std::vector<uint32_t>, only safe while one thread runs the jobs
+static void record_job(void* data, uint32_t begin, uint32_t) {
+	static_cast<std::vector<uint32_t>*>(data)->push_back(begin);
+}
+
+static void test_own_queue_runs_newest_first() {
+	JobSystem system;
+	start_job_system(system, 1);
+	std::vector<uint32_t> order;
+	JobCounter counter;
+	for (uint32_t i = 0; i < 5; ++i) {
+		submit_job(system, Job{ record_job, &order, i, i + 1, &counter });
+	}
+	CHECK(order.empty());
+	wait_for_jobs(system, counter);
+	stop_job_system(system);
+
+	CHECK(order == std::vector<uint32_t>({ 4, 3, 2, 1, 0 }));
+}
+
+// A thread outside the system has no queue of its own, so all it can do is steal
+static void test_thieves_take_oldest_first() {
+	JobSystem system;
+	start_job_system(system, 1);
+	std::vector<uint32_t> order;
+	JobCounter counter;
+	for (uint32_t i = 0; i < 5; ++i) {
+		submit_job(system, Job{ record_job, &order, i, i + 1, &counter });
+	}
+	std::thread thief([&system, &counter] {
+		CHECK(get_job_thread_index(system) == get_job_thread_count(system));
+		wait_for_jobs(system, counter);
+	});
+	thief.join();
+	stop_job_system(system);
+
+	CHECK(order == std::vector<uint32_t>({ 0, 1, 2, 3, 4 }));
+	CHECK(system.steal_count.load() == 5);
+}
+
+static void test_full_queue_runs_jobs_inline() {
+	JobSystem system;
+	start_job_system(system, 1);
+	std::vector<uint32_t> order;
+	JobCounter counter;
+	for (uint32_t i = 0; i < JOB_QUEUE_CAPACITY; ++i) {
+		submit_job(system, Job{ record_job, &order, i, i + 1, &counter });
+	}
+	CHECK(order.empty());
+	CHECK(system.queued_count.load() == JOB_QUEUE_CAPACITY);
+
+	// No room left, so this one runs before submit_job returns
+	submit_job(system, Job{ record_job, &order, JOB_QUEUE_CAPACITY, JOB_QUEUE_CAPACITY + 1, &counter });
+	CHECK(order == std::vector<uint32_t>({ JOB_QUEUE_CAPACITY }));
+	CHECK(counter.remaining.load() == JOB_QUEUE_CAPACITY);
+
+	wait_for_jobs(system, counter);
+	CHECK(order.size() == JOB_QUEUE_CAPACITY + 1);
+	CHECK(system.queued_count.load() == 0);
+	stop_job_system(system);
+}
+
+// Every job submits children and waits on them from inside the job, three levels deep
+struct NestedJobs {
+	JobSystem* system;
+	std::atomic<uint32_t> leaf_count{ 0 };
+};
+
+static void run_nested_job(void* data, uint32_t depth, uint32_t) {
+	NestedJobs& nested = *static_cast<NestedJobs*>(data);
+	if (depth == 0) {
+		nested.leaf_count.fetch_add(1);
+		return;
+	}
+
+	JobCounter children;
+	for (uint32_t i = 0; i < 8; ++i) {
+		submit_job(*nested.system, Job{ run_nested_job, &nested, depth - 1, depth, &children });
+	}
+	wait_for_jobs(*nested.system, children);
+	CHECK(children.remaining.load() == 0);
+}
+
+static void test_nested_waits_finish() {
+	for (uint32_t thread_count : { 1u, TEST_THREAD_COUNT }) {
+		JobSystem system;
+		start_job_system(system, thread_count);
+		NestedJobs nested;
+		nested.system = &system;
+		JobCounter counter;
+		for (uint32_t i = 0; i < 4; ++i) {
+			submit_job(system, Job{ run_nested_job, &nested, 3, 4, &counter });
+		}
+		wait_for_jobs(system, counter);
+		stop_job_system(system);
+
+		CHECK(counter.remaining.load() == 0);
+		CHECK(nested.leaf_count.load() == 4 * 8 * 8 * 8);
+	}
+}
+
+static void test_parallel_for_covers_every_index_once() {
+	JobSystem system;
+	start_job_system(system, TEST_THREAD_COUNT);
+	for (uint32_t count : { 0u, 1u, 7u, 1000u, 4097u }) {
+		for (uint32_t grain_size : { 0u, 1u, 3u, 64u, 5000u }) {
+			std::vector<std::atomic<uint32_t>> hits(count);
+			std::atomic<uint32_t> oversized_chunks{ 0 };
+			parallel_for(system, count, grain_size, [&](uint32_t begin, uint32_t end) {
+				if (end - begin > std::max(grain_size, 1u)) {
+					oversized_chunks.fetch_add(1);
+				}
+				for (uint32_t i = begin; i < end; ++i) {
+					hits[i].fetch_add(1);
+				}
+			});
+
+			uint32_t wrong_indices = 0;
+			for (const std::atomic<uint32_t>& hit : hits) {
+				wrong_indices += hit.load() == 1 ? 0 : 1;
+			}
+			CHECK(wrong_indices == 0);
+			CHECK(oversized_chunks.load() == 0);
+		}
+	}
+	stop_job_system(system);
+}
+
+// On one thread the calling thread runs chunk 0 first, so its exception is the first one thrown
+static void test_parallel_for_rethrows_the_first_exception() {
+	JobSystem system;
+	start_job_system(system, 1);
+	uint32_t chunks_run = 0;
+	std::string message;
+	try {
+		parallel_for(system, 8, 1, [&chunks_run](uint32_t begin, uint32_t) {
+			chunks_run++;
+			if (begin == 0 || begin == 5) {
+				throw std::runtime_error("chunk " + std::to_string(begin));
+			}
+		});
+	}
+	catch (const std::runtime_error& error) {
+		message = error.what();
+	}
+	stop_job_system(system);
+
+	CHECK(message == "chunk 0");
+	// The rest still ran, and nothing was left on the counter
+	CHECK(chunks_run == 8);
+}
+
+static void test_parallel_for_rethrows_on_several_threads() {
+	JobSystem system;
+	start_job_system(system, TEST_THREAD_COUNT);
+	std::atomic<uint32_t> chunks_run{ 0 };
+	bool thrown = false;
+	try {
+		parallel_for(system, 64, 1, [&chunks_run](uint32_t begin, uint32_t) {
+			chunks_run.fetch_add(1);
+			if (begin == 37) {
+				throw std::runtime_error("chunk 37");
+			}
+		});
+	}
+	catch (const std::runtime_error& error) {
+		thrown = std::string(error.what()) == "chunk 37";
+	}
+	stop_job_system(system);
+
+	CHECK(thrown);
+	CHECK(chunks_run.load() == 64);
+}
+
+// Every job bumps the count, odd ones throw
+static void throw_on_odd_job(void* data, uint32_t begin, uint32_t) {
+	static_cast<std::atomic<uint32_t>*>(data)->fetch_add(1);
+	if (begin % 2 == 1) {
+		throw std::runtime_error("job " + std::to_string(begin));
+	}
+}
+
+static void test_wait_rethrows_a_job_exception() {
+	for (uint32_t thread_count : { 1u, TEST_THREAD_COUNT }) {
+		JobSystem system;
+		start_job_system(system, thread_count);
+		std::atomic<uint32_t> jobs_run{ 0 };
+		JobCounter counter;
+		for (uint32_t i = 0; i < 64; ++i) {
+			submit_job(system, Job{ throw_on_odd_job, &jobs_run, i, i + 1, &counter });
+		}
+		std::string message;
+		try {
+			wait_for_jobs(system, counter);
+		}
+		catch (const std::runtime_error& error) {
+			message = error.what();
+		}
+		CHECK(message.rfind("job ", 0) == 0);
+		CHECK(jobs_run.load() == 64);
+		CHECK(counter.remaining.load() == 0);
+
+		// Nothing left over for the next group on the same counter
+		submit_job(system, Job{ throw_on_odd_job, &jobs_run, 0, 1, &counter });
+		wait_for_jobs(system, counter);
+		CHECK(jobs_run.load() == 65);
+		stop_job_system(system);
+	}
+}
+
+int main() {
+	const TestCase tests[] = {
+		{ "own queue runs newest first", test_own_queue_runs_newest_first },
+		{ "thieves take oldest first", test_thieves_take_oldest_first },
+		{ "full queue runs jobs inline", test_full_queue_runs_jobs_inline },
+		{ "nested waits finish", test_nested_waits_finish },
+		{ "parallel_for covers every index once", test_parallel_for_covers_every_index_once },
+		{ "parallel_for rethrows the first exception", test_parallel_for_rethrows_the_first_exception },
+		{ "parallel_for rethrows on several threads", test_parallel_for_rethrows_on_several_threads },
+		{ "wait rethrows a job exception", test_wait_rethrows_a_job_exception },
+	};
+
+	return run_tests(tests);
+}
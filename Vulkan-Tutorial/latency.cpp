@@ -0,0 +1,51 @@
+#include "latency.h"
+
+#include <algorithm>
+#include <iostream>
+
+uint32_t get_latency_policy_index(PresentPolicy present_policy, bool wait_before_acquire) {
+	return static_cast<uint32_t>(present_policy) * 2 + (wait_before_acquire ? 1 : 0);
+}
+
+void record_input(LatencyTracker& tracker, std::chrono::steady_clock::time_point input_time) {
+	// Later inputs before the next frame are shown by the same frame, so the oldest one is the latency that counts
+	if (tracker.input_pending) {
+		return;
+	}
+
+	tracker.input_pending = true;
+	tracker.oldest_pending_input = input_time;
+}
+
+void record_frame_latency(LatencyTracker& tracker, uint32_t policy_index, std::chrono::steady_clock::time_point sampled,
+std::chrono::steady_clock::time_point submitted, std::chrono::steady_clock::time_point presented) {
+	// Frames without new input have nothing to measure
+	if (!tracker.input_pending || tracker.oldest_pending_input > sampled) {
+		return;
+	}
+
+	LatencyStats& stats = tracker.stats[policy_index];
+	double input_to_present = std::chrono::duration<double>(presented - tracker.oldest_pending_input).count();
+	stats.frame_count++;
+	stats.input_to_sample_seconds += std::chrono::duration<double>(sampled - tracker.oldest_pending_input).count();
+	stats.input_to_submit_seconds += std::chrono::duration<double>(submitted - tracker.oldest_pending_input).count();
+	stats.input_to_present_seconds += input_to_present;
+	stats.max_input_to_present_seconds = std::max(stats.max_input_to_present_seconds, input_to_present);
+
+	tracker.input_pending = false;
+}
+
+void report_latency(const LatencyTracker& tracker) {
+	std::cout << "Input latency (present mode / wait before acquire / frames / mean ms to sample / submit / present / max ms to present):\n";
+	for (uint32_t i = 0; i < LATENCY_POLICY_COUNT; ++i) {
+		const LatencyStats& stats = tracker.stats[i];
+		if (stats.frame_count == 0) {
+			continue;
+		}
+
+		double to_ms = 1000.0 / stats.frame_count;
+		std::cout << '\t' << get_present_policy_name(static_cast<PresentPolicy>(i / 2)) << " / " << (i % 2 == 1 ? "yes" : "no") << " / "
+			<< stats.frame_count << " / " << stats.input_to_sample_seconds * to_ms << " / " << stats.input_to_submit_seconds * to_ms << " / "
+			<< stats.input_to_present_seconds * to_ms << " / " << stats.max_input_to_present_seconds * 1000.0 << '\n';
+	}
+}
@@ -0,0 +1,34 @@
+// Input to present latency. The message loop timestamps input events, draw_frame timestamps when that
+// input was sampled into the uniforms, when the frame was submitted and when the present call returned.
+// Present is as close to photons as we can get without VK_GOOGLE_display_timing, so these numbers are a
+// lower bound on what the user sees, but they are comparable between present policies.
+
+#pragma once
+#include <cstdint>
+#include <array>
+#include <chrono>
+
+#include "settings.h"
+
+// One bucket per present policy with and without waiting before acquire
+const uint32_t LATENCY_POLICY_COUNT = PRESENT_POLICY_COUNT * 2;
+
+struct LatencyStats {
+	uint64_t frame_count = 0;
+	double input_to_sample_seconds = 0.0;
+	double input_to_submit_seconds = 0.0;
+	double input_to_present_seconds = 0.0;
+	double max_input_to_present_seconds = 0.0;
+};
+
+struct LatencyTracker {
+	bool input_pending = false;
+	std::chrono::steady_clock::time_point oldest_pending_input; // the first input the next frame will show
+	std::array<LatencyStats, LATENCY_POLICY_COUNT> stats;
+};
+
+uint32_t get_latency_policy_index(PresentPolicy present_policy, bool wait_before_acquire);
+void record_input(LatencyTracker& tracker, std::chrono::steady_clock::time_point input_time);
+void record_frame_latency(LatencyTracker& tracker, uint32_t policy_index, std::chrono::steady_clock::time_point sampled,
+	std::chrono::steady_clock::time_point submitted, std::chrono::steady_clock::time_point presented);
+void report_latency(const LatencyTracker& tracker);
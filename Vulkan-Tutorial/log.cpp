@@ -0,0 +1,202 @@
+#include "log.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct LogRing {
+	std::array<LogMessage, LOG_RING_CAPACITY> messages;
+	std::atomic<uint32_t> write_index{ 0 }; // only advanced by the owning thread
+	std::atomic<uint32_t> read_index{ 0 }; // only advanced by the writer
+	std::atomic<uint64_t> dropped{ 0 };
+};
+
+// Rings are never freed while the process runs, a thread that exits hands its ring back for the next one
+struct LogRegistry {
+	std::mutex mutex;
+	std::vector<std::unique_ptr<LogRing>> rings;
+	std::vector<LogRing*> free_rings;
+	std::atomic<bool> running{ false };
+	std::thread writer;
+	std::vector<LogMessage> batch; // only touched by the writer until it is joined
+	std::string output; // same
+	uint64_t reported_dropped = 0;
+};
+
+static LogRegistry& get_log_registry() {
+	static LogRegistry registry;
+	return registry;
+}
+
+struct ThreadLogRingHandle {
+	LogRing* ring = nullptr;
+
+	~ThreadLogRingHandle() {
+		if (ring != nullptr) {
+			LogRegistry& registry = get_log_registry();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+			registry.free_rings.push_back(ring);
+		}
+	}
+};
+
+static LogRing* get_thread_log_ring() {
+	thread_local ThreadLogRingHandle handle;
+	if (handle.ring == nullptr) {
+		LogRegistry& registry = get_log_registry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		if (!registry.free_rings.empty()) {
+			handle.ring = registry.free_rings.back();
+			registry.free_rings.pop_back();
+		}
+		else {
+			registry.rings.push_back(std::make_unique<LogRing>());
+			handle.ring = registry.rings.back().get();
+		}
+	}
+
+	return handle.ring;
+}
+
+static void append_log_line(std::string& output, LogLevel level, const char* text) {
+	if (level != LOG_LEVEL_INFO) {
+		output += get_log_level_name(level);
+		output += ": ";
+	}
+	output += text;
+	output += '\n';
+}
+
+void log_message(LogLevel level, const char* format, ...) {
+	va_list arguments;
+	va_start(arguments, format);
+	LogRegistry& registry = get_log_registry();
+	if (!registry.running.load(std::memory_order_relaxed)) {
+		std::array<char, LOG_MESSAGE_SIZE> text;
+		std::vsnprintf(text.data(), text.size(), format, arguments);
+		va_end(arguments);
+
+		std::string line;
+		append_log_line(line, level, text.data());
+		std::cout << line << std::flush;
+		return;
+	}
+
+	LogRing* ring = get_thread_log_ring();
+	uint32_t write_index = ring->write_index.load(std::memory_order_relaxed);
+	uint32_t read_index = ring->read_index.load(std::memory_order_acquire);
+	if (write_index - read_index >= LOG_RING_CAPACITY) {
+		va_end(arguments);
+		ring->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	LogMessage& message = ring->messages[write_index & (LOG_RING_CAPACITY - 1)];
+	message.level = level;
+	message.time = std::chrono::steady_clock::now();
+	std::vsnprintf(message.text.data(), message.text.size(), format, arguments);
+	va_end(arguments);
+	ring->write_index.store(write_index + 1, std::memory_order_release);
+}
+
+// The first call that finds the window over starts a new one and logs how many were held back in the last
+bool pass_log_rate_limit(LogRateLimit& limit, LogLevel level, uint32_t max_per_second) {
+	int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	int64_t window_start_ms = limit.window_start_ms.load(std::memory_order_relaxed);
+	if (now_ms - window_start_ms >= 1000 && limit.window_start_ms.compare_exchange_strong(window_start_ms, now_ms, std::memory_order_relaxed)) {
+		limit.window_count.store(0, std::memory_order_relaxed);
+		uint32_t suppressed = limit.suppressed.exchange(0, std::memory_order_relaxed);
+		if (suppressed > 0) {
+			log_message(level, "%u similar messages suppressed", suppressed);
+		}
+	}
+
+	if (limit.window_count.fetch_add(1, std::memory_order_relaxed) < max_per_second) {
+		return true;
+	}
+	limit.suppressed.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+// Messages from different threads are put back in the order they were logged before writing
+static void write_log_batch(LogRegistry& registry) {
+	uint64_t dropped = 0;
+	{
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		for (const std::unique_ptr<LogRing>& ring : registry.rings) {
+			uint32_t read_index = ring->read_index.load(std::memory_order_relaxed);
+			uint32_t write_index = ring->write_index.load(std::memory_order_acquire);
+			for (; read_index != write_index; ++read_index) {
+				registry.batch.push_back(ring->messages[read_index & (LOG_RING_CAPACITY - 1)]);
+			}
+			ring->read_index.store(read_index, std::memory_order_release);
+			dropped += ring->dropped.load(std::memory_order_relaxed);
+		}
+	}
+	if (registry.batch.empty() && dropped == registry.reported_dropped) {
+		return;
+	}
+
+	std::stable_sort(registry.batch.begin(), registry.batch.end(), [](const LogMessage& a, const LogMessage& b) { return a.time < b.time; });
+	registry.output.clear();
+	for (const LogMessage& message : registry.batch) {
+		append_log_line(registry.output, message.level, message.text.data());
+	}
+	if (dropped != registry.reported_dropped) {
+		append_log_line(registry.output, LOG_LEVEL_WARNING, ("Dropped " + std::to_string(dropped - registry.reported_dropped) + " log messages, the writer fell behind").c_str());
+		registry.reported_dropped = dropped;
+	}
+	registry.batch.clear();
+
+	std::cout << registry.output << std::flush;
+}
+
+static void run_log_writer(LogRegistry* registry) {
+	while (registry->running.load(std::memory_order_relaxed)) {
+		write_log_batch(*registry);
+		std::this_thread::sleep_for(std::chrono::milliseconds(LOG_WRITE_INTERVAL_MS));
+	}
+}
+
+void start_logger() {
+	LogRegistry& registry = get_log_registry();
+	if (registry.running.load()) {
+		return;
+	}
+
+	registry.batch.reserve(LOG_RING_CAPACITY);
+	registry.running.store(true);
+	registry.writer = std::thread(run_log_writer, &registry);
+}
+
+void stop_logger() {
+	LogRegistry& registry = get_log_registry();
+	if (!registry.running.load()) {
+		return;
+	}
+
+	registry.running.store(false);
+	registry.writer.join();
+	write_log_batch(registry);
+}
+
+const char* get_log_level_name(LogLevel level) {
+	switch (level) {
+	case LOG_LEVEL_DEBUG:
+		return "Debug";
+	case LOG_LEVEL_INFO:
+		return "Info";
+	case LOG_LEVEL_WARNING:
+		return "Warning";
+	case LOG_LEVEL_ERROR:
+		return "Error";
+	default:
+		return "Unknown";
+	}
+}
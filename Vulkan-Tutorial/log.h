@@ -0,0 +1,77 @@
+// Diagnostics that stay off the calling thread. LOG_INFO("...", ...) formats printf style straight into a
+// fixed-size slot in the calling thread's ring buffer and returns, a writer thread drains every ring in the
+// background and writes whole batches to std::cout with a single flush. Like the profile zones (see
+// profile.h), each ring has one writer and one reader so logging never takes a lock, and a full ring drops
+// the message rather than waiting. Messages below LOG_MIN_LEVEL compile to nothing, which leaves out debug
+// messages in release builds, and LOG_RATE_LIMITED caps how often a single call site can log. Before
+// start_logger and after stop_logger messages are written synchronously. The report tables printed at
+// exit still go straight to std::cout, they're printed once the logger is stopped. Reports that can also come
+// up mid run, the startup task graph and memory usage, are logged a line at a time instead.
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+enum LogLevel {
+	LOG_LEVEL_DEBUG,
+	LOG_LEVEL_INFO,
+	LOG_LEVEL_WARNING,
+	LOG_LEVEL_ERROR,
+	LOG_LEVEL_COUNT
+};
+
+#ifndef LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define LOG_MIN_LEVEL LOG_LEVEL_INFO
+#else
+#define LOG_MIN_LEVEL LOG_LEVEL_DEBUG
+#endif
+#endif
+
+const uint32_t LOG_RING_CAPACITY = 256; // messages per thread, must be a power of two
+const uint32_t LOG_MESSAGE_SIZE = 240; // longer messages are cut off
+const uint32_t LOG_WRITE_INTERVAL_MS = 10;
+
+struct LogMessage {
+	LogLevel level;
+	std::chrono::steady_clock::time_point time;
+	std::array<char, LOG_MESSAGE_SIZE> text;
+};
+
+// One per call site, see LOG_RATE_LIMITED
+struct LogRateLimit {
+	std::atomic<int64_t> window_start_ms{ 0 };
+	std::atomic<uint32_t> window_count{ 0 };
+	std::atomic<uint32_t> suppressed{ 0 };
+};
+
+#if defined(__GNUC__)
+#define LOG_PRINTF_FORMAT(format_index, first_argument) __attribute__((format(printf, format_index, first_argument)))
+#else
+#define LOG_PRINTF_FORMAT(format_index, first_argument)
+#endif
+
+#define LOG(level, ...) do { if ((level) >= LOG_MIN_LEVEL) { log_message((level), __VA_ARGS__); } } while (0)
+#define LOG_DEBUG(...) LOG(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) LOG(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARNING(...) LOG(LOG_LEVEL_WARNING, __VA_ARGS__)
+#define LOG_ERROR(...) LOG(LOG_LEVEL_ERROR, __VA_ARGS__)
+// At most max_per_second messages from this call site each second, the number held back is logged with the
+// first message of the next second that gets through
+#define LOG_RATE_LIMITED(level, max_per_second, ...) do { \
+	if ((level) >= LOG_MIN_LEVEL) { \
+		static LogRateLimit log_rate_limit; \
+		if (pass_log_rate_limit(log_rate_limit, (level), (max_per_second))) { \
+			log_message((level), __VA_ARGS__); \
+		} \
+	} \
+} while (0)
+
+void log_message(LogLevel level, const char* format, ...) LOG_PRINTF_FORMAT(2, 3);
+bool pass_log_rate_limit(LogRateLimit& limit, LogLevel level, uint32_t max_per_second);
+void start_logger();
+// Writes out everything logged so far. Messages logged by other threads while it stops can be lost
+void stop_logger();
+const char* get_log_level_name(LogLevel level);
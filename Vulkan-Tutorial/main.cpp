@@ -1,11 +1,24 @@
 #include <iostream>
+#include <string>
 
+#include "headless.h"
+#include "settings.h"
+#include "frame_throttle.h"
+#include "log.h"
+
+#ifdef _WIN32
 #include "application.h"
 #include "win32.h"
 
 #define OS WINDOWS
 
 int WINAPI WinMain(HINSTANCE hinst, HINSTANCE hprevinst, LPSTR lpcmdline, int ncmdshow) {
+	Settings settings = parse_settings(lpcmdline);
+	start_logger();
+	if (settings.headless) {
+		return run_headless(settings);
+	}
+
 #pragma region Win32
 
 	WNDCLASSEX window_class; // information for window class
@@ -48,31 +61,55 @@ int WINAPI WinMain(HINSTANCE hinst, HINSTANCE hprevinst, LPSTR lpcmdline, int nc
 
 #pragma endregion
 
-	Vulkan vulkan = init_vulkan(hinst, hwnd);
-	double input = 0;
-	double cam_position = 3;
+	Platform platform = create_win32_platform(hinst, hwnd);
+	Vulkan vulkan = init_vulkan(platform, settings);
+	bool up_held = false;
+	bool down_held = false;
+	Simulation simulation;
+	start_simulation(simulation, SceneState{});
+	std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+	Benchmark benchmark = create_benchmark(settings.warmup_frames, settings.frame_count);
+	uint32_t benchmark_frame = 0;
+	FrameThrottle throttle = create_frame_throttle(settings.max_frame_rate);
+	bool scene_paused = false;
+	bool redraw_needed = true; // something other than the scene changed what the window should show
+	bool swap_chain_pending = false; // recreation was put off while the window was minimized
+	std::chrono::steady_clock::time_point last_input_time = start_time;
 
 #pragma region Loop
 	// Message handling
 	MSG msg = { 0 };
-	while (TRUE) {
-		std::cout << "loop" << std::endl;
-		// Message handling
-		if (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+	bool quit = false;
+	while (!quit) {
+		// Every pending message is handled before the next frame, so a burst of input can't hold back rendering.
+		// Keys only set what is held, the simulation thread turns that into movement at its own fixed rate
+		while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
 			TranslateMessage(&msg);
 			DispatchMessage(&msg);
 			if (msg.message == WM_QUIT) {
+				quit = true;
 				break;
 			}
+			if (msg.message == WM_KEYDOWN || msg.message == WM_KEYUP) {
+				last_input_time = std::chrono::steady_clock::now();
+				redraw_needed = true;
+				// The scene only counts as static again after a step taken since this input
+				wake_simulation(simulation);
+			}
+			if (msg.message == WM_PAINT) {
+				redraw_needed = true;
+			}
 
 			if (msg.message == WM_KEYUP) {
 				switch (msg.wParam) {
 				case VK_UP:
-					input += 1;
-					std::cout << "UP" << std::endl;
+					up_held = false;
+					record_input(vulkan.latency, std::chrono::steady_clock::now());
+					LOG_DEBUG("Up released");
 					break;
 				case VK_DOWN:
-					input -= 1;
+					down_held = false;
+					record_input(vulkan.latency, std::chrono::steady_clock::now());
 					break;
 				}
 			}
@@ -80,37 +117,137 @@ int WINAPI WinMain(HINSTANCE hinst, HINSTANCE hprevinst, LPSTR lpcmdline, int nc
 			if (msg.message == WM_KEYDOWN) {
 				switch (msg.wParam) {
 				case VK_UP:
-					input -= 1;
+					up_held = true;
+					record_input(vulkan.latency, std::chrono::steady_clock::now());
 					break;
 				case VK_DOWN:
-					input += 1;
+					down_held = true;
+					record_input(vulkan.latency, std::chrono::steady_clock::now());
+					break;
+				case 'P':
+					if (set_present_policy(vulkan, platform, static_cast<PresentPolicy>((vulkan.present_policy + 1) % PRESENT_POLICY_COUNT), vulkan.wait_before_acquire) == RECREATE_SWAP_CHAIN_WINDOW_MINIMIZED) {
+						swap_chain_pending = true;
+					}
+					redraw_needed = true;
+					break;
+				case 'L':
+					if (set_present_policy(vulkan, platform, vulkan.present_policy, !vulkan.wait_before_acquire) == RECREATE_SWAP_CHAIN_WINDOW_MINIMIZED) {
+						swap_chain_pending = true;
+					}
+					redraw_needed = true;
+					break;
+				case 'R':
+					replace_model(vulkan, MODEL_PATH);
+					break;
+				case 'M':
+					report_memory_usage(vulkan.physical_device);
+					break;
+				case VK_SPACE:
+					scene_paused = !scene_paused;
+					set_simulation_paused(simulation, scene_paused);
+					break;
+				case '1':
+				case '2':
+				case '3':
+				case '4':
+					set_frames_in_flight(vulkan, static_cast<uint32_t>(msg.wParam - '0'));
 					break;
 				}
 			}
 
-			cam_position += input * 0.1;
+			set_simulation_input(simulation, (down_held ? 1 : 0) - (up_held ? 1 : 0));
 		}
-		else {
-			DrawFrameResult draw_result = draw_frame(vulkan, hwnd, cam_position);
-			if (draw_result == DRAW_FRAME_RECREATION_REQUESTED) {
-				RecreateSwapChainResult recreate_result = recreate_swap_chain(vulkan, hwnd);
-				if (recreate_result == RECREATE_SWAP_CHAIN_WINDOW_MINIMIZED) {
-					IVec2 window_size = get_window_size(hwnd);
-					while (window_size.x == 0 || window_size.y == 0) {
-						window_size = get_window_size(hwnd);
-						std::cout << "GETTING SIZE" << std::endl;
-					}
-				}
-			}
+		if (quit) {
+			break;
+		}
+
+		// Blocks until a message arrives rather than polling the window size while minimized
+		if (swap_chain_pending && recreate_swap_chain(vulkan, platform) == RECREATE_SWAP_CHAIN_SUCCESS) {
+			swap_chain_pending = false;
+		}
+		bool hidden = swap_chain_pending || is_platform_hidden(platform);
+		set_simulation_hidden(simulation, hidden);
+		if (hidden) {
+			set_throttle_mode(throttle, THROTTLE_MODE_HIDDEN);
+			WaitMessage();
+			redraw_needed = true;
+			continue;
+		}
+
+		// A paused scene with no keys held can only change through a message, so there's no point drawing
+		// it again until one arrives. It has to have settled in a step taken after the last input first,
+		// so the last frame drawn shows where it came to rest
+		const SceneSnapshot& latest_scene = read_scene_snapshot(simulation);
+		bool scene_static = scene_paused && !up_held && !down_held && latest_scene.current_time > last_input_time && is_scene_settled(latest_scene);
+		if (scene_static && !redraw_needed && !settings.continuous && !settings.benchmark) {
+			set_throttle_mode(throttle, THROTTLE_MODE_IDLE);
+			WaitMessage();
+			continue;
+		}
+		set_throttle_mode(throttle, THROTTLE_MODE_RENDERING);
+
+		// The low latency wait and the frame cap both happen before drawing, so go around again to take in any
+		// input that arrived during them
+		if (pace_frame(vulkan) || wait_for_frame_slot(throttle)) {
+			continue;
+		}
+
+		// Benchmarks ignore input and follow the fixed camera path until enough frames are measured
+		SceneSnapshot scene = read_scene_snapshot(simulation);
+		if (settings.benchmark) {
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+			scene = get_still_scene_snapshot(get_benchmark_camera_position(benchmark_frame++), seconds);
+		}
+
+		DrawFrameResult draw_result = draw_frame(vulkan, scene);
+		record_throttled_frame(throttle);
+		// A frame drawn mid movement isn't where the scene comes to rest, so one more is needed once it settles
+		redraw_needed = !is_scene_settled(scene);
+		if (settings.benchmark && draw_result == DRAW_FRAME_SUCCESS && record_benchmark_frame(benchmark, vulkan.last_frame_timings)) {
+			break;
+		}
+		if (draw_result == DRAW_FRAME_RECREATION_REQUESTED) {
+			swap_chain_pending = recreate_swap_chain(vulkan, platform) == RECREATE_SWAP_CHAIN_WINDOW_MINIMIZED;
+			redraw_needed = true;
 		}
-		vkDeviceWaitIdle(vulkan.device);
 	}
 
 #pragma endregion
 
 #pragma region Cleanup
 
+	stop_simulation(simulation);
+	// Frames are no longer waited on every iteration, so let the last ones finish before tearing down
+	vkDeviceWaitIdle(vulkan.device);
+	// The reports below are written straight out, so anything still queued goes first
+	stop_logger();
+	report_frame_pacing(vulkan);
+	report_dynamic_resolution(vulkan.dynamic_resolution);
+	report_latency(vulkan.latency);
+	report_pipeline_statistics(vulkan.pipeline_statistics);
+	report_memory_usage(vulkan.physical_device);
+	report_frame_throttle(throttle);
+	destroy_frame_throttle(throttle);
+	if (settings.benchmark) {
+		report_benchmark(benchmark, settings.report_path);
+	}
 	cleanup_vulkan(vulkan);
+	report_host_allocations();
 
 #pragma endregion
-}
\ No newline at end of file
+}
+#else
+// There is only a Win32 window backend, so anywhere else always runs headless
+int main(int argc, char** argv) {
+	std::string command_line;
+	for (int i = 1; i < argc; ++i) {
+		command_line += argv[i];
+		command_line += ' ';
+	}
+
+	Settings settings = parse_settings(command_line);
+	settings.headless = true;
+	start_logger();
+	return run_headless(settings);
+}
+#endif
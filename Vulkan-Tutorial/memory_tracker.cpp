@@ -0,0 +1,168 @@
+#include "memory_tracker.h"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+
+#include "host_allocator.h"
+#include "log.h"
+
+struct TrackedAllocation {
+	MemoryCategory category;
+	VkDeviceSize size;
+	uint32_t memory_type_index;
+};
+
+struct CategoryUsage {
+	VkDeviceSize live_bytes = 0;
+	VkDeviceSize peak_bytes = 0;
+	uint32_t live_count = 0;
+	uint64_t total_count = 0; // allocations ever made, churn shows up as total far above live
+};
+
+struct MemoryTracker {
+	std::mutex mutex;
+	std::unordered_map<VkDeviceMemory, TrackedAllocation> allocations;
+	std::array<CategoryUsage, MEMORY_CATEGORY_COUNT> categories;
+	VkDeviceSize live_bytes = 0;
+	VkDeviceSize peak_bytes = 0;
+	bool memory_budget_enabled = false;
+};
+
+static MemoryTracker& get_memory_tracker() {
+	static MemoryTracker tracker;
+	return tracker;
+}
+
+static double to_mib(VkDeviceSize bytes) {
+	return bytes / (1024.0 * 1024.0);
+}
+
+void set_memory_budget_enabled(bool enabled) {
+	MemoryTracker& tracker = get_memory_tracker();
+	std::lock_guard<std::mutex> lock(tracker.mutex);
+	tracker.memory_budget_enabled = enabled;
+}
+
+void track_device_memory(VkDeviceMemory memory, MemoryCategory category, VkDeviceSize size, uint32_t memory_type_index) {
+	MemoryTracker& tracker = get_memory_tracker();
+	std::lock_guard<std::mutex> lock(tracker.mutex);
+	tracker.allocations[memory] = { category, size, memory_type_index };
+
+	CategoryUsage& usage = tracker.categories[category];
+	usage.live_bytes += size;
+	usage.peak_bytes = std::max(usage.peak_bytes, usage.live_bytes);
+	usage.live_count++;
+	usage.total_count++;
+	tracker.live_bytes += size;
+	tracker.peak_bytes = std::max(tracker.peak_bytes, tracker.live_bytes);
+}
+
+// Also frees memory the tracker never saw, but complains, since that's an allocation site that was missed
+void free_device_memory(VkDevice device, VkDeviceMemory memory) {
+	if (memory == VK_NULL_HANDLE) {
+		return;
+	}
+
+	{
+		MemoryTracker& tracker = get_memory_tracker();
+		std::lock_guard<std::mutex> lock(tracker.mutex);
+		auto allocation = tracker.allocations.find(memory);
+		if (allocation != tracker.allocations.end()) {
+			CategoryUsage& usage = tracker.categories[allocation->second.category];
+			usage.live_bytes -= allocation->second.size;
+			usage.live_count--;
+			tracker.live_bytes -= allocation->second.size;
+			tracker.allocations.erase(allocation);
+		}
+		else {
+			LOG_WARNING("Freeing untracked device memory");
+		}
+	}
+
+	vkFreeMemory(device, memory, get_host_allocator(HOST_ARENA_MEMORY));
+}
+
+// Logged rather than printed, since the M key asks for it while the logger is running
+void report_memory_usage(VkPhysicalDevice physical_device) {
+	MemoryTracker& tracker = get_memory_tracker();
+	std::lock_guard<std::mutex> lock(tracker.mutex);
+
+	LOG_INFO("Device memory (category / live allocations / live MiB / peak MiB / allocations made):");
+	for (uint32_t category = 0; category < MEMORY_CATEGORY_COUNT; ++category) {
+		const CategoryUsage& usage = tracker.categories[category];
+		LOG_INFO("\t%s / %u / %g / %g / %llu", get_memory_category_name(static_cast<MemoryCategory>(category)), usage.live_count,
+			to_mib(usage.live_bytes), to_mib(usage.peak_bytes), static_cast<unsigned long long>(usage.total_count));
+	}
+	LOG_INFO("\ttotal / %zu / %g / %g", tracker.allocations.size(), to_mib(tracker.live_bytes), to_mib(tracker.peak_bytes));
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+	budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+	VkPhysicalDeviceMemoryProperties2 memory_properties{};
+	memory_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+	memory_properties.pNext = tracker.memory_budget_enabled ? &budget : nullptr;
+	vkGetPhysicalDeviceMemoryProperties2(physical_device, &memory_properties);
+
+	std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> tracked_heap_bytes{};
+	for (const auto& allocation : tracker.allocations) {
+		tracked_heap_bytes[memory_properties.memoryProperties.memoryTypes[allocation.second.memory_type_index].heapIndex] += allocation.second.size;
+	}
+
+	if (tracker.memory_budget_enabled) {
+		LOG_INFO("Memory heaps (heap / size MiB / tracked MiB / process usage MiB / budget MiB):");
+	}
+	else {
+		LOG_INFO("Memory heaps, no VK_EXT_memory_budget (heap / size MiB / tracked MiB):");
+	}
+	for (uint32_t heap = 0; heap < memory_properties.memoryProperties.memoryHeapCount; ++heap) {
+		const VkMemoryHeap& memory_heap = memory_properties.memoryProperties.memoryHeaps[heap];
+		const char* device_local = (memory_heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device local)" : "";
+		if (tracker.memory_budget_enabled) {
+			LOG_INFO("\t%u%s / %g / %g / %g / %g", heap, device_local, to_mib(memory_heap.size), to_mib(tracked_heap_bytes[heap]),
+				to_mib(budget.heapUsage[heap]), to_mib(budget.heapBudget[heap]));
+		}
+		else {
+			LOG_INFO("\t%u%s / %g / %g", heap, device_local, to_mib(memory_heap.size), to_mib(tracked_heap_bytes[heap]));
+		}
+	}
+}
+
+// Called once everything has been destroyed, so whatever is left was never freed
+void report_memory_leaks() {
+	MemoryTracker& tracker = get_memory_tracker();
+	std::lock_guard<std::mutex> lock(tracker.mutex);
+	std::cout << "Peak device memory " << to_mib(tracker.peak_bytes) << " MiB\n";
+	if (tracker.allocations.empty()) {
+		return;
+	}
+
+	std::cout << "Leaked device memory (category / MiB):\n";
+	for (const auto& allocation : tracker.allocations) {
+		std::cout << '\t' << get_memory_category_name(allocation.second.category) << " / " << to_mib(allocation.second.size) << '\n';
+	}
+}
+
+const char* get_memory_category_name(MemoryCategory category) {
+	switch (category) {
+	case MEMORY_CATEGORY_VERTEX:
+		return "vertex";
+	case MEMORY_CATEGORY_INDEX:
+		return "index";
+	case MEMORY_CATEGORY_TEXTURE:
+		return "texture";
+	case MEMORY_CATEGORY_DEPTH:
+		return "depth";
+	case MEMORY_CATEGORY_UNIFORM:
+		return "uniform";
+	case MEMORY_CATEGORY_STAGING:
+		return "staging";
+	case MEMORY_CATEGORY_RENDER_TARGET:
+		return "render target";
+	case MEMORY_CATEGORY_READBACK:
+		return "readback";
+	default:
+		return "unknown";
+	}
+}
@@ -0,0 +1,29 @@
+// Device memory accounting. Every vkAllocateMemory goes through create_vulkan_buffer or create_vulkan_image,
+// which tag the allocation with a category, and every free goes through free_device_memory. There is one
+// device per process, so the tracker is process wide and locked, since startup allocates from several
+// threads. When VK_EXT_memory_budget is enabled the report also shows what the driver says each heap has
+// left, which includes other processes and the driver's own allocations.
+
+#pragma once
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+enum MemoryCategory {
+	MEMORY_CATEGORY_VERTEX,
+	MEMORY_CATEGORY_INDEX,
+	MEMORY_CATEGORY_TEXTURE,
+	MEMORY_CATEGORY_DEPTH,
+	MEMORY_CATEGORY_UNIFORM,
+	MEMORY_CATEGORY_STAGING,
+	MEMORY_CATEGORY_RENDER_TARGET, // scene color and headless offscreen images
+	MEMORY_CATEGORY_READBACK,
+	MEMORY_CATEGORY_COUNT
+};
+
+void set_memory_budget_enabled(bool enabled);
+void track_device_memory(VkDeviceMemory memory, MemoryCategory category, VkDeviceSize size, uint32_t memory_type_index);
+void free_device_memory(VkDevice device, VkDeviceMemory memory);
+void report_memory_usage(VkPhysicalDevice physical_device);
+void report_memory_leaks();
+const char* get_memory_category_name(MemoryCategory category);
@@ -0,0 +1,260 @@
+// Microbenchmarks for the CPU hot paths that don't need a GPU: OBJ parsing and vertex dedup, the Vertex
+// hash, read_file, texture decode, the uniform buffer math and world matrix updates in a large transform
+// hierarchy, plus how the job system scales from one thread up to every core. Inputs are the files in
+// models/ and textures/, so run it from this directory. Not part of Vulkan-Tutorial.vcxproj since it has its
+// own main, it's the microbenchmarks target in CMakeLists.txt.
+// Usage: microbenchmarks [name filter] [--iterations=N]
+
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "model.h"
+#include "texture.h"
+#include "camera.h"
+#include "settings.h"
+#include "benchmark.h"
+#include "file_helpers.h"
+#include "frame_arena.h"
+#include "job_system.h"
+#include "occlusion.h"
+#include "transform_hierarchy.h"
+
+const std::string BENCHMARK_MODEL_PATH = "models/viking_room.obj";
+const std::string BENCHMARK_TEXTURE_PATH = "textures/viking_room.png";
+const std::string BENCHMARK_SHADER_PATH = "vert.spv";
+const uint32_t UNIFORM_BUFFER_OBJECTS_PER_ITERATION = 10000;
+const uint32_t JOB_SCALING_ELEMENT_COUNT = 1 << 20;
+const uint32_t JOB_SCALING_GRAIN_SIZE = 4096;
+const uint32_t JOB_SCALING_ITERATIONS = 20;
+const uint32_t TRANSFORM_BENCHMARK_NODE_COUNT = 1 << 17;
+const uint32_t TRANSFORM_BENCHMARK_CHILDREN = 8; // per node, so the tree is about six levels deep
+const uint32_t TRANSFORM_BENCHMARK_SPARSE_STRIDE = 100; // every hundredth node moves in the sparse case
+
+// Results are folded into this so the optimizer can't drop the work being measured
+static volatile uint64_t benchmark_sink = 0;
+
+struct Microbenchmark {
+	const char* name;
+	uint32_t iterations; // scaled by --iterations, the heavy file loading ones run fewer times
+	std::function<void()> run;
+};
+
+static void run_microbenchmark(const Microbenchmark& benchmark, uint32_t iteration_scale) {
+	benchmark.run(); // warm the caches and the file system
+	uint32_t iterations = std::max(1u, benchmark.iterations * iteration_scale);
+	std::vector<double> seconds;
+	seconds.reserve(iterations);
+	for (uint32_t i = 0; i < iterations; ++i) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		benchmark.run();
+		seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	TimingSummary summary = summarize_timings(seconds);
+	std::cout << '\t' << benchmark.name << " / " << iterations << " / " << summary.min * 1000.0 << " / " << summary.mean * 1000.0
+		<< " / " << summary.p50 * 1000.0 << " / " << summary.p95 * 1000.0 << '\n';
+}
+
+static double time_job_scaling_workload(const std::function<void()>& workload, uint32_t iterations) {
+	workload();
+	std::vector<double> seconds;
+	seconds.reserve(iterations);
+	for (uint32_t i = 0; i < iterations; ++i) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		workload();
+		seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	return summarize_timings(seconds).p50;
+}
+
+// The same work on a job system of 1, 2, 4 ... threads up to every core. The synthetic loop is all parallel
+// so it shows the scheduler's own overhead, the occluder rasterization has a serial triangle setup in front
+// of the parallel tile rows so it won't scale as far
+static void run_job_scaling_benchmark(const OccluderMesh& occluder, uint32_t iteration_scale) {
+	uint32_t max_thread_count = std::clamp(std::thread::hardware_concurrency(), 1u, MAX_JOB_THREADS);
+	uint32_t iterations = std::max(1u, JOB_SCALING_ITERATIONS * iteration_scale);
+	std::vector<float> values(JOB_SCALING_ELEMENT_COUNT);
+	std::vector<OccluderMesh> occluders = { occluder };
+	UniformBufferObject ubo = build_uniform_buffer_object(glm::mat4_cast(get_model_rotation(0.0f)), 800.0f / 600.0f, get_benchmark_camera_position(0));
+	glm::mat4 view_projection = ubo.proj * ubo.view * ubo.model;
+	OcclusionBuffer occlusion_buffer = create_occlusion_buffer(OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT);
+	FrameArena arena = create_frame_arena(FRAME_ARENA_CAPACITY);
+
+	std::vector<uint32_t> thread_counts;
+	for (uint32_t thread_count = 1; thread_count < max_thread_count; thread_count *= 2) {
+		thread_counts.push_back(thread_count);
+	}
+	thread_counts.push_back(max_thread_count);
+
+	double single_thread_loop_seconds = 0.0;
+	double single_thread_rasterize_seconds = 0.0;
+	std::cout << "Job system scaling (threads / parallel_for p50 ms / speedup / rasterize_occluders p50 ms / speedup / steals):\n";
+	for (uint32_t thread_count : thread_counts) {
+		JobSystem jobs;
+		start_job_system(jobs, thread_count);
+
+		double loop_seconds = time_job_scaling_workload([&jobs, &values] {
+			parallel_for(jobs, JOB_SCALING_ELEMENT_COUNT, JOB_SCALING_GRAIN_SIZE, [&values](uint32_t begin, uint32_t end) {
+				for (uint32_t i = begin; i < end; ++i) {
+					float x = static_cast<float>(i);
+					values[i] = std::sqrt(x) * std::sin(x) + std::cos(x * 0.5f);
+				}
+			});
+			benchmark_sink += static_cast<uint64_t>(values[JOB_SCALING_ELEMENT_COUNT / 2]);
+		}, iterations);
+		double rasterize_seconds = time_job_scaling_workload([&] {
+			reset_frame_arena(arena);
+			rasterize_occluders(occlusion_buffer, occluders, view_projection, jobs, arena);
+			benchmark_sink += static_cast<uint64_t>(occlusion_buffer.tile_max_depth[0] * 1000.0f);
+		}, iterations);
+		if (thread_count == 1) {
+			single_thread_loop_seconds = loop_seconds;
+			single_thread_rasterize_seconds = rasterize_seconds;
+		}
+
+		std::cout << '\t' << thread_count << " / " << loop_seconds * 1000.0 << " / " << single_thread_loop_seconds / loop_seconds << "x / "
+			<< rasterize_seconds * 1000.0 << " / " << single_thread_rasterize_seconds / rasterize_seconds << "x / " << jobs.steal_count.load() << '\n';
+		stop_job_system(jobs);
+	}
+}
+
+int main(int argc, char** argv) {
+	std::string filter;
+	uint32_t iteration_scale = 1;
+	for (int i = 1; i < argc; ++i) {
+		std::string argument = argv[i];
+		if (argument.rfind("--iterations=", 0) == 0) {
+			if (!parse_uint(argument.substr(13), iteration_scale) || iteration_scale == 0) {
+				std::cout << "Bad " << argument << ", expected a whole number of at least 1\n"
+					<< "Usage: microbenchmarks [name filter] [--iterations=N]\n";
+				return 1;
+			}
+		}
+		else {
+			filter = argument;
+		}
+	}
+
+	// The dedup and hash benchmarks work on the model as the parser sees it, one vertex per index
+	std::vector<Vertex> model_vertices;
+	std::vector<uint32_t> model_indices;
+	std::vector<DrawItem> model_draw_items;
+	load_model(BENCHMARK_MODEL_PATH, model_vertices, model_indices, model_draw_items);
+	std::vector<Vertex> expanded_vertices;
+	expanded_vertices.reserve(model_indices.size());
+	for (uint32_t index : model_indices) {
+		expanded_vertices.push_back(model_vertices[index]);
+	}
+
+	// A wide tree with every node slightly offset, rotated and scaled from its parent
+	TransformHierarchy transforms;
+	for (uint32_t i = 0; i < TRANSFORM_BENCHMARK_NODE_COUNT; ++i) {
+		uint32_t node = add_transform_node(transforms, i == 0 ? TRANSFORM_NO_PARENT : (i - 1) / TRANSFORM_BENCHMARK_CHILDREN);
+		set_local_position(transforms, node, glm::vec3(1.0f, 0.5f, 0.25f));
+		set_local_rotation(transforms, node, get_model_rotation(i * 0.001f));
+		set_local_scale(transforms, node, glm::vec3(0.99f));
+	}
+	update_world_matrices(transforms);
+	uint32_t transform_frame = 0;
+
+	std::vector<Microbenchmark> benchmarks = {
+		{ "load_model", 10, [] {
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+			std::vector<DrawItem> draw_items;
+			load_model(BENCHMARK_MODEL_PATH, vertices, indices, draw_items);
+			benchmark_sink += vertices.size();
+		} },
+		{ "vertex dedup", 20, [&expanded_vertices] {
+			std::unordered_map<Vertex, uint32_t> unique_vertices{};
+			std::vector<uint32_t> indices;
+			indices.reserve(expanded_vertices.size());
+			for (const Vertex& vertex : expanded_vertices) {
+				auto inserted = unique_vertices.emplace(vertex, static_cast<uint32_t>(unique_vertices.size()));
+				indices.push_back(inserted.first->second);
+			}
+			benchmark_sink += unique_vertices.size();
+		} },
+		{ "hash<Vertex>", 50, [&expanded_vertices] {
+			size_t combined = 0;
+			for (const Vertex& vertex : expanded_vertices) {
+				combined ^= std::hash<Vertex>()(vertex);
+			}
+			benchmark_sink += combined;
+		} },
+		{ "read_file model", 20, [] {
+			benchmark_sink += read_file(BENCHMARK_MODEL_PATH).size();
+		} },
+		{ "read_file shader", 200, [] {
+			benchmark_sink += read_file(BENCHMARK_SHADER_PATH).size();
+		} },
+		{ "texture decode", 10, [] {
+			TexturePixels texture = load_texture_pixels(BENCHMARK_TEXTURE_PATH);
+			benchmark_sink += texture.pixels[0];
+			free_texture_pixels(texture);
+		} },
+		{ "uniform buffer math", 50, [] {
+			float checksum = 0.0f;
+			for (uint32_t i = 0; i < UNIFORM_BUFFER_OBJECTS_PER_ITERATION; ++i) {
+				UniformBufferObject ubo = build_uniform_buffer_object(glm::mat4_cast(get_model_rotation(i * 0.001f)), 800.0f / 600.0f, get_benchmark_camera_position(i));
+				checksum += ubo.model[0][0] + ubo.view[3][2] + ubo.proj[1][1];
+			}
+			benchmark_sink += static_cast<uint64_t>(checksum);
+		} },
+		// The same update done the straightforward way, one glm matrix product per node
+		{ "transform hierarchy glm", 20, [&transforms] {
+			std::vector<glm::mat4>& world_matrices = transforms.world_matrices;
+			for (uint32_t node = 0; node < transforms.node_count; ++node) {
+				glm::mat4 local = glm::mat4_cast(glm::quat(transforms.rotation_w[node], transforms.rotation_x[node], transforms.rotation_y[node], transforms.rotation_z[node]));
+				local[0] *= transforms.scale_x[node];
+				local[1] *= transforms.scale_y[node];
+				local[2] *= transforms.scale_z[node];
+				local[3] = glm::vec4(transforms.position_x[node], transforms.position_y[node], transforms.position_z[node], 1.0f);
+				uint32_t parent = transforms.parents[node];
+				world_matrices[node] = parent == TRANSFORM_NO_PARENT ? local : world_matrices[parent] * local;
+			}
+			benchmark_sink += static_cast<uint64_t>(world_matrices.back()[3][0]);
+		} },
+		{ "transform hierarchy all dirty", 20, [&transforms, &transform_frame] {
+			glm::quat rotation = get_model_rotation(++transform_frame * 0.001f);
+			for (uint32_t node = 0; node < transforms.node_count; ++node) {
+				set_local_rotation(transforms, node, rotation);
+			}
+			benchmark_sink += update_world_matrices(transforms);
+		} },
+		{ "transform hierarchy sparse", 20, [&transforms, &transform_frame] {
+			glm::quat rotation = get_model_rotation(++transform_frame * 0.001f);
+			for (uint32_t node = TRANSFORM_BENCHMARK_SPARSE_STRIDE; node < transforms.node_count; node += TRANSFORM_BENCHMARK_SPARSE_STRIDE) {
+				set_local_rotation(transforms, node, rotation);
+			}
+			benchmark_sink += update_world_matrices(transforms);
+		} },
+	};
+
+	std::cout << "Microbenchmarks (name / iterations / min / mean / p50 / p95 ms):\n";
+	for (const Microbenchmark& benchmark : benchmarks) {
+		if (filter.empty() || std::string(benchmark.name).find(filter) != std::string::npos) {
+			run_microbenchmark(benchmark, iteration_scale);
+		}
+	}
+
+	if (filter.empty() || std::string("job scaling").find(filter) != std::string::npos) {
+		OccluderMesh occluder;
+		for (const Vertex& vertex : model_vertices) {
+			occluder.positions.push_back(vertex.position);
+		}
+		occluder.indices = model_indices;
+		run_job_scaling_benchmark(occluder, iteration_scale);
+	}
+
+	return 0;
+}
@@ -0,0 +1,88 @@
+#include "model.h"
+
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include "profile.h"
+
+void load_model(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<DrawItem>& out_draw_items) {
+	PROFILE_ZONE("load_model");
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string warn;
+	std::string err;
+
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str())) {
+		throw std::runtime_error(warn + err);
+	}
+
+	std::unordered_map<Vertex, uint32_t> unique_vertices{};
+	for (const tinyobj::shape_t& shape : shapes) { // TODO: tutorial used auto here. idk
+		// Each shape becomes its own draw item so it can be culled on its own
+		DrawItem draw_item{};
+		draw_item.first_index = static_cast<uint32_t>(indices.size());
+		draw_item.bounds.min = glm::vec3(std::numeric_limits<float>::max());
+		draw_item.bounds.max = glm::vec3(std::numeric_limits<float>::lowest());
+
+		for (const tinyobj::index_t& index : shape.mesh.indices) {
+			Vertex vertex{};
+
+			vertex.position = {
+				attrib.vertices[3 * index.vertex_index + 0],
+				attrib.vertices[3 * index.vertex_index + 1],
+				attrib.vertices[3 * index.vertex_index + 2]
+			};
+
+			vertex.texture_coordinates = {
+				attrib.texcoords[2 * index.texcoord_index + 0],
+				1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+			};
+
+			vertex.color = { 1.0f, 1.0f, 1.0f };
+
+			if (unique_vertices.count(vertex) == 0) {
+				unique_vertices[vertex] = static_cast<uint32_t>(vertices.size());
+				vertices.push_back(vertex);
+			}
+
+			indices.push_back(unique_vertices[vertex]);
+			draw_item.bounds.min = glm::min(draw_item.bounds.min, vertex.position);
+			draw_item.bounds.max = glm::max(draw_item.bounds.max, vertex.position);
+		}
+
+		draw_item.index_count = static_cast<uint32_t>(indices.size()) - draw_item.first_index;
+		if (draw_item.index_count > 0) {
+			out_draw_items.push_back(draw_item);
+		}
+	}
+}
+
+OccluderMesh load_occluder_mesh(const std::string& path) {
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string warn;
+	std::string err;
+
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str())) {
+		throw std::runtime_error(warn + err);
+	}
+
+	// Occluders only need positions, and there's no point deduplicating something this small
+	OccluderMesh occluder;
+	for (size_t i = 0; i + 2 < attrib.vertices.size(); i += 3) {
+		occluder.positions.push_back(glm::vec3(attrib.vertices[i + 0], attrib.vertices[i + 1], attrib.vertices[i + 2]));
+	}
+	for (const tinyobj::shape_t& shape : shapes) {
+		for (const tinyobj::index_t& index : shape.mesh.indices) {
+			occluder.indices.push_back(static_cast<uint32_t>(index.vertex_index));
+		}
+	}
+
+	return occluder;
+}
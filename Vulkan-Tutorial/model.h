@@ -0,0 +1,45 @@
+// Mesh data as loaded from OBJ files. Deliberately has no Vulkan dependency so the loader can be
+// benchmarked without a GPU (see microbenchmarks.cpp).
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/hash.hpp>
+
+#include "occlusion.h"
+
+struct Vertex {
+	glm::vec3 position;
+	glm::vec3 color;
+	glm::vec2 texture_coordinates;
+
+	bool operator==(const Vertex& other) const {
+		return position == other.position && color == other.color && texture_coordinates == other.texture_coordinates;
+	}
+};
+
+namespace std {
+	template<> struct hash<Vertex> {
+		size_t operator()(Vertex const& vertex) const {
+			return ((hash<glm::vec3>()(vertex.position) ^
+				(hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
+				(hash<glm::vec2>()(vertex.texture_coordinates) << 1);
+		}
+	};
+}
+
+// A range of the shared index buffer that is drawn (or culled) as a unit
+struct DrawItem {
+	uint32_t first_index;
+	uint32_t index_count;
+	OcclusionBox bounds;
+};
+
+void load_model(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<DrawItem>& out_draw_items);
+OccluderMesh load_occluder_mesh(const std::string& path);
@@ -0,0 +1,302 @@
+#include "occlusion.h"
+#include "profile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_USE_SSE
+#include <emmintrin.h>
+#endif
+
+// Triangle set up once in screen space and then shared read-only between the tile jobs.
+// Edge functions and depth are planes of the form a * x + b * y + c.
+struct ScreenTriangle {
+	float edge_a[3];
+	float edge_b[3];
+	float edge_c[3];
+	float depth_a;
+	float depth_b;
+	float depth_c;
+	int32_t min_x;
+	int32_t min_y;
+	int32_t max_x;
+	int32_t max_y;
+};
+
+OcclusionBuffer create_occlusion_buffer(uint32_t width, uint32_t height) {
+	OcclusionBuffer buffer;
+	// Round up to whole tiles so every row can be walked four pixels at a time
+	buffer.tiles_x = (width + OCCLUSION_TILE_SIZE - 1) / OCCLUSION_TILE_SIZE;
+	buffer.tiles_y = (height + OCCLUSION_TILE_SIZE - 1) / OCCLUSION_TILE_SIZE;
+	buffer.width = buffer.tiles_x * OCCLUSION_TILE_SIZE;
+	buffer.height = buffer.tiles_y * OCCLUSION_TILE_SIZE;
+	buffer.depth.resize(static_cast<size_t>(buffer.width) * buffer.height);
+	buffer.tile_max_depth.resize(static_cast<size_t>(buffer.tiles_x) * buffer.tiles_y);
+	clear_occlusion_buffer(buffer);
+
+	return buffer;
+}
+
+void clear_occlusion_buffer(OcclusionBuffer& buffer) {
+	std::fill(buffer.depth.begin(), buffer.depth.end(), 1.0f);
+	std::fill(buffer.tile_max_depth.begin(), buffer.tile_max_depth.end(), 1.0f);
+}
+
+static glm::vec3 project_to_screen(const glm::vec4& clip, const OcclusionBuffer& buffer) {
+	glm::vec3 ndc = glm::vec3(clip) / clip.w;
+	return glm::vec3(
+		(ndc.x * 0.5f + 0.5f) * static_cast<float>(buffer.width),
+		(ndc.y * 0.5f + 0.5f) * static_cast<float>(buffer.height),
+		ndc.z
+	);
+}
+
+static bool setup_triangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, const OcclusionBuffer& buffer, ScreenTriangle& out_triangle) {
+	float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+	if (std::abs(area) < 1e-6f) {
+		return false;
+	}
+
+	// Occluders are rasterized double sided, so just flip to a consistent winding.
+	// Pixels exactly on an edge count as covered by both triangles so shared edges never leave cracks
+	if (area < 0.0f) {
+		std::swap(v1, v2);
+		area = -area;
+	}
+
+	const glm::vec3 vertices[3] = { v0, v1, v2 };
+	for (int i = 0; i < 3; ++i) {
+		glm::vec3 a = vertices[(i + 1) % 3];
+		glm::vec3 b = vertices[(i + 2) % 3];
+
+		// Always build a shared edge from the same endpoint so both triangles get exactly negated planes,
+		// otherwise rounding can leave pixels on the edge outside of both of them
+		float sign = 1.0f;
+		if (a.x > b.x || (a.x == b.x && a.y > b.y)) {
+			std::swap(a, b);
+			sign = -1.0f;
+		}
+
+		out_triangle.edge_a[i] = sign * (a.y - b.y);
+		out_triangle.edge_b[i] = sign * (b.x - a.x);
+		out_triangle.edge_c[i] = sign * ((b.y - a.y) * a.x - (b.x - a.x) * a.y);
+	}
+
+	// Depth is affine in screen space after the perspective divide, so it's a plane built from the barycentrics
+	float inverse_area = 1.0f / area;
+	out_triangle.depth_a = (out_triangle.edge_a[0] * v0.z + out_triangle.edge_a[1] * v1.z + out_triangle.edge_a[2] * v2.z) * inverse_area;
+	out_triangle.depth_b = (out_triangle.edge_b[0] * v0.z + out_triangle.edge_b[1] * v1.z + out_triangle.edge_b[2] * v2.z) * inverse_area;
+	out_triangle.depth_c = (out_triangle.edge_c[0] * v0.z + out_triangle.edge_c[1] * v1.z + out_triangle.edge_c[2] * v2.z) * inverse_area;
+
+	out_triangle.min_x = std::max(0, static_cast<int32_t>(std::floor(std::min({ v0.x, v1.x, v2.x }))));
+	out_triangle.min_y = std::max(0, static_cast<int32_t>(std::floor(std::min({ v0.y, v1.y, v2.y }))));
+	out_triangle.max_x = std::min(static_cast<int32_t>(buffer.width) - 1, static_cast<int32_t>(std::ceil(std::max({ v0.x, v1.x, v2.x }))));
+	out_triangle.max_y = std::min(static_cast<int32_t>(buffer.height) - 1, static_cast<int32_t>(std::ceil(std::max({ v0.y, v1.y, v2.y }))));
+
+	return out_triangle.min_x <= out_triangle.max_x && out_triangle.min_y <= out_triangle.max_y;
+}
+
+static void rasterize_triangle_in_tile(OcclusionBuffer& buffer, const ScreenTriangle& triangle, int32_t tile_min_x, int32_t tile_min_y) {
+	int32_t tile_max_x = tile_min_x + static_cast<int32_t>(OCCLUSION_TILE_SIZE) - 1;
+	int32_t tile_max_y = tile_min_y + static_cast<int32_t>(OCCLUSION_TILE_SIZE) - 1;
+	if (triangle.max_x < tile_min_x || triangle.min_x > tile_max_x || triangle.max_y < tile_min_y || triangle.min_y > tile_max_y) {
+		return;
+	}
+
+	// Start on a 4 pixel boundary so the SIMD loads line up with the row
+	int32_t start_x = std::max(triangle.min_x, tile_min_x) & ~3;
+	int32_t end_x = std::min(triangle.max_x, tile_max_x);
+	int32_t start_y = std::max(triangle.min_y, tile_min_y);
+	int32_t end_y = std::min(triangle.max_y, tile_max_y);
+
+	for (int32_t y = start_y; y <= end_y; ++y) {
+		float pixel_y = static_cast<float>(y) + 0.5f;
+		float row_edge[3];
+		for (int i = 0; i < 3; ++i) {
+			row_edge[i] = triangle.edge_b[i] * pixel_y + triangle.edge_c[i];
+		}
+		float row_depth = triangle.depth_b * pixel_y + triangle.depth_c;
+		float* row = &buffer.depth[static_cast<size_t>(y) * buffer.width];
+
+		for (int32_t x = start_x; x <= end_x; x += 4) {
+			float pixel_x = static_cast<float>(x) + 0.5f;
+#ifdef OCCLUSION_USE_SSE
+			__m128 xs = _mm_add_ps(_mm_set1_ps(pixel_x), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+			__m128 edge0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edge_a[0]), xs), _mm_set1_ps(row_edge[0]));
+			__m128 edge1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edge_a[1]), xs), _mm_set1_ps(row_edge[1]));
+			__m128 edge2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edge_a[2]), xs), _mm_set1_ps(row_edge[2]));
+			__m128 mask = _mm_and_ps(_mm_cmpge_ps(edge0, _mm_setzero_ps()),
+				_mm_and_ps(_mm_cmpge_ps(edge1, _mm_setzero_ps()), _mm_cmpge_ps(edge2, _mm_setzero_ps())));
+			if (_mm_movemask_ps(mask) == 0) {
+				continue;
+			}
+
+			__m128 depth = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.depth_a), xs), _mm_set1_ps(row_depth));
+			__m128 current = _mm_loadu_ps(row + x);
+			__m128 nearest = _mm_min_ps(current, depth);
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(mask, nearest), _mm_andnot_ps(mask, current)));
+#else
+			for (int32_t lane = 0; lane < 4; ++lane) {
+				float lane_x = pixel_x + static_cast<float>(lane);
+				bool inside = true;
+				for (int i = 0; i < 3; ++i) {
+					inside = inside && (triangle.edge_a[i] * lane_x + row_edge[i]) >= 0.0f;
+				}
+				if (inside) {
+					float depth = triangle.depth_a * lane_x + row_depth;
+					row[x + lane] = std::min(row[x + lane], depth);
+				}
+			}
+#endif
+		}
+	}
+}
+
+static void update_tile_max_depth(OcclusionBuffer& buffer, uint32_t tile_x, uint32_t tile_y) {
+	float max_depth = 0.0f;
+	for (uint32_t y = tile_y * OCCLUSION_TILE_SIZE; y < (tile_y + 1) * OCCLUSION_TILE_SIZE; ++y) {
+		const float* row = &buffer.depth[static_cast<size_t>(y) * buffer.width + tile_x * OCCLUSION_TILE_SIZE];
+		for (uint32_t x = 0; x < OCCLUSION_TILE_SIZE; ++x) {
+			max_depth = std::max(max_depth, row[x]);
+		}
+	}
+	buffer.tile_max_depth[tile_y * buffer.tiles_x + tile_x] = max_depth;
+}
+
+void rasterize_occluders(OcclusionBuffer& buffer, const std::vector<OccluderMesh>& occluders, const glm::mat4& view_projection, JobSystem& jobs,
+FrameArena& arena) {
+	clear_occlusion_buffer(buffer);
+
+	// Sized up front, arena memory isn't reused when a vector grows
+	size_t max_triangle_count = 0;
+	size_t max_position_count = 0;
+	for (const OccluderMesh& occluder : occluders) {
+		max_triangle_count += occluder.indices.size() / 3;
+		max_position_count = std::max(max_position_count, occluder.positions.size());
+	}
+
+	// Transform and set up every triangle once, the tile jobs only read from this list
+	ArenaVector<ScreenTriangle> triangles(arena);
+	ArenaVector<glm::vec4> clip_positions(arena);
+	triangles.reserve(max_triangle_count);
+	clip_positions.reserve(max_position_count);
+	for (const OccluderMesh& occluder : occluders) {
+		clip_positions.resize(occluder.positions.size());
+		for (size_t i = 0; i < occluder.positions.size(); ++i) {
+			clip_positions[i] = view_projection * glm::vec4(occluder.positions[i], 1.0f);
+		}
+
+		for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3) {
+			const glm::vec4& c0 = clip_positions[occluder.indices[i + 0]];
+			const glm::vec4& c1 = clip_positions[occluder.indices[i + 1]];
+			const glm::vec4& c2 = clip_positions[occluder.indices[i + 2]];
+
+			// No near plane clipping. Dropping a triangle that crosses it only means less gets culled, never wrong results
+			if (c0.w <= 0.0f || c1.w <= 0.0f || c2.w <= 0.0f || c0.z < 0.0f || c1.z < 0.0f || c2.z < 0.0f) {
+				continue;
+			}
+
+			ScreenTriangle triangle;
+			if (setup_triangle(project_to_screen(c0, buffer), project_to_screen(c1, buffer), project_to_screen(c2, buffer), buffer, triangle)) {
+				triangles.push_back(triangle);
+			}
+		}
+	}
+
+	// Each job owns a whole row of tiles, so no two jobs ever touch the same pixels
+	parallel_for(jobs, buffer.tiles_y, 1, [&buffer, &triangles](uint32_t first_row, uint32_t last_row) {
+		PROFILE_ZONE("rasterize occluders");
+		for (uint32_t tile_y = first_row; tile_y < last_row; ++tile_y) {
+			for (uint32_t tile_x = 0; tile_x < buffer.tiles_x; ++tile_x) {
+				for (const ScreenTriangle& triangle : triangles) {
+					rasterize_triangle_in_tile(buffer, triangle, tile_x * OCCLUSION_TILE_SIZE, tile_y * OCCLUSION_TILE_SIZE);
+				}
+				update_tile_max_depth(buffer, tile_x, tile_y);
+			}
+		}
+	});
+}
+
+bool is_box_visible(const OcclusionBuffer& buffer, const OcclusionBox& box, const glm::mat4& view_projection) {
+	float min_x = std::numeric_limits<float>::max();
+	float min_y = std::numeric_limits<float>::max();
+	float max_x = std::numeric_limits<float>::lowest();
+	float max_y = std::numeric_limits<float>::lowest();
+	float min_depth = std::numeric_limits<float>::max();
+	for (int i = 0; i < 8; ++i) {
+		glm::vec3 corner(
+			(i & 1) ? box.max.x : box.min.x,
+			(i & 2) ? box.max.y : box.min.y,
+			(i & 4) ? box.max.z : box.min.z
+		);
+		glm::vec4 clip = view_projection * glm::vec4(corner, 1.0f);
+
+		// Anything touching the near plane can't be reasoned about cheaply, so keep it
+		if (clip.w <= 0.0f || clip.z < 0.0f) {
+			return true;
+		}
+
+		glm::vec3 screen = project_to_screen(clip, buffer);
+		min_x = std::min(min_x, screen.x);
+		min_y = std::min(min_y, screen.y);
+		max_x = std::max(max_x, screen.x);
+		max_y = std::max(max_y, screen.y);
+		min_depth = std::min(min_depth, screen.z);
+	}
+
+	// Completely off screen or beyond the far plane
+	if (max_x < 0.0f || max_y < 0.0f || min_x >= static_cast<float>(buffer.width) || min_y >= static_cast<float>(buffer.height) || min_depth > 1.0f) {
+		return false;
+	}
+
+	int32_t start_x = std::max(0, static_cast<int32_t>(std::floor(min_x))) & ~3;
+	int32_t start_y = std::max(0, static_cast<int32_t>(std::floor(min_y)));
+	int32_t end_x = std::min(static_cast<int32_t>(buffer.width) - 1, static_cast<int32_t>(std::ceil(max_x)));
+	int32_t end_y = std::min(static_cast<int32_t>(buffer.height) - 1, static_cast<int32_t>(std::ceil(max_y)));
+
+	for (int32_t tile_y = start_y / static_cast<int32_t>(OCCLUSION_TILE_SIZE); tile_y <= end_y / static_cast<int32_t>(OCCLUSION_TILE_SIZE); ++tile_y) {
+		for (int32_t tile_x = start_x / static_cast<int32_t>(OCCLUSION_TILE_SIZE); tile_x <= end_x / static_cast<int32_t>(OCCLUSION_TILE_SIZE); ++tile_x) {
+			// Coarse test: the whole tile is covered by something nearer than the box
+			if (buffer.tile_max_depth[tile_y * buffer.tiles_x + tile_x] < min_depth) {
+				continue;
+			}
+
+			int32_t tile_start_x = std::max(start_x, tile_x * static_cast<int32_t>(OCCLUSION_TILE_SIZE));
+			int32_t tile_end_x = std::min(end_x, (tile_x + 1) * static_cast<int32_t>(OCCLUSION_TILE_SIZE) - 1);
+			int32_t tile_start_y = std::max(start_y, tile_y * static_cast<int32_t>(OCCLUSION_TILE_SIZE));
+			int32_t tile_end_y = std::min(end_y, (tile_y + 1) * static_cast<int32_t>(OCCLUSION_TILE_SIZE) - 1);
+
+			for (int32_t y = tile_start_y; y <= tile_end_y; ++y) {
+				const float* row = &buffer.depth[static_cast<size_t>(y) * buffer.width];
+				for (int32_t x = tile_start_x; x <= tile_end_x; x += 4) {
+#ifdef OCCLUSION_USE_SSE
+					__m128 visible = _mm_cmpge_ps(_mm_loadu_ps(row + x), _mm_set1_ps(min_depth));
+					if (_mm_movemask_ps(visible) != 0) {
+						return true;
+					}
+#else
+					for (int32_t lane = 0; lane < 4; ++lane) {
+						if (row[x + lane] >= min_depth) {
+							return true;
+						}
+					}
+#endif
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+void cull_occludees(const OcclusionBuffer& buffer, const std::vector<OcclusionBox>& boxes, const glm::mat4& view_projection,
+std::vector<uint32_t>& out_visible) {
+	out_visible.clear();
+	for (uint32_t i = 0; i < static_cast<uint32_t>(boxes.size()); ++i) {
+		if (is_box_visible(buffer, boxes[i], view_projection)) {
+			out_visible.push_back(i);
+		}
+	}
+}
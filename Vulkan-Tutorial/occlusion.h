@@ -0,0 +1,45 @@
+// CPU occlusion culling. Occluder meshes are rasterized into a small depth buffer split into
+// screen tiles, then occludee bounding boxes are tested against it before anything is recorded.
+// Deliberately has no Vulkan dependency so it can be exercised without a GPU, see occlusion_tests.cpp.
+
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "frame_arena.h"
+#include "job_system.h"
+
+const uint32_t OCCLUSION_BUFFER_WIDTH = 256;
+const uint32_t OCCLUSION_BUFFER_HEIGHT = 160;
+const uint32_t OCCLUSION_TILE_SIZE = 32; // must be a multiple of 4 (one SSE register of pixels)
+
+struct OccluderMesh {
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
+};
+
+struct OcclusionBox {
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+struct OcclusionBuffer {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t tiles_x = 0;
+	uint32_t tiles_y = 0;
+	std::vector<float> depth; // row major, 1.0 is the far plane
+	std::vector<float> tile_max_depth; // farthest occluder depth per tile, for coarse rejection
+};
+
+OcclusionBuffer create_occlusion_buffer(uint32_t width, uint32_t height);
+void clear_occlusion_buffer(OcclusionBuffer& buffer);
+void rasterize_occluders(OcclusionBuffer& buffer, const std::vector<OccluderMesh>& occluders, const glm::mat4& view_projection, JobSystem& jobs,
+	FrameArena& arena);
+bool is_box_visible(const OcclusionBuffer& buffer, const OcclusionBox& box, const glm::mat4& view_projection);
+void cull_occludees(const OcclusionBuffer& buffer, const std::vector<OcclusionBox>& boxes, const glm::mat4& view_projection,
+	std::vector<uint32_t>& out_visible);
@@ -0,0 +1,170 @@
+// Tests for the CPU occlusion rasterizer. The view projection is the identity throughout, so positions are
+// already in clip space with w = 1: x and y from -1 to 1 cover the buffer and z is the depth that ends up in it.
+
+#include <cmath>
+#include <vector>
+
+#include "occlusion.h"
+#include "test_helpers.h"
+
+const uint32_t TEST_BUFFER_SIZE = 64; // 2x2 tiles
+
+// Two triangles covering [min_x, max_x] x [min_y, max_y] at one depth
+static OccluderMesh create_quad(float min_x, float min_y, float max_x, float max_y, float depth) {
+	OccluderMesh quad;
+	quad.positions = {
+		glm::vec3(min_x, min_y, depth),
+		glm::vec3(max_x, min_y, depth),
+		glm::vec3(max_x, max_y, depth),
+		glm::vec3(min_x, max_y, depth),
+	};
+	quad.indices = { 0, 1, 2, 0, 2, 3 };
+
+	return quad;
+}
+
+static OcclusionBox create_box(float min_x, float min_y, float min_z, float max_x, float max_y, float max_z) {
+	return OcclusionBox{ glm::vec3(min_x, min_y, min_z), glm::vec3(max_x, max_y, max_z) };
+}
+
+static OcclusionBuffer rasterize(const std::vector<OccluderMesh>& occluders, uint32_t thread_count) {
+	OcclusionBuffer buffer = create_occlusion_buffer(TEST_BUFFER_SIZE, TEST_BUFFER_SIZE);
+	JobSystem jobs;
+	start_job_system(jobs, thread_count);
+	FrameArena arena = create_frame_arena(FRAME_ARENA_CAPACITY);
+	rasterize_occluders(buffer, occluders, glm::mat4(1.0f), jobs, arena);
+	stop_job_system(jobs);
+
+	return buffer;
+}
+
+static float get_depth(const OcclusionBuffer& buffer, uint32_t x, uint32_t y) {
+	return buffer.depth[static_cast<size_t>(y) * buffer.width + x];
+}
+
+static void test_buffer_is_rounded_to_whole_tiles() {
+	OcclusionBuffer buffer = create_occlusion_buffer(OCCLUSION_TILE_SIZE + 1, OCCLUSION_TILE_SIZE);
+	CHECK(buffer.tiles_x == 2 && buffer.tiles_y == 1);
+	CHECK(buffer.width == 2 * OCCLUSION_TILE_SIZE && buffer.height == OCCLUSION_TILE_SIZE);
+	CHECK(buffer.depth.size() == static_cast<size_t>(buffer.width) * buffer.height);
+	CHECK(buffer.tile_max_depth.size() == 2);
+}
+
+static void test_empty_buffer_only_rejects_boxes_out_of_view() {
+	OcclusionBuffer buffer = rasterize({}, 1);
+	glm::mat4 identity(1.0f);
+	CHECK(is_box_visible(buffer, create_box(-0.5f, -0.5f, 0.5f, 0.5f, 0.5f, 0.6f), identity));
+	CHECK(!is_box_visible(buffer, create_box(2.0f, -0.5f, 0.5f, 3.0f, 0.5f, 0.6f), identity));
+	CHECK(!is_box_visible(buffer, create_box(-0.5f, -0.5f, 1.1f, 0.5f, 0.5f, 1.2f), identity));
+	// Touching the near plane is always kept
+	CHECK(is_box_visible(buffer, create_box(-0.5f, -0.5f, -0.1f, 0.5f, 0.5f, 0.6f), identity));
+}
+
+// Also covers the shared diagonal, a pixel missed by both triangles would still be at the far plane
+static void test_full_screen_quad_writes_its_depth_everywhere() {
+	OcclusionBuffer buffer = rasterize({ create_quad(-1.0f, -1.0f, 1.0f, 1.0f, 0.25f) }, 1);
+	uint32_t wrong_pixels = 0;
+	for (float depth : buffer.depth) {
+		wrong_pixels += std::abs(depth - 0.25f) > 1e-6f ? 1 : 0;
+	}
+	CHECK(wrong_pixels == 0);
+	for (float tile_depth : buffer.tile_max_depth) {
+		CHECK(std::abs(tile_depth - 0.25f) < 1e-6f);
+	}
+}
+
+static void test_both_windings_are_rasterized() {
+	OccluderMesh counter_clockwise;
+	counter_clockwise.positions = { glm::vec3(-1.0f, -1.0f, 0.5f), glm::vec3(1.0f, -1.0f, 0.5f), glm::vec3(-1.0f, 1.0f, 0.5f) };
+	counter_clockwise.indices = { 0, 1, 2 };
+	OccluderMesh clockwise = counter_clockwise;
+	clockwise.indices = { 0, 2, 1 };
+
+	for (const OccluderMesh& triangle : { counter_clockwise, clockwise }) {
+		OcclusionBuffer buffer = rasterize({ triangle }, 1);
+		CHECK(std::abs(get_depth(buffer, 4, 4) - 0.5f) < 1e-6f);
+		CHECK(get_depth(buffer, TEST_BUFFER_SIZE - 4, TEST_BUFFER_SIZE - 4) == 1.0f);
+	}
+}
+
+static void test_nearest_occluder_wins() {
+	OcclusionBuffer buffer = rasterize({ create_quad(-1.0f, -1.0f, 1.0f, 1.0f, 0.6f), create_quad(-1.0f, -1.0f, 0.0f, 1.0f, 0.3f) }, 1);
+	CHECK(std::abs(get_depth(buffer, 8, 8) - 0.3f) < 1e-6f);
+	CHECK(std::abs(get_depth(buffer, TEST_BUFFER_SIZE - 8, 8) - 0.6f) < 1e-6f);
+}
+
+static void test_triangles_crossing_the_near_plane_are_dropped() {
+	OccluderMesh quad = create_quad(-1.0f, -1.0f, 1.0f, 1.0f, 0.5f);
+	quad.positions[1].z = -0.5f;
+	OcclusionBuffer buffer = rasterize({ quad }, 1);
+	// Only the bottom right triangle uses that vertex, the top left one is still drawn
+	CHECK(get_depth(buffer, TEST_BUFFER_SIZE - 2, 2) == 1.0f);
+	CHECK(std::abs(get_depth(buffer, 2, TEST_BUFFER_SIZE - 2) - 0.5f) < 1e-6f);
+}
+
+static void test_boxes_behind_an_occluder_are_culled() {
+	OcclusionBuffer buffer = rasterize({ create_quad(-1.0f, -1.0f, 1.0f, 1.0f, 0.25f) }, 1);
+	glm::mat4 identity(1.0f);
+	CHECK(!is_box_visible(buffer, create_box(-0.5f, -0.5f, 0.5f, 0.5f, 0.5f, 0.6f), identity));
+	CHECK(is_box_visible(buffer, create_box(-0.5f, -0.5f, 0.1f, 0.5f, 0.5f, 0.2f), identity));
+	// Any part in front of the occluder keeps the whole box
+	CHECK(is_box_visible(buffer, create_box(-0.5f, -0.5f, 0.2f, 0.5f, 0.5f, 0.6f), identity));
+}
+
+static void test_partially_covered_boxes_stay_visible() {
+	OcclusionBuffer buffer = rasterize({ create_quad(-1.0f, -1.0f, 0.0f, 1.0f, 0.25f) }, 1);
+	glm::mat4 identity(1.0f);
+	CHECK(!is_box_visible(buffer, create_box(-0.9f, -0.5f, 0.5f, -0.1f, 0.5f, 0.6f), identity));
+	CHECK(is_box_visible(buffer, create_box(-0.5f, -0.5f, 0.5f, 0.5f, 0.5f, 0.6f), identity));
+}
+
+static void test_cull_occludees_lists_visible_boxes() {
+	OcclusionBuffer buffer = rasterize({ create_quad(-1.0f, -1.0f, 1.0f, 1.0f, 0.25f) }, 1);
+	std::vector<OcclusionBox> boxes = {
+		create_box(-0.5f, -0.5f, 0.5f, 0.5f, 0.5f, 0.6f), // behind
+		create_box(-0.5f, -0.5f, 0.1f, 0.5f, 0.5f, 0.2f), // in front
+		create_box(2.0f, 2.0f, 0.1f, 3.0f, 3.0f, 0.2f), // off screen
+		create_box(0.1f, 0.1f, 0.05f, 0.2f, 0.2f, 0.1f), // in front
+	};
+	std::vector<uint32_t> visible = { 7 };
+	cull_occludees(buffer, boxes, glm::mat4(1.0f), visible);
+	CHECK(visible == std::vector<uint32_t>({ 1, 3 }));
+}
+
+// Tile rows are split between jobs, which mustn't change a single pixel
+static void test_thread_count_does_not_change_the_result() {
+	std::vector<OccluderMesh> occluders;
+	for (uint32_t i = 0; i < 16; ++i) {
+		float t = static_cast<float>(i);
+		OccluderMesh triangle;
+		triangle.positions = {
+			glm::vec3(std::sin(t * 1.3f), std::cos(t * 0.7f), 0.1f + 0.05f * t),
+			glm::vec3(std::sin(t * 2.1f + 1.0f), std::cos(t * 1.7f + 2.0f), 0.2f + 0.04f * t),
+			glm::vec3(std::sin(t * 0.9f + 2.0f), std::cos(t * 2.3f + 1.0f), 0.15f + 0.03f * t),
+		};
+		triangle.indices = { 0, 1, 2 };
+		occluders.push_back(triangle);
+	}
+
+	OcclusionBuffer serial = rasterize(occluders, 1);
+	OcclusionBuffer parallel = rasterize(occluders, 4);
+	CHECK(serial.depth == parallel.depth);
+	CHECK(serial.tile_max_depth == parallel.tile_max_depth);
+}
+
+int main() {
+	const TestCase tests[] = {
+		{ "buffer is rounded to whole tiles", test_buffer_is_rounded_to_whole_tiles },
+		{ "empty buffer only rejects boxes out of view", test_empty_buffer_only_rejects_boxes_out_of_view },
+		{ "full screen quad writes its depth everywhere", test_full_screen_quad_writes_its_depth_everywhere },
+		{ "both windings are rasterized", test_both_windings_are_rasterized },
+		{ "nearest occluder wins", test_nearest_occluder_wins },
+		{ "triangles crossing the near plane are dropped", test_triangles_crossing_the_near_plane_are_dropped },
+		{ "boxes behind an occluder are culled", test_boxes_behind_an_occluder_are_culled },
+		{ "partially covered boxes stay visible", test_partially_covered_boxes_stay_visible },
+		{ "cull_occludees lists visible boxes", test_cull_occludees_lists_visible_boxes },
+		{ "thread count doesn't change the result", test_thread_count_does_not_change_the_result },
+	};
+
+	return run_tests(tests);
+}
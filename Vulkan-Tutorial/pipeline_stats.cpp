@@ -0,0 +1,161 @@
+#include "pipeline_stats.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include "host_allocator.h"
+#include "log.h"
+
+const uint32_t REPORTED_MESH_COUNT = 16;
+
+PipelineStatistics create_pipeline_statistics(VkDevice device, VkPhysicalDevice physical_device, uint32_t frame_slot_count, bool enabled) {
+	PipelineStatistics statistics;
+	if (!enabled) {
+		return statistics;
+	}
+
+	// create_logical_device turns the feature on whenever it is there
+	VkPhysicalDeviceFeatures device_features;
+	vkGetPhysicalDeviceFeatures(physical_device, &device_features);
+	if (!device_features.pipelineStatisticsQuery) {
+		LOG_WARNING("Device doesn't support pipeline statistics queries");
+		return statistics;
+	}
+
+	VkQueryPoolCreateInfo pool_info{};
+	pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	pool_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+	pool_info.queryCount = frame_slot_count * MAX_PIPELINE_STATISTICS_DRAWS;
+	pool_info.pipelineStatistics = PIPELINE_STATISTICS_FLAGS;
+
+	if (vkCreateQueryPool(device, &pool_info, get_host_allocator(HOST_ARENA_QUERY), &statistics.query_pool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create pipeline statistics query pool!");
+	}
+	statistics.pending.assign(frame_slot_count, false);
+	statistics.results.resize(static_cast<size_t>(MAX_PIPELINE_STATISTICS_DRAWS) * PIPELINE_STATISTICS_RESULT_STRIDE);
+
+	return statistics;
+}
+
+void destroy_pipeline_statistics(PipelineStatistics& statistics, VkDevice device) {
+	if (statistics.query_pool != VK_NULL_HANDLE) {
+		vkDestroyQueryPool(device, statistics.query_pool, get_host_allocator(HOST_ARENA_QUERY));
+		statistics.query_pool = VK_NULL_HANDLE;
+	}
+}
+
+uint32_t get_first_statistics_query(const PipelineStatistics& statistics, uint32_t frame) {
+	return statistics.query_pool == VK_NULL_HANDLE ? 0 : frame * MAX_PIPELINE_STATISTICS_DRAWS;
+}
+
+// Resets the slot's whole range rather than just the draws recorded this frame, so a query is never read
+// without having been reset, whatever the draw list looked like
+void cmd_reset_pipeline_statistics(VkCommandBuffer command_buffer, VkQueryPool query_pool, uint32_t first_query) {
+	if (query_pool != VK_NULL_HANDLE) {
+		vkCmdResetQueryPool(command_buffer, query_pool, first_query, MAX_PIPELINE_STATISTICS_DRAWS);
+	}
+}
+
+// Culled draws leave their query reset but unused, the availability word tells them apart
+void read_pipeline_statistics(PipelineStatistics& statistics, VkDevice device, uint32_t frame, uint32_t draw_item_count) {
+	if (statistics.query_pool == VK_NULL_HANDLE || !statistics.pending[frame]) {
+		return;
+	}
+	statistics.pending[frame] = false;
+
+	uint32_t query_count = std::min(draw_item_count, MAX_PIPELINE_STATISTICS_DRAWS);
+	const size_t stride = PIPELINE_STATISTICS_RESULT_STRIDE;
+	VkResult result = vkGetQueryPoolResults(device, statistics.query_pool, get_first_statistics_query(statistics, frame), query_count,
+		query_count * stride * sizeof(uint64_t), statistics.results.data(), stride * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+	if (result != VK_SUCCESS && result != VK_NOT_READY) {
+		throw std::runtime_error("Failed to read pipeline statistics!");
+	}
+
+	if (statistics.meshes.size() < query_count) {
+		statistics.meshes.resize(query_count);
+	}
+	statistics.last_frame = {};
+	for (uint32_t i = 0; i < query_count; ++i) {
+		const uint64_t* values = &statistics.results[i * stride];
+		if (values[PIPELINE_STATISTIC_COUNT] == 0) {
+			continue;
+		}
+
+		MeshStatistics& mesh = statistics.meshes[i];
+		mesh.frame_count++;
+		for (uint32_t statistic = 0; statistic < PIPELINE_STATISTIC_COUNT; ++statistic) {
+			mesh.totals[statistic] += values[statistic];
+			statistics.last_frame[statistic] += values[statistic];
+		}
+	}
+
+	for (uint32_t statistic = 0; statistic < PIPELINE_STATISTIC_COUNT; ++statistic) {
+		statistics.frame_totals[statistic] += statistics.last_frame[statistic];
+	}
+	statistics.frame_count++;
+}
+
+// Draw item indices change meaning when the model is replaced, so results still in flight are dropped too
+void clear_pipeline_statistics(PipelineStatistics& statistics) {
+	std::fill(statistics.pending.begin(), statistics.pending.end(), false);
+	statistics.meshes.clear();
+	statistics.last_frame = {};
+	statistics.frame_totals = {};
+	statistics.frame_count = 0;
+}
+
+// Vertex shader invocations per input vertex is how often the post-transform cache missed, 1.0 means every
+// index was shaded again. Meshes are listed heaviest first by fragment shader invocations
+void report_pipeline_statistics(const PipelineStatistics& statistics) {
+	if (statistics.query_pool == VK_NULL_HANDLE || statistics.frame_count == 0) {
+		return;
+	}
+
+	std::cout << "Pipeline statistics, mean per frame over " << statistics.frame_count << " frames:\n";
+	for (uint32_t statistic = 0; statistic < PIPELINE_STATISTIC_COUNT; ++statistic) {
+		std::cout << '\t' << get_pipeline_statistic_name(static_cast<PipelineStatistic>(statistic)) << " / "
+			<< statistics.frame_totals[statistic] / static_cast<double>(statistics.frame_count) << '\n';
+	}
+	uint64_t input_vertices = statistics.frame_totals[PIPELINE_STATISTIC_INPUT_VERTICES];
+	if (input_vertices > 0) {
+		std::cout << "\tvertex shader invocations per input vertex / "
+			<< statistics.frame_totals[PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS] / static_cast<double>(input_vertices) << '\n';
+	}
+
+	std::vector<uint32_t> order;
+	for (uint32_t i = 0; i < statistics.meshes.size(); ++i) {
+		if (statistics.meshes[i].frame_count > 0) {
+			order.push_back(i);
+		}
+	}
+	std::sort(order.begin(), order.end(), [&statistics](uint32_t a, uint32_t b) {
+		return statistics.meshes[a].totals[PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS] > statistics.meshes[b].totals[PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS];
+	});
+
+	std::cout << "Pipeline statistics per draw item, mean per frame drawn (draw item / frames drawn / input vertices / vertex shader invocations"
+		" / clipping primitives / fragment shader invocations):\n";
+	for (size_t i = 0; i < order.size() && i < REPORTED_MESH_COUNT; ++i) {
+		const MeshStatistics& mesh = statistics.meshes[order[i]];
+		std::cout << '\t' << order[i] << " / " << mesh.frame_count;
+		for (uint32_t statistic = 0; statistic < PIPELINE_STATISTIC_COUNT; ++statistic) {
+			std::cout << " / " << mesh.totals[statistic] / static_cast<double>(mesh.frame_count);
+		}
+		std::cout << '\n';
+	}
+}
+
+const char* get_pipeline_statistic_name(PipelineStatistic statistic) {
+	switch (statistic) {
+	case PIPELINE_STATISTIC_INPUT_VERTICES:
+		return "input vertices";
+	case PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS:
+		return "vertex shader invocations";
+	case PIPELINE_STATISTIC_CLIPPING_PRIMITIVES:
+		return "clipping primitives";
+	case PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS:
+		return "fragment shader invocations";
+	default:
+		return "unknown";
+	}
+}
@@ -0,0 +1,55 @@
+// Pipeline statistics per draw item. Every draw is wrapped in its own query so the work the GPU actually
+// did can be attributed to a mesh, and the frame totals are the sum over the draws. Each frame slot owns a
+// range of MAX_PIPELINE_STATISTICS_DRAWS queries that its primary command buffer resets before the render
+// pass, and results are read once the slot's timeline value has been waited on, so reading never stalls.
+// Draw items past the range go unmeasured. Off unless --pipeline-stats is given and the device supports it.
+
+#pragma once
+#include <cstdint>
+#include <array>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+const uint32_t MAX_PIPELINE_STATISTICS_DRAWS = 1024;
+
+// Same order as the bits in PIPELINE_STATISTICS_FLAGS, which is the order results are written in
+enum PipelineStatistic {
+	PIPELINE_STATISTIC_INPUT_VERTICES,
+	PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS,
+	PIPELINE_STATISTIC_CLIPPING_PRIMITIVES,
+	PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS,
+	PIPELINE_STATISTIC_COUNT
+};
+
+const uint32_t PIPELINE_STATISTICS_RESULT_STRIDE = PIPELINE_STATISTIC_COUNT + 1; // the statistics, then the availability word
+
+const VkQueryPipelineStatisticFlags PIPELINE_STATISTICS_FLAGS =
+	VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+	VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+	VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+	VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+struct MeshStatistics {
+	std::array<uint64_t, PIPELINE_STATISTIC_COUNT> totals{};
+	uint64_t frame_count = 0; // frames the mesh was drawn in, culled frames don't count
+};
+
+struct PipelineStatistics {
+	VkQueryPool query_pool = VK_NULL_HANDLE; // null when off
+	std::vector<bool> pending; // per frame slot, results submitted but not read yet
+	std::vector<uint64_t> results; // read back into every frame, sized once so reading never allocates
+	std::vector<MeshStatistics> meshes; // indexed by draw item
+	std::array<uint64_t, PIPELINE_STATISTIC_COUNT> last_frame{};
+	std::array<uint64_t, PIPELINE_STATISTIC_COUNT> frame_totals{};
+	uint64_t frame_count = 0;
+};
+
+PipelineStatistics create_pipeline_statistics(VkDevice device, VkPhysicalDevice physical_device, uint32_t frame_slot_count, bool enabled);
+void destroy_pipeline_statistics(PipelineStatistics& statistics, VkDevice device);
+uint32_t get_first_statistics_query(const PipelineStatistics& statistics, uint32_t frame);
+void cmd_reset_pipeline_statistics(VkCommandBuffer command_buffer, VkQueryPool query_pool, uint32_t first_query);
+void read_pipeline_statistics(PipelineStatistics& statistics, VkDevice device, uint32_t frame, uint32_t draw_item_count);
+void clear_pipeline_statistics(PipelineStatistics& statistics);
+void report_pipeline_statistics(const PipelineStatistics& statistics);
+const char* get_pipeline_statistic_name(PipelineStatistic statistic);
@@ -0,0 +1,45 @@
+#include "platform.h"
+
+#ifdef _WIN32
+Platform create_win32_platform(HINSTANCE hinst, HWND hwnd) {
+	Platform platform;
+	platform.hinst = hinst;
+	platform.hwnd = hwnd;
+
+	return platform;
+}
+#endif
+
+Platform create_headless_platform(uint32_t width, uint32_t height) {
+	Platform platform;
+	platform.headless = true;
+	platform.headless_size = IVec2{ width, height };
+
+	return platform;
+}
+
+IVec2 get_platform_size(const Platform& platform) {
+	if (platform.headless) {
+		return platform.headless_size;
+	}
+
+#ifdef _WIN32
+	return get_window_size(platform.hwnd);
+#else
+	return IVec2{};
+#endif
+}
+
+// Minimized or otherwise not on screen, so there is nothing to draw into
+bool is_platform_hidden(const Platform& platform) {
+	if (platform.headless) {
+		return false;
+	}
+
+#ifdef _WIN32
+	IVec2 window_size = get_window_size(platform.hwnd);
+	return IsIconic(platform.hwnd) || !IsWindowVisible(platform.hwnd) || window_size.x == 0 || window_size.y == 0;
+#else
+	return false;
+#endif
+}
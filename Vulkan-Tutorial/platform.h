@@ -0,0 +1,27 @@
+// Where the renderer draws to. A window gets a surface and swap chain, headless has neither and renders
+// into offscreen images instead, so it runs on machines without a display or GPU (lavapipe, SwiftShader).
+
+#pragma once
+#include <cstdint>
+
+#include "vec2.h"
+
+#ifdef _WIN32
+#include "win32.h"
+#endif
+
+struct Platform {
+	bool headless = false;
+	IVec2 headless_size; // windows report their own size
+#ifdef _WIN32
+	HINSTANCE hinst = NULL;
+	HWND hwnd = NULL;
+#endif
+};
+
+#ifdef _WIN32
+Platform create_win32_platform(HINSTANCE hinst, HWND hwnd);
+#endif
+Platform create_headless_platform(uint32_t width, uint32_t height);
+IVec2 get_platform_size(const Platform& platform);
+bool is_platform_hidden(const Platform& platform);
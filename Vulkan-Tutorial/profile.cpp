@@ -0,0 +1,160 @@
+#include "profile.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "log.h"
+
+struct ZoneRing {
+	std::array<ZoneEvent, PROFILE_RING_CAPACITY> events;
+	std::atomic<uint32_t> write_index{ 0 }; // only advanced by the owning thread
+	std::atomic<uint32_t> read_index{ 0 }; // only advanced by the collector
+	std::atomic<uint64_t> dropped{ 0 };
+	uint32_t thread_id = 0;
+	std::string thread_name;
+};
+
+// Rings are never freed while the process runs. A thread that exits hands its ring back so the next thread
+// reuses it, which keeps short lived workers (one per chunk per frame) from growing the registry, and puts
+// them on a stable set of tracks in the trace
+struct ProfileRegistry {
+	std::mutex mutex;
+	std::vector<std::unique_ptr<ZoneRing>> rings;
+	std::vector<ZoneRing*> free_rings;
+	std::atomic<bool> collecting{ false };
+	std::thread collector;
+	std::vector<TraceEvent> events; // only touched by the collector until it is joined
+};
+
+static ProfileRegistry& get_profile_registry() {
+	static ProfileRegistry registry;
+	return registry;
+}
+
+struct ThreadRingHandle {
+	ZoneRing* ring = nullptr;
+
+	~ThreadRingHandle() {
+		if (ring != nullptr) {
+			ProfileRegistry& registry = get_profile_registry();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+			registry.free_rings.push_back(ring);
+		}
+	}
+};
+
+static ZoneRing* get_thread_ring() {
+	thread_local ThreadRingHandle handle;
+	if (handle.ring == nullptr) {
+		ProfileRegistry& registry = get_profile_registry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		if (!registry.free_rings.empty()) {
+			handle.ring = registry.free_rings.back();
+			registry.free_rings.pop_back();
+		}
+		else {
+			registry.rings.push_back(std::make_unique<ZoneRing>());
+			handle.ring = registry.rings.back().get();
+			handle.ring->thread_id = static_cast<uint32_t>(registry.rings.size() - 1);
+			handle.ring->thread_name = "Worker " + std::to_string(handle.ring->thread_id);
+		}
+	}
+
+	return handle.ring;
+}
+
+ProfileZone::ProfileZone(const char* zone_name) {
+	if (!get_profile_registry().collecting.load(std::memory_order_relaxed)) {
+		name = nullptr;
+		return;
+	}
+	name = zone_name;
+	start = std::chrono::steady_clock::now();
+}
+
+ProfileZone::~ProfileZone() {
+	if (name != nullptr) {
+		push_zone_event({ name, start, std::chrono::steady_clock::now() });
+	}
+}
+
+void push_zone_event(const ZoneEvent& event) {
+	ZoneRing* ring = get_thread_ring();
+	uint32_t write_index = ring->write_index.load(std::memory_order_relaxed);
+	uint32_t read_index = ring->read_index.load(std::memory_order_acquire);
+	if (write_index - read_index >= PROFILE_RING_CAPACITY) {
+		ring->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	ring->events[write_index & (PROFILE_RING_CAPACITY - 1)] = event;
+	ring->write_index.store(write_index + 1, std::memory_order_release);
+}
+
+void set_profile_thread_name(const char* name) {
+	ZoneRing* ring = get_thread_ring();
+	std::lock_guard<std::mutex> lock(get_profile_registry().mutex);
+	ring->thread_name = name;
+}
+
+static void drain_rings(ProfileRegistry& registry) {
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	for (const std::unique_ptr<ZoneRing>& ring : registry.rings) {
+		uint32_t read_index = ring->read_index.load(std::memory_order_relaxed);
+		uint32_t write_index = ring->write_index.load(std::memory_order_acquire);
+		for (; read_index != write_index; ++read_index) {
+			const ZoneEvent& event = ring->events[read_index & (PROFILE_RING_CAPACITY - 1)];
+			double start_us = to_trace_microseconds(event.start);
+			registry.events.push_back({ event.name, "cpu", ring->thread_id, start_us, to_trace_microseconds(event.end) - start_us });
+		}
+		ring->read_index.store(read_index, std::memory_order_release);
+	}
+}
+
+static void run_profile_collector(ProfileRegistry* registry) {
+	while (registry->collecting.load(std::memory_order_relaxed)) {
+		drain_rings(*registry);
+		std::this_thread::sleep_for(std::chrono::milliseconds(PROFILE_COLLECT_INTERVAL_MS));
+	}
+}
+
+// The calling thread gets the first ring, so it is track 0 in the trace
+void start_profile_collector() {
+	ProfileRegistry& registry = get_profile_registry();
+	if (registry.collecting.load()) {
+		return;
+	}
+
+	set_profile_thread_name("Main");
+	registry.collecting.store(true);
+	registry.collector = std::thread(run_profile_collector, &registry);
+}
+
+// Zones still open on other threads when this is called are lost
+void stop_profile_collector(std::vector<TraceEvent>& out_events, std::vector<TraceThread>& out_threads) {
+	ProfileRegistry& registry = get_profile_registry();
+	if (!registry.collecting.load()) {
+		return;
+	}
+
+	registry.collecting.store(false);
+	registry.collector.join();
+	drain_rings(registry);
+
+	out_events.insert(out_events.end(), registry.events.begin(), registry.events.end());
+	registry.events.clear();
+
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	uint64_t dropped = 0;
+	for (const std::unique_ptr<ZoneRing>& ring : registry.rings) {
+		out_threads.push_back({ ring->thread_id, ring->thread_name });
+		dropped += ring->dropped.load();
+	}
+	if (dropped > 0) {
+		LOG_WARNING("Dropped %llu CPU zone events, the collector fell behind", static_cast<unsigned long long>(dropped));
+	}
+}
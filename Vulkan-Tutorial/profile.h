@@ -0,0 +1,50 @@
+// CPU timing zones. PROFILE_ZONE("name") times the rest of the enclosing scope and writes a fixed-size event
+// into the calling thread's ring buffer. Each ring has exactly one writer (its thread) and one reader (the
+// collector thread), so pushing an event is a couple of atomics and never blocks. A full ring drops events
+// rather than waiting. The collector drains every ring in the background and the events end up in the
+// Chrome trace next to the GPU zones (see gpu_profiler.h). Build with ENABLE_PROFILE_ZONES=0 to compile
+// every zone out.
+
+#pragma once
+#include <cstdint>
+#include <chrono>
+#include <vector>
+
+#include "trace.h"
+
+#ifndef ENABLE_PROFILE_ZONES
+#define ENABLE_PROFILE_ZONES 1
+#endif
+
+const uint32_t PROFILE_RING_CAPACITY = 4096; // events per thread, must be a power of two
+const uint32_t PROFILE_COLLECT_INTERVAL_MS = 5;
+
+struct ZoneEvent {
+	const char* name; // must be a string literal, only the pointer is stored
+	std::chrono::steady_clock::time_point start;
+	std::chrono::steady_clock::time_point end;
+};
+
+// Does nothing unless the collector is running, so zones cost one relaxed load when nobody is listening
+struct ProfileZone {
+	const char* name;
+	std::chrono::steady_clock::time_point start;
+
+	explicit ProfileZone(const char* zone_name);
+	~ProfileZone();
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#if ENABLE_PROFILE_ZONES
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#endif
+
+void push_zone_event(const ZoneEvent& event);
+void set_profile_thread_name(const char* name);
+void start_profile_collector();
+void stop_profile_collector(std::vector<TraceEvent>& out_events, std::vector<TraceThread>& out_threads);
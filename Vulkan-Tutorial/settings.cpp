@@ -0,0 +1,150 @@
+#include "settings.h"
+
+#include <charconv>
+#include <sstream>
+
+#include "log.h"
+
+static bool read_option(const std::string& argument, const std::string& name, std::string& out_value) {
+	std::string prefix = "--" + name + "=";
+	if (argument.compare(0, prefix.size(), prefix) != 0) {
+		return false;
+	}
+
+	out_value = argument.substr(prefix.size());
+	return true;
+}
+
+// A bad number keeps the default rather than ending the run
+static void parse_uint_option(const std::string& argument, const std::string& value, uint32_t min_value, uint32_t& out_value) {
+	uint32_t parsed = 0;
+	if (!parse_uint(value, parsed)) {
+		LOG_WARNING("Ignoring %s, expected a whole number", argument.c_str());
+		return;
+	}
+	if (parsed < min_value) {
+		LOG_WARNING("Ignoring %s, expected at least %u", argument.c_str(), min_value);
+		return;
+	}
+
+	out_value = parsed;
+}
+
+static void parse_float_option(const std::string& argument, const std::string& value, float& out_value) {
+	float parsed = 0.0f;
+	std::from_chars_result result = std::from_chars(value.data(), value.data() + value.size(), parsed);
+	if (result.ec != std::errc() || result.ptr != value.data() + value.size()) {
+		LOG_WARNING("Ignoring %s, expected a number", argument.c_str());
+		return;
+	}
+
+	out_value = parsed;
+}
+
+Settings parse_settings(const std::string& command_line) {
+	Settings settings;
+
+	std::istringstream stream(command_line);
+	std::string argument;
+	while (stream >> argument) {
+		std::string value;
+		if (read_option(argument, "frames-in-flight", value)) {
+			parse_uint_option(argument, value, 0, settings.frames_in_flight);
+		}
+		else if (read_option(argument, "present-mode", value)) {
+			bool found_policy = false;
+			for (uint32_t i = 0; i < PRESENT_POLICY_COUNT; ++i) {
+				if (value == get_present_policy_name(static_cast<PresentPolicy>(i))) {
+					settings.present_policy = static_cast<PresentPolicy>(i);
+					found_policy = true;
+				}
+			}
+
+			if (!found_policy) {
+				LOG_WARNING("Ignoring unknown present mode %s", value.c_str());
+			}
+		}
+		else if (read_option(argument, "wait-before-acquire", value)) {
+			settings.wait_before_acquire = value == "1" || value == "true";
+		}
+		else if (argument == "--headless") {
+			settings.headless = true;
+		}
+		else if (read_option(argument, "width", value)) {
+			parse_uint_option(argument, value, 1, settings.width);
+		}
+		else if (read_option(argument, "height", value)) {
+			parse_uint_option(argument, value, 1, settings.height);
+		}
+		else if (read_option(argument, "frames", value)) {
+			parse_uint_option(argument, value, 0, settings.frame_count);
+		}
+		else if (read_option(argument, "camera-script", value)) {
+			settings.camera_script = value;
+		}
+		else if (read_option(argument, "output", value)) {
+			settings.output_directory = value;
+		}
+		else if (read_option(argument, "output-format", value)) {
+			settings.output_raw = value == "raw";
+		}
+		else if (argument == "--benchmark") {
+			settings.benchmark = true;
+		}
+		else if (read_option(argument, "warmup-frames", value)) {
+			parse_uint_option(argument, value, 0, settings.warmup_frames);
+		}
+		else if (read_option(argument, "report", value)) {
+			settings.report_path = value;
+		}
+		else if (read_option(argument, "trace", value)) {
+			settings.trace_path = value;
+		}
+		else if (argument == "--pipeline-stats") {
+			settings.pipeline_statistics = true;
+		}
+		else if (argument == "--system-allocator") {
+			settings.system_allocator = true;
+		}
+		else if (read_option(argument, "target-fps", value)) {
+			parse_uint_option(argument, value, 0, settings.target_frame_rate);
+		}
+		else if (read_option(argument, "render-scale", value)) {
+			parse_float_option(argument, value, settings.render_scale);
+		}
+		else if (read_option(argument, "min-render-scale", value)) {
+			parse_float_option(argument, value, settings.min_render_scale);
+		}
+		else if (read_option(argument, "max-fps", value)) {
+			parse_uint_option(argument, value, 0, settings.max_frame_rate);
+		}
+		else if (argument == "--continuous") {
+			settings.continuous = true;
+		}
+		else {
+			LOG_WARNING("Ignoring unknown option %s", argument.c_str());
+		}
+	}
+
+	return settings;
+}
+
+bool parse_uint(const std::string& value, uint32_t& out_value) {
+	std::from_chars_result result = std::from_chars(value.data(), value.data() + value.size(), out_value);
+	return result.ec == std::errc() && result.ptr == value.data() + value.size();
+}
+
+const char* get_present_policy_name(PresentPolicy policy) {
+	switch (policy) {
+	case PRESENT_POLICY_FIFO:
+		return "fifo";
+	case PRESENT_POLICY_FIFO_RELAXED:
+		return "fifo-relaxed";
+	case PRESENT_POLICY_MAILBOX:
+		return "mailbox";
+	case PRESENT_POLICY_IMMEDIATE:
+		return "immediate";
+	default:
+		return "unknown";
+	}
+}
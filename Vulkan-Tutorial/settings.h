@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Maps onto VkPresentModeKHR, but kept free of Vulkan so settings don't pull it in
+enum PresentPolicy {
+	PRESENT_POLICY_FIFO,
+	PRESENT_POLICY_FIFO_RELAXED,
+	PRESENT_POLICY_MAILBOX,
+	PRESENT_POLICY_IMMEDIATE,
+	PRESENT_POLICY_COUNT
+};
+
+// Options that can be set from the command line, e.g. "--frames-in-flight=3 --present-mode=fifo"
+struct Settings {
+	uint32_t frames_in_flight = 2;
+	PresentPolicy present_policy = PRESENT_POLICY_MAILBOX;
+	bool wait_before_acquire = false; // CPU frame pacing, see pace_frame
+
+	// Headless runs render a fixed number of frames offscreen, see run_headless
+	bool headless = false;
+	uint32_t width = 800;
+	uint32_t height = 600;
+	uint32_t frame_count = 1000;
+	std::string camera_script; // one camera position per line, replaces frame_count and the built in path
+	std::string output_directory; // when set, every headless frame is written out, see batch.h
+	bool output_raw = false; // RGBA8 dumps instead of PNG
+
+	// Benchmark runs warm up, then measure frame_count frames along a fixed camera path, see benchmark.h
+	bool benchmark = false;
+	uint32_t warmup_frames = 100;
+	std::string report_path; // writes <path>.csv and <path>.json
+
+	// See dynamic_resolution.h. Benchmarks always render at render_scale so runs stay comparable
+	uint32_t target_frame_rate = 60; // GPU frame budget the render scale adapts to, 0 for a fixed scale
+	float render_scale = 1.0f; // fixed scale, and the largest dynamic resolution goes up to
+	float min_render_scale = 0.5f;
+
+	std::string trace_path; // GPU zones and frame phases as a Chrome trace, see gpu_profiler.h
+	bool pipeline_statistics = false; // per draw item pipeline statistics queries, see pipeline_stats.h
+	bool system_allocator = false; // driver host allocations skip the pooled callbacks, see host_allocator.h
+
+	// Windowed runs only, see frame_throttle.h
+	uint32_t max_frame_rate = 0; // 0 for no cap
+	bool continuous = false; // keep drawing even when the scene is static
+};
+
+Settings parse_settings(const std::string& command_line);
+// False unless all of value is a whole number that fits, out_value is only meaningful on success
+bool parse_uint(const std::string& value, uint32_t& out_value);
+const char* get_present_policy_name(PresentPolicy policy);
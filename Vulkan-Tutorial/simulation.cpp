@@ -0,0 +1,137 @@
+#include "simulation.h"
+
+#include <algorithm>
+
+#include "profile.h"
+
+// Nothing can change until the window thread sets something
+static bool should_park(const Simulation& simulation, const SceneSnapshot& published) {
+	if (simulation.hidden.load(std::memory_order_relaxed)) {
+		return true;
+	}
+
+	return simulation.paused.load(std::memory_order_relaxed) && simulation.camera_input.load(std::memory_order_relaxed) == 0 && is_scene_settled(published);
+}
+
+static void run_simulation(Simulation& simulation, SceneState state, std::chrono::steady_clock::time_point next_step) {
+	set_profile_thread_name("Simulation");
+	std::chrono::steady_clock::duration step_duration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<double>(SIMULATION_STEP_SECONDS));
+	std::chrono::steady_clock::duration max_catch_up = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<double>(MAX_SIMULATION_CATCH_UP_SECONDS));
+
+	while (simulation.running.load(std::memory_order_relaxed)) {
+		next_step += step_duration;
+		std::this_thread::sleep_until(next_step);
+
+		// Skips ahead rather than replaying every missed step at once
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (now - next_step > max_catch_up) {
+			next_step = now;
+		}
+
+		PROFILE_ZONE("simulation step");
+		SceneState previous = state;
+		state.cam_position += simulation.camera_input.load(std::memory_order_relaxed) * CAMERA_SPEED * SIMULATION_STEP_SECONDS;
+		if (!simulation.paused.load(std::memory_order_relaxed)) {
+			state.time += SIMULATION_STEP_SECONDS;
+		}
+		state.step++;
+
+		SceneSnapshot& snapshot = get_triple_buffer_write_slot(simulation.snapshots);
+		snapshot.previous = previous;
+		snapshot.current = state;
+		snapshot.current_time = next_step;
+		publish_triple_buffer(simulation.snapshots);
+
+		// The settled step has been published, so the render thread can tell the scene has stopped
+		if (should_park(simulation, snapshot)) {
+			std::unique_lock<std::mutex> lock(simulation.mutex);
+			simulation.wake.wait(lock, [&simulation] { return simulation.woken || !simulation.running.load(std::memory_order_relaxed); });
+			simulation.woken = false;
+			next_step = std::chrono::steady_clock::now();
+		}
+	}
+}
+
+void start_simulation(Simulation& simulation, const SceneState& initial_state) {
+	// Published before the thread starts, so the first frame always has something to read
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	SceneSnapshot& snapshot = get_triple_buffer_write_slot(simulation.snapshots);
+	snapshot.previous = initial_state;
+	snapshot.current = initial_state;
+	snapshot.current_time = now;
+	publish_triple_buffer(simulation.snapshots);
+
+	simulation.running.store(true);
+	simulation.thread = std::thread(run_simulation, std::ref(simulation), initial_state, now);
+}
+
+void stop_simulation(Simulation& simulation) {
+	{
+		std::lock_guard<std::mutex> lock(simulation.mutex);
+		simulation.running.store(false);
+	}
+	simulation.wake.notify_one();
+	if (simulation.thread.joinable()) {
+		simulation.thread.join();
+	}
+}
+
+// Only wakes the thread on a change, set_simulation_input is called for every message
+void set_simulation_input(Simulation& simulation, int32_t camera_input) {
+	if (simulation.camera_input.exchange(camera_input, std::memory_order_relaxed) != camera_input) {
+		wake_simulation(simulation);
+	}
+}
+
+void set_simulation_paused(Simulation& simulation, bool paused) {
+	if (simulation.paused.exchange(paused, std::memory_order_relaxed) != paused) {
+		wake_simulation(simulation);
+	}
+}
+
+void set_simulation_hidden(Simulation& simulation, bool hidden) {
+	if (simulation.hidden.exchange(hidden, std::memory_order_relaxed) != hidden) {
+		wake_simulation(simulation);
+	}
+}
+
+// Setting woken under the mutex means a wake can't slip in between the thread deciding to park and waiting
+void wake_simulation(Simulation& simulation) {
+	{
+		std::lock_guard<std::mutex> lock(simulation.mutex);
+		simulation.woken = true;
+	}
+	simulation.wake.notify_one();
+}
+
+const SceneSnapshot& read_scene_snapshot(Simulation& simulation) {
+	return read_triple_buffer(simulation.snapshots);
+}
+
+SceneSnapshot get_still_scene_snapshot(double cam_position, double time) {
+	SceneSnapshot snapshot;
+	snapshot.current.cam_position = cam_position;
+	snapshot.current.time = time;
+	snapshot.previous = snapshot.current;
+
+	return snapshot;
+}
+
+// Renders one step behind the simulation: a frame drawn as the newest step comes in shows the step before it,
+// and one drawn a whole step later shows the newest step
+SceneState interpolate_scene(const SceneSnapshot& snapshot, std::chrono::steady_clock::time_point now) {
+	double alpha = std::chrono::duration<double>(now - snapshot.current_time).count() / SIMULATION_STEP_SECONDS;
+	alpha = std::clamp(alpha, 0.0, 1.0);
+
+	SceneState state = snapshot.current;
+	state.cam_position = snapshot.previous.cam_position + (snapshot.current.cam_position - snapshot.previous.cam_position) * alpha;
+	state.time = snapshot.previous.time + (snapshot.current.time - snapshot.previous.time) * alpha;
+
+	return state;
+}
+
+bool is_scene_settled(const SceneSnapshot& snapshot) {
+	return snapshot.previous.cam_position == snapshot.current.cam_position && snapshot.previous.time == snapshot.current.time;
+}
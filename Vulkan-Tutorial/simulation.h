@@ -0,0 +1,62 @@
+// Scene simulation on its own thread at a fixed timestep, decoupled from both the message loop and the frame
+// rate. The window thread only records which keys are held (set_simulation_input), the simulation thread
+// steps the scene and publishes every step through a triple buffer (see triple_buffer.h), and the render
+// thread picks up the newest step each frame and interpolates between it and the step before (see
+// interpolate_scene), so motion is smooth whether frames come faster or slower than steps. While the window
+// is hidden, or the scene is paused and has settled, the thread parks until the window thread changes
+// something rather than stepping a scene that can't move. Parked time isn't simulated afterwards.
+// Deliberately has no Vulkan dependency.
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "triple_buffer.h"
+
+const double SIMULATION_STEP_SECONDS = 1.0 / 120.0;
+const double CAMERA_SPEED = 2.0; // units per second while a key is held
+const double MAX_SIMULATION_CATCH_UP_SECONDS = 0.25; // after a stall, steps further behind than this are dropped
+
+struct SceneState {
+	double cam_position = 3.0;
+	double time = 0.0; // simulated seconds, drives the model's spin
+	uint64_t step = 0;
+};
+
+// The two newest steps, and when the newest one became current
+struct SceneSnapshot {
+	SceneState previous;
+	SceneState current;
+	std::chrono::steady_clock::time_point current_time;
+};
+
+struct Simulation {
+	TripleBuffer<SceneSnapshot> snapshots;
+	std::atomic<int32_t> camera_input{ 0 }; // -1, 0 or 1
+	std::atomic<bool> paused{ false }; // stops the model spinning, the camera still moves
+	std::atomic<bool> hidden{ false }; // nothing is drawn, so nothing needs simulating
+	std::atomic<bool> running{ false };
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool woken = false; // guarded by mutex, set whenever the window thread may have given it something to do
+};
+
+void start_simulation(Simulation& simulation, const SceneState& initial_state);
+void stop_simulation(Simulation& simulation);
+void set_simulation_input(Simulation& simulation, int32_t camera_input);
+void set_simulation_paused(Simulation& simulation, bool paused);
+void set_simulation_hidden(Simulation& simulation, bool hidden);
+// Takes at least one more step if it was parked, for input that doesn't change what it simulates
+void wake_simulation(Simulation& simulation);
+const SceneSnapshot& read_scene_snapshot(Simulation& simulation);
+
+// A scene that isn't being simulated, e.g. a benchmark or headless camera path
+SceneSnapshot get_still_scene_snapshot(double cam_position, double time);
+SceneState interpolate_scene(const SceneSnapshot& snapshot, std::chrono::steady_clock::time_point now);
+// Nothing moved in the newest step, so every frame drawn from this snapshot looks the same
+bool is_scene_settled(const SceneSnapshot& snapshot);
@@ -0,0 +1,109 @@
+#include "task_graph.h"
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+
+#include "log.h"
+#include "profile.h"
+
+// Dependencies can only point backwards, so the graph can't have cycles
+uint32_t add_task(TaskGraph& graph, const char* name, const std::vector<uint32_t>& dependencies, std::function<void()> run) {
+	uint32_t index = static_cast<uint32_t>(graph.tasks.size());
+	for (uint32_t dependency : dependencies) {
+		if (dependency >= index) {
+			throw std::runtime_error("Task dependencies must be added before the task!");
+		}
+	}
+
+	Task task;
+	task.name = name;
+	task.run = std::move(run);
+	task.dependencies = dependencies;
+	graph.tasks.push_back(std::move(task));
+
+	return index;
+}
+
+struct TaskGraphRun {
+	TaskGraph* graph;
+	JobSystem* jobs;
+	std::unique_ptr<std::atomic<uint32_t>[]> remaining_dependencies;
+	std::vector<std::vector<uint32_t>> dependents;
+	JobCounter counter;
+	std::atomic<bool> failed{ false };
+	std::exception_ptr error;
+	std::chrono::steady_clock::time_point start;
+};
+
+static void run_graph_task(void* data, uint32_t index, uint32_t) {
+	TaskGraphRun& run = *static_cast<TaskGraphRun*>(data);
+	Task& task = run.graph->tasks[index];
+	task.thread_index = get_job_thread_index(*run.jobs);
+	task.start_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - run.start).count();
+	if (!run.failed.load()) {
+		try {
+			PROFILE_ZONE(task.name);
+			task.run();
+		}
+		catch (...) {
+			if (!run.failed.exchange(true)) {
+				run.error = std::current_exception();
+			}
+		}
+	}
+	task.end_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - run.start).count();
+
+	// Submitted before this task's own job finishes, so the counter can't reach zero while dependents are left
+	for (uint32_t dependent : run.dependents[index]) {
+		if (run.remaining_dependencies[dependent].fetch_sub(1) == 1) {
+			submit_job(*run.jobs, Job{ run_graph_task, &run, dependent, dependent + 1, &run.counter });
+		}
+	}
+}
+
+// Each task becomes a job as soon as the last task it depends on finishes, and the calling thread runs jobs
+// until the whole graph is done. After the first exception thrown by a task the remaining tasks are skipped,
+// and the exception is rethrown here
+void run_task_graph(TaskGraph& graph, JobSystem& jobs) {
+	uint32_t task_count = static_cast<uint32_t>(graph.tasks.size());
+	TaskGraphRun run;
+	run.graph = &graph;
+	run.jobs = &jobs;
+	run.remaining_dependencies = std::make_unique<std::atomic<uint32_t>[]>(task_count);
+	run.dependents.resize(task_count);
+	for (uint32_t i = 0; i < task_count; ++i) {
+		run.remaining_dependencies[i].store(static_cast<uint32_t>(graph.tasks[i].dependencies.size()));
+		for (uint32_t dependency : graph.tasks[i].dependencies) {
+			run.dependents[dependency].push_back(i);
+		}
+	}
+
+	run.start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < task_count; ++i) {
+		if (graph.tasks[i].dependencies.empty()) {
+			submit_job(jobs, Job{ run_graph_task, &run, i, i + 1, &run.counter });
+		}
+	}
+	wait_for_jobs(jobs, run.counter);
+	graph.total_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - run.start).count();
+
+	if (run.error) {
+		std::rethrow_exception(run.error);
+	}
+}
+
+// Serial time is what the same tasks would have taken one after another
+// Logged rather than printed, startup runs with the logger already going
+void report_task_graph(const TaskGraph& graph, const char* title) {
+	double serial_seconds = 0.0;
+	LOG_INFO("%s (task / thread / start ms / duration ms):", title);
+	for (const Task& task : graph.tasks) {
+		double duration = task.end_seconds - task.start_seconds;
+		serial_seconds += duration;
+		LOG_INFO("\t%s / %u / %g / %g", task.name, task.thread_index, task.start_seconds * 1000.0, duration * 1000.0);
+	}
+	LOG_INFO("\t%g ms total, %g ms if run serially", graph.total_seconds * 1000.0, serial_seconds * 1000.0);
+}
@@ -0,0 +1,30 @@
+// Runs a set of tasks on the job system (see job_system.h), each one as soon as the tasks it depends on are
+// done. Startup uses it to overlap the CPU only work (texture decode, model parsing) with Vulkan object
+// creation. Deliberately has no Vulkan dependency.
+
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "job_system.h"
+
+struct Task {
+	const char* name; // must be a string literal, it doubles as the task's profile zone
+	std::function<void()> run;
+	std::vector<uint32_t> dependencies; // indices of tasks added before this one
+
+	// Filled in by run_task_graph, relative to when the graph started
+	double start_seconds = 0.0;
+	double end_seconds = 0.0;
+	uint32_t thread_index = 0; // job system thread it ran on
+};
+
+struct TaskGraph {
+	std::vector<Task> tasks;
+	double total_seconds = 0.0;
+};
+
+uint32_t add_task(TaskGraph& graph, const char* name, const std::vector<uint32_t>& dependencies, std::function<void()> run);
+void run_task_graph(TaskGraph& graph, JobSystem& jobs);
+void report_task_graph(const TaskGraph& graph, const char* title);
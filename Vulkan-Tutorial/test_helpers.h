@@ -0,0 +1,37 @@
+// Just enough of a test harness for the GPU free tests (the *_tests.cpp programs in CMakeLists.txt). A failed
+// CHECK prints where it was and carries on, and run_tests turns any failure into a non zero exit code for ctest.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+struct TestCase {
+	const char* name;
+	void (*run)();
+};
+
+inline uint32_t& get_test_failure_count() {
+	static uint32_t failure_count = 0;
+	return failure_count;
+}
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			std::cout << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed\n"; \
+			get_test_failure_count()++; \
+		} \
+	} while (0)
+
+template<size_t N>
+int run_tests(const TestCase (&tests)[N]) {
+	for (const TestCase& test : tests) {
+		uint32_t failures_before = get_test_failure_count();
+		test.run();
+		std::cout << (get_test_failure_count() == failures_before ? "[pass] " : "[FAIL] ") << test.name << '\n';
+	}
+
+	std::cout << get_test_failure_count() << " failed check(s)\n";
+	return get_test_failure_count() == 0 ? 0 : 1;
+}
@@ -0,0 +1,27 @@
+#include "texture.h"
+
+#include <stdexcept>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "profile.h"
+
+// Decoding doesn't touch the device, so it can run while the device is still being created
+TexturePixels load_texture_pixels(const std::string& path) {
+	PROFILE_ZONE("load_texture_pixels");
+	TexturePixels texture;
+	int tex_channels;
+	texture.pixels = stbi_load(path.c_str(), &texture.width, &texture.height, &tex_channels, STBI_rgb_alpha);
+	
+	if(!texture.pixels) {
+		throw std::runtime_error("Failed to load texture image!");
+	}
+
+	return texture;
+}
+
+void free_texture_pixels(TexturePixels& texture) {
+	stbi_image_free(texture.pixels);
+	texture.pixels = nullptr;
+}
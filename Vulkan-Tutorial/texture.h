@@ -0,0 +1,12 @@
+#pragma once
+#include <string>
+
+// Decoded RGBA8, owned until free_texture_pixels
+struct TexturePixels {
+	unsigned char* pixels = nullptr;
+	int width = 0;
+	int height = 0;
+};
+
+TexturePixels load_texture_pixels(const std::string& path);
+void free_texture_pixels(TexturePixels& texture);
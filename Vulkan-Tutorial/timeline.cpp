@@ -0,0 +1,59 @@
+#include "timeline.h"
+
+#include <stdexcept>
+
+#include "host_allocator.h"
+
+Timeline create_timeline(VkDevice device) {
+	VkSemaphoreTypeCreateInfo type_info{};
+	type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	type_info.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphore_info{};
+	semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphore_info.pNext = &type_info;
+
+	Timeline timeline;
+	if (vkCreateSemaphore(device, &semaphore_info, get_host_allocator(HOST_ARENA_SYNC), &timeline.semaphore) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create timeline semaphore!");
+	}
+
+	return timeline;
+}
+
+void destroy_timeline(VkDevice device, Timeline& timeline) {
+	vkDestroySemaphore(device, timeline.semaphore, get_host_allocator(HOST_ARENA_SYNC));
+	timeline.semaphore = VK_NULL_HANDLE;
+}
+
+// The value the caller's next submission should signal
+uint64_t next_timeline_value(Timeline& timeline) {
+	return ++timeline.last_submitted_value;
+}
+
+uint64_t get_completed_timeline_value(VkDevice device, const Timeline& timeline) {
+	uint64_t value = 0;
+	if (vkGetSemaphoreCounterValue(device, timeline.semaphore, &value) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to query timeline semaphore!");
+	}
+
+	return value;
+}
+
+bool is_timeline_value_complete(VkDevice device, const Timeline& timeline, uint64_t value) {
+	return get_completed_timeline_value(device, timeline) >= value;
+}
+
+void wait_for_timeline_value(VkDevice device, const Timeline& timeline, uint64_t value) {
+	// Value 0 is the initial state, so waiting on it (a slot that has never been submitted) returns immediately
+	VkSemaphoreWaitInfo wait_info{};
+	wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	wait_info.semaphoreCount = 1;
+	wait_info.pSemaphores = &timeline.semaphore;
+	wait_info.pValues = &value;
+
+	if (vkWaitSemaphores(device, &wait_info, UINT64_MAX) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to wait on timeline semaphore!");
+	}
+}
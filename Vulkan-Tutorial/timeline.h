@@ -0,0 +1,20 @@
+// A single timeline semaphore (Vulkan 1.2) on the graphics queue. Every frame and upload submission signals
+// the next value, so anything that needs to know when the GPU is done with something just remembers the
+// value of the submission that last used it and waits for (or polls) that value instead of a fence.
+
+#pragma once
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+struct Timeline {
+	VkSemaphore semaphore = VK_NULL_HANDLE;
+	uint64_t last_submitted_value = 0;
+};
+
+Timeline create_timeline(VkDevice device);
+void destroy_timeline(VkDevice device, Timeline& timeline);
+uint64_t next_timeline_value(Timeline& timeline);
+uint64_t get_completed_timeline_value(VkDevice device, const Timeline& timeline);
+bool is_timeline_value_complete(VkDevice device, const Timeline& timeline, uint64_t value);
+void wait_for_timeline_value(VkDevice device, const Timeline& timeline, uint64_t value);
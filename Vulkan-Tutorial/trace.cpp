@@ -0,0 +1,39 @@
+#include "trace.h"
+
+#include <fstream>
+
+#include "log.h"
+
+// Taken during static initialization, so every zone starts after it
+static const std::chrono::steady_clock::time_point TRACE_EPOCH = std::chrono::steady_clock::now();
+
+double to_trace_microseconds(std::chrono::steady_clock::time_point time) {
+	return std::chrono::duration<double, std::micro>(time - TRACE_EPOCH).count();
+}
+
+void write_chrome_trace(const std::string& path, const std::vector<TraceEvent>& events, const std::vector<TraceThread>& threads) {
+	std::ofstream file(path);
+	if (!file.is_open()) {
+		LOG_ERROR("Failed to open trace file %s", path.c_str());
+		return;
+	}
+
+	file << "{\"traceEvents\":[\n";
+	bool first = true;
+	for (const TraceThread& thread : threads) {
+		file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << thread.id
+			<< ",\"args\":{\"name\":\"" << thread.name << "\"}}";
+		first = false;
+	}
+
+	file.precision(3);
+	file << std::fixed;
+	for (const TraceEvent& event : events) {
+		file << (first ? "" : ",\n") << "{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.thread_id
+			<< ",\"ts\":" << event.start_us << ",\"dur\":" << event.duration_us << '}';
+		first = false;
+	}
+	file << "\n]}\n";
+
+	LOG_INFO("Wrote %llu trace events to %s", static_cast<unsigned long long>(events.size()), path.c_str());
+}
@@ -0,0 +1,27 @@
+// Chrome trace event format (chrome://tracing, ui.perfetto.dev). Zones are complete ("X") events with
+// microsecond times relative to a process wide epoch, so CPU zones from any thread and GPU zones that have
+// been converted to CPU time all line up on one timeline.
+
+#pragma once
+#include <cstdint>
+#include <chrono>
+#include <string>
+#include <vector>
+
+const uint32_t TRACE_GPU_THREAD_ID = 1000; // GPU zones get a track of their own
+
+struct TraceEvent {
+	const char* name; // must outlive the trace, in practice a string literal
+	const char* category;
+	uint32_t thread_id;
+	double start_us;
+	double duration_us;
+};
+
+struct TraceThread {
+	uint32_t id;
+	std::string name;
+};
+
+double to_trace_microseconds(std::chrono::steady_clock::time_point time);
+void write_chrome_trace(const std::string& path, const std::vector<TraceEvent>& events, const std::vector<TraceThread>& threads);
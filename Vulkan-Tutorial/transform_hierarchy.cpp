@@ -0,0 +1,200 @@
+#include "transform_hierarchy.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#if TRANSFORM_SIMD
+#include <emmintrin.h>
+#endif
+
+// Grows every array by a whole block of identity nodes
+static void add_transform_block(TransformHierarchy& hierarchy) {
+	size_t size = hierarchy.parents.size() + TRANSFORM_BLOCK_SIZE;
+	hierarchy.parents.resize(size, TRANSFORM_NO_PARENT);
+	hierarchy.position_x.resize(size, 0.0f);
+	hierarchy.position_y.resize(size, 0.0f);
+	hierarchy.position_z.resize(size, 0.0f);
+	hierarchy.rotation_x.resize(size, 0.0f);
+	hierarchy.rotation_y.resize(size, 0.0f);
+	hierarchy.rotation_z.resize(size, 0.0f);
+	hierarchy.rotation_w.resize(size, 1.0f);
+	hierarchy.scale_x.resize(size, 1.0f);
+	hierarchy.scale_y.resize(size, 1.0f);
+	hierarchy.scale_z.resize(size, 1.0f);
+	hierarchy.local_matrices.resize(size, glm::mat4(1.0f));
+	hierarchy.world_matrices.resize(size, glm::mat4(1.0f));
+	hierarchy.dirty.resize(size, 0);
+	hierarchy.updated.resize(size, 0);
+}
+
+static void mark_transform_dirty(TransformHierarchy& hierarchy, uint32_t node) {
+	hierarchy.dirty[node] = 1;
+	if (node < hierarchy.first_dirty) {
+		hierarchy.first_dirty = node;
+	}
+}
+
+uint32_t add_transform_node(TransformHierarchy& hierarchy, uint32_t parent) {
+	if (parent != TRANSFORM_NO_PARENT && parent >= hierarchy.node_count) {
+		throw std::runtime_error("Transform parent has to be added before its children!");
+	}
+
+	uint32_t node = hierarchy.node_count++;
+	if (node == hierarchy.parents.size()) {
+		add_transform_block(hierarchy);
+	}
+	hierarchy.parents[node] = parent;
+	// Its world matrix still has to pick up the parent's
+	mark_transform_dirty(hierarchy, node);
+
+	return node;
+}
+
+void set_local_position(TransformHierarchy& hierarchy, uint32_t node, const glm::vec3& position) {
+	hierarchy.position_x[node] = position.x;
+	hierarchy.position_y[node] = position.y;
+	hierarchy.position_z[node] = position.z;
+	mark_transform_dirty(hierarchy, node);
+}
+
+void set_local_rotation(TransformHierarchy& hierarchy, uint32_t node, const glm::quat& rotation) {
+	hierarchy.rotation_x[node] = rotation.x;
+	hierarchy.rotation_y[node] = rotation.y;
+	hierarchy.rotation_z[node] = rotation.z;
+	hierarchy.rotation_w[node] = rotation.w;
+	mark_transform_dirty(hierarchy, node);
+}
+
+void set_local_scale(TransformHierarchy& hierarchy, uint32_t node, const glm::vec3& scale) {
+	hierarchy.scale_x[node] = scale.x;
+	hierarchy.scale_y[node] = scale.y;
+	hierarchy.scale_z[node] = scale.z;
+	mark_transform_dirty(hierarchy, node);
+}
+
+#if TRANSFORM_SIMD
+// Translation * rotation * scale for the four nodes starting at first, one node per lane. The rotation part is
+// the same expansion glm::mat3_cast does
+static void build_local_matrix_block(TransformHierarchy& hierarchy, uint32_t first) {
+	__m128 x = _mm_loadu_ps(&hierarchy.rotation_x[first]);
+	__m128 y = _mm_loadu_ps(&hierarchy.rotation_y[first]);
+	__m128 z = _mm_loadu_ps(&hierarchy.rotation_z[first]);
+	__m128 w = _mm_loadu_ps(&hierarchy.rotation_w[first]);
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 two = _mm_set1_ps(2.0f);
+
+	__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+	__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+	__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+	__m128 sx = _mm_loadu_ps(&hierarchy.scale_x[first]);
+	__m128 sy = _mm_loadu_ps(&hierarchy.scale_y[first]);
+	__m128 sz = _mm_loadu_ps(&hierarchy.scale_z[first]);
+
+	// columns[c][r] holds row r of column c for all four nodes
+	__m128 columns[4][4];
+	columns[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+	columns[0][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+	columns[0][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+	columns[0][3] = _mm_setzero_ps();
+	columns[1][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+	columns[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+	columns[1][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+	columns[1][3] = _mm_setzero_ps();
+	columns[2][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+	columns[2][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+	columns[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+	columns[2][3] = _mm_setzero_ps();
+	columns[3][0] = _mm_loadu_ps(&hierarchy.position_x[first]);
+	columns[3][1] = _mm_loadu_ps(&hierarchy.position_y[first]);
+	columns[3][2] = _mm_loadu_ps(&hierarchy.position_z[first]);
+	columns[3][3] = one;
+
+	// After the transpose each register is one node's column
+	for (uint32_t column = 0; column < 4; ++column) {
+		__m128* rows = columns[column];
+		_MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+		for (uint32_t lane = 0; lane < TRANSFORM_BLOCK_SIZE; ++lane) {
+			_mm_storeu_ps(&hierarchy.local_matrices[first + lane][column][0], rows[lane]);
+		}
+	}
+}
+
+static void multiply_matrices(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+	__m128 a0 = _mm_loadu_ps(&a[0][0]);
+	__m128 a1 = _mm_loadu_ps(&a[1][0]);
+	__m128 a2 = _mm_loadu_ps(&a[2][0]);
+	__m128 a3 = _mm_loadu_ps(&a[3][0]);
+	for (uint32_t column = 0; column < 4; ++column) {
+		__m128 result = _mm_mul_ps(a0, _mm_set1_ps(b[column][0]));
+		result = _mm_add_ps(result, _mm_mul_ps(a1, _mm_set1_ps(b[column][1])));
+		result = _mm_add_ps(result, _mm_mul_ps(a2, _mm_set1_ps(b[column][2])));
+		result = _mm_add_ps(result, _mm_mul_ps(a3, _mm_set1_ps(b[column][3])));
+		_mm_storeu_ps(&out[column][0], result);
+	}
+}
+#else
+static void build_local_matrix_block(TransformHierarchy& hierarchy, uint32_t first) {
+	for (uint32_t node = first; node < first + TRANSFORM_BLOCK_SIZE; ++node) {
+		glm::quat rotation(hierarchy.rotation_w[node], hierarchy.rotation_x[node], hierarchy.rotation_y[node], hierarchy.rotation_z[node]);
+		glm::mat4 local = glm::mat4_cast(rotation);
+		local[0] = local[0] * hierarchy.scale_x[node];
+		local[1] = local[1] * hierarchy.scale_y[node];
+		local[2] = local[2] * hierarchy.scale_z[node];
+		local[3] = glm::vec4(hierarchy.position_x[node], hierarchy.position_y[node], hierarchy.position_z[node], 1.0f);
+		hierarchy.local_matrices[node] = local;
+	}
+}
+
+static void multiply_matrices(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+	out = a * b;
+}
+#endif
+
+uint32_t update_world_matrices(TransformHierarchy& hierarchy) {
+	uint32_t node_count = hierarchy.node_count;
+	uint32_t first_dirty = hierarchy.first_dirty;
+	if (first_dirty >= node_count) {
+		return 0;
+	}
+
+	// Local matrices first, a whole block whenever any node in it is dirty. Padding nodes are never dirty
+	uint32_t block_count = static_cast<uint32_t>(hierarchy.parents.size()) / TRANSFORM_BLOCK_SIZE;
+	for (uint32_t block = first_dirty / TRANSFORM_BLOCK_SIZE; block < block_count; ++block) {
+		uint32_t block_dirty;
+		static_assert(sizeof(block_dirty) == TRANSFORM_BLOCK_SIZE, "one dirty byte per node in the block");
+		std::memcpy(&block_dirty, &hierarchy.dirty[block * TRANSFORM_BLOCK_SIZE], sizeof(block_dirty));
+		if (block_dirty != 0) {
+			build_local_matrix_block(hierarchy, block * TRANSFORM_BLOCK_SIZE);
+		}
+	}
+
+	// Parents come first, so theirs are final by the time a child is reached. A parent before first_dirty
+	// wasn't touched by this update, whatever its updated flag still says from an earlier one
+	uint32_t updated_count = 0;
+	for (uint32_t node = first_dirty; node < node_count; ++node) {
+		uint32_t parent = hierarchy.parents[node];
+		bool parent_updated = parent != TRANSFORM_NO_PARENT && parent >= first_dirty && hierarchy.updated[parent];
+		bool update = hierarchy.dirty[node] || parent_updated;
+		hierarchy.updated[node] = update;
+		if (!update) {
+			continue;
+		}
+
+		if (parent == TRANSFORM_NO_PARENT) {
+			hierarchy.world_matrices[node] = hierarchy.local_matrices[node];
+		}
+		else {
+			multiply_matrices(hierarchy.world_matrices[parent], hierarchy.local_matrices[node], hierarchy.world_matrices[node]);
+		}
+		hierarchy.dirty[node] = 0;
+		updated_count++;
+	}
+	hierarchy.first_dirty = node_count;
+
+	return updated_count;
+}
+
+const glm::mat4& get_world_matrix(const TransformHierarchy& hierarchy, uint32_t node) {
+	return hierarchy.world_matrices[node];
+}
@@ -0,0 +1,50 @@
+// Scene transforms, stored data oriented. Nodes are only ever added after their parent, so the arrays are
+// always in topological order and every world matrix can be computed in one forward pass, with the parent's
+// already done by the time its children are reached. Local translation, rotation and scale are kept one
+// component per array, so with SSE the local matrices of four neighbouring nodes are built at once, and
+// world = parent world * local is a column at a time. Setting a local transform only marks the node dirty,
+// update_world_matrices then starts from the first dirty node and recomputes just the nodes that are dirty
+// or whose parent changed in the same update, so a subtree that didn't move costs a couple of flag tests per
+// node. The arrays are padded to a whole number of SIMD blocks with identity nodes. Checked against plain glm
+// in transform_hierarchy_tests.cpp.
+// Deliberately has no Vulkan dependency.
+
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_SIMD 1
+#else
+#define TRANSFORM_SIMD 0
+#endif
+
+const uint32_t TRANSFORM_NO_PARENT = UINT32_MAX;
+const uint32_t TRANSFORM_BLOCK_SIZE = 4; // nodes whose local matrices are built together
+
+struct TransformHierarchy {
+	uint32_t node_count = 0;
+	std::vector<uint32_t> parents; // always lower than the node's own index
+	std::vector<float> position_x, position_y, position_z;
+	std::vector<float> rotation_x, rotation_y, rotation_z, rotation_w; // unit quaternion
+	std::vector<float> scale_x, scale_y, scale_z;
+	std::vector<glm::mat4> local_matrices; // only valid for nodes that aren't dirty
+	std::vector<glm::mat4> world_matrices;
+	std::vector<uint8_t> dirty; // local transform changed since the last update
+	std::vector<uint8_t> updated; // world matrix was recomputed in the last update that reached the node
+	uint32_t first_dirty = 0; // node_count when nothing is dirty
+};
+
+// Throws if parent isn't TRANSFORM_NO_PARENT or an existing node. New nodes start at identity
+uint32_t add_transform_node(TransformHierarchy& hierarchy, uint32_t parent);
+void set_local_position(TransformHierarchy& hierarchy, uint32_t node, const glm::vec3& position);
+void set_local_rotation(TransformHierarchy& hierarchy, uint32_t node, const glm::quat& rotation);
+void set_local_scale(TransformHierarchy& hierarchy, uint32_t node, const glm::vec3& scale);
+// Returns how many world matrices were recomputed
+uint32_t update_world_matrices(TransformHierarchy& hierarchy);
+const glm::mat4& get_world_matrix(const TransformHierarchy& hierarchy, uint32_t node);
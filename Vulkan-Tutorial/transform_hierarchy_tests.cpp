@@ -0,0 +1,236 @@
+// Tests for the transform hierarchy. The batched local matrices (SSE when TRANSFORM_SIMD is on) are checked
+// against glm::translate * glm::mat4_cast * glm::scale, and world matrices against the same product walked up
+// the parents one node at a time.
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "test_helpers.h"
+#include "transform_hierarchy.h"
+
+const float MATRIX_EPSILON = 1e-5f; // relative to the largest element
+
+struct LocalTransform {
+	glm::vec3 position;
+	glm::quat rotation;
+	glm::vec3 scale;
+};
+
+static LocalTransform create_random_transform(std::mt19937& random) {
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> angle(-3.14159f, 3.14159f);
+	std::uniform_real_distribution<float> scale(0.5f, 1.5f);
+	glm::vec3 axis(unit(random), unit(random), unit(random) + 2.0f); // never zero length
+
+	return LocalTransform{
+		glm::vec3(unit(random), unit(random), unit(random)) * 2.0f,
+		glm::angleAxis(angle(random), glm::normalize(axis)),
+		glm::vec3(scale(random), scale(random), scale(random)),
+	};
+}
+
+static glm::mat4 get_reference_local_matrix(const LocalTransform& transform) {
+	return glm::translate(glm::mat4(1.0f), transform.position) * glm::mat4_cast(transform.rotation) * glm::scale(glm::mat4(1.0f), transform.scale);
+}
+
+static void set_local_transform(TransformHierarchy& hierarchy, uint32_t node, const LocalTransform& transform) {
+	set_local_position(hierarchy, node, transform.position);
+	set_local_rotation(hierarchy, node, transform.rotation);
+	set_local_scale(hierarchy, node, transform.scale);
+}
+
+// Parents always come first, so one forward pass is enough here too
+static std::vector<glm::mat4> get_reference_world_matrices(const std::vector<uint32_t>& parents, const std::vector<LocalTransform>& transforms) {
+	std::vector<glm::mat4> world(parents.size());
+	for (size_t node = 0; node < parents.size(); ++node) {
+		glm::mat4 local = get_reference_local_matrix(transforms[node]);
+		world[node] = parents[node] == TRANSFORM_NO_PARENT ? local : world[parents[node]] * local;
+	}
+
+	return world;
+}
+
+static bool are_matrices_close(const glm::mat4& a, const glm::mat4& b) {
+	float largest = 1.0f;
+	float difference = 0.0f;
+	for (int column = 0; column < 4; ++column) {
+		for (int row = 0; row < 4; ++row) {
+			largest = std::max(largest, std::abs(b[column][row]));
+			difference = std::max(difference, std::abs(a[column][row] - b[column][row]));
+		}
+	}
+
+	return difference <= MATRIX_EPSILON * largest;
+}
+
+static bool are_matrices_equal(const glm::mat4& a, const glm::mat4& b) {
+	for (int column = 0; column < 4; ++column) {
+		for (int row = 0; row < 4; ++row) {
+			if (a[column][row] != b[column][row]) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+// Pins down glm's conventions, which the other tests only compare against
+static void test_rotation_follows_glm_conventions() {
+	TransformHierarchy hierarchy;
+	uint32_t node = add_transform_node(hierarchy, TRANSFORM_NO_PARENT);
+	set_local_position(hierarchy, node, glm::vec3(1.0f, 2.0f, 3.0f));
+	set_local_rotation(hierarchy, node, glm::angleAxis(1.5707963f, glm::vec3(0.0f, 0.0f, 1.0f)));
+	set_local_scale(hierarchy, node, glm::vec3(2.0f));
+	CHECK(update_world_matrices(hierarchy) == 1);
+
+	// x goes to y, doubled, then moved
+	glm::vec4 point = get_world_matrix(hierarchy, node) * glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
+	CHECK(std::abs(point.x - 1.0f) < 1e-5f && std::abs(point.y - 4.0f) < 1e-5f && std::abs(point.z - 3.0f) < 1e-5f && point.w == 1.0f);
+}
+
+// 23 roots, so the last block is only partly used
+static void test_local_matrices_match_glm() {
+	std::mt19937 random(1);
+	TransformHierarchy hierarchy;
+	std::vector<uint32_t> parents;
+	std::vector<LocalTransform> transforms;
+	for (uint32_t i = 0; i < 23; ++i) {
+		uint32_t node = add_transform_node(hierarchy, TRANSFORM_NO_PARENT);
+		transforms.push_back(create_random_transform(random));
+		parents.push_back(TRANSFORM_NO_PARENT);
+		set_local_transform(hierarchy, node, transforms.back());
+	}
+	CHECK(update_world_matrices(hierarchy) == 23);
+
+	std::vector<glm::mat4> reference = get_reference_world_matrices(parents, transforms);
+	uint32_t wrong_matrices = 0;
+	for (uint32_t node = 0; node < 23; ++node) {
+		wrong_matrices += are_matrices_close(get_world_matrix(hierarchy, node), reference[node]) ? 0 : 1;
+	}
+	CHECK(wrong_matrices == 0);
+}
+
+// Only the node past the last whole block changes, and the identity padding after it stays identity
+static void test_partial_last_block() {
+	std::mt19937 random(2);
+	for (uint32_t node_count : { 1u, 3u, 5u, 6u, 7u }) {
+		TransformHierarchy hierarchy;
+		for (uint32_t i = 0; i < node_count; ++i) {
+			add_transform_node(hierarchy, i == 0 ? TRANSFORM_NO_PARENT : i - 1);
+		}
+		CHECK(update_world_matrices(hierarchy) == node_count);
+
+		uint32_t last = node_count - 1;
+		LocalTransform transform = create_random_transform(random);
+		set_local_transform(hierarchy, last, transform);
+		CHECK(update_world_matrices(hierarchy) == 1);
+		// Every ancestor is at identity, so the world matrix is just the local one
+		CHECK(are_matrices_close(get_world_matrix(hierarchy, last), get_reference_local_matrix(transform)));
+
+		uint32_t padded_count = static_cast<uint32_t>(hierarchy.world_matrices.size());
+		CHECK(padded_count % TRANSFORM_BLOCK_SIZE == 0 && padded_count >= node_count);
+		for (uint32_t padding = node_count; padding < padded_count; ++padding) {
+			CHECK(are_matrices_equal(hierarchy.local_matrices[padding], glm::mat4(1.0f)));
+			CHECK(are_matrices_equal(hierarchy.world_matrices[padding], glm::mat4(1.0f)));
+		}
+	}
+}
+
+// A root with two chains of 12 under it, added interleaved so both chains share blocks. Dirtying one node
+// halfway down chain a has to update exactly it and the rest of chain a
+static void test_dirty_node_updates_only_its_subtree() {
+	const uint32_t chain_length = 12;
+	const uint32_t dirty_depth = 6;
+	std::mt19937 random(3);
+	TransformHierarchy hierarchy;
+	std::vector<uint32_t> parents;
+	std::vector<LocalTransform> transforms;
+	auto add_node = [&](uint32_t parent) {
+		uint32_t node = add_transform_node(hierarchy, parent);
+		parents.push_back(parent);
+		transforms.push_back(create_random_transform(random));
+		set_local_transform(hierarchy, node, transforms.back());
+		return node;
+	};
+
+	uint32_t root = add_node(TRANSFORM_NO_PARENT);
+	std::vector<uint32_t> chain_a, chain_b;
+	for (uint32_t depth = 0; depth < chain_length; ++depth) {
+		chain_a.push_back(add_node(depth == 0 ? root : chain_a.back()));
+		chain_b.push_back(add_node(depth == 0 ? root : chain_b.back()));
+	}
+	update_world_matrices(hierarchy);
+	std::vector<glm::mat4> before = hierarchy.world_matrices;
+
+	uint32_t dirty_node = chain_a[dirty_depth];
+	transforms[dirty_node] = create_random_transform(random);
+	set_local_transform(hierarchy, dirty_node, transforms[dirty_node]);
+	CHECK(update_world_matrices(hierarchy) == chain_length - dirty_depth);
+
+	std::vector<glm::mat4> reference = get_reference_world_matrices(parents, transforms);
+	CHECK(are_matrices_equal(get_world_matrix(hierarchy, root), before[root]));
+	for (uint32_t depth = 0; depth < chain_length; ++depth) {
+		uint32_t a = chain_a[depth];
+		uint32_t b = chain_b[depth];
+		if (depth < dirty_depth) {
+			CHECK(are_matrices_equal(get_world_matrix(hierarchy, a), before[a]));
+		}
+		else {
+			CHECK(!are_matrices_equal(get_world_matrix(hierarchy, a), before[a]));
+			CHECK(are_matrices_close(get_world_matrix(hierarchy, a), reference[a]));
+		}
+		// Untouched, not even recomputed to the same value. Nodes ahead of the dirty one aren't visited at all
+		CHECK(are_matrices_equal(get_world_matrix(hierarchy, b), before[b]));
+		CHECK(b < dirty_node || !hierarchy.updated[b]);
+	}
+
+	CHECK(update_world_matrices(hierarchy) == 0);
+}
+
+// Random trees and random edits, checked against a full recompute every round
+static void test_random_edits_match_a_full_recompute() {
+	std::mt19937 random(4);
+	TransformHierarchy hierarchy;
+	std::vector<uint32_t> parents;
+	std::vector<LocalTransform> transforms;
+	for (uint32_t i = 0; i < 61; ++i) {
+		uint32_t parent = i == 0 || random() % 8 == 0 ? TRANSFORM_NO_PARENT : static_cast<uint32_t>(random() % i);
+		uint32_t node = add_transform_node(hierarchy, parent);
+		parents.push_back(parent);
+		transforms.push_back(create_random_transform(random));
+		set_local_transform(hierarchy, node, transforms.back());
+	}
+
+	uint32_t wrong_matrices = 0;
+	for (uint32_t round = 0; round < 20; ++round) {
+		for (uint32_t edit = 0; edit < round % 5; ++edit) {
+			uint32_t node = static_cast<uint32_t>(random() % parents.size());
+			transforms[node] = create_random_transform(random);
+			set_local_transform(hierarchy, node, transforms[node]);
+		}
+		update_world_matrices(hierarchy);
+
+		std::vector<glm::mat4> reference = get_reference_world_matrices(parents, transforms);
+		for (uint32_t node = 0; node < parents.size(); ++node) {
+			wrong_matrices += are_matrices_close(get_world_matrix(hierarchy, node), reference[node]) ? 0 : 1;
+		}
+	}
+	CHECK(wrong_matrices == 0);
+}
+
+int main() {
+	const TestCase tests[] = {
+		{ "rotation follows glm conventions", test_rotation_follows_glm_conventions },
+		{ "local matrices match glm", test_local_matrices_match_glm },
+		{ "partial last block", test_partial_last_block },
+		{ "dirty node updates only its subtree", test_dirty_node_updates_only_its_subtree },
+		{ "random edits match a full recompute", test_random_edits_match_a_full_recompute },
+	};
+
+	return run_tests(tests);
+}
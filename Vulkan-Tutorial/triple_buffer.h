@@ -0,0 +1,44 @@
+// Single producer, single consumer handoff of the latest value without locks. The producer always has a slot
+// to write into and the consumer always has a slot to read from, the third sits in between and is swapped
+// with one side or the other by a single atomic exchange. Values the consumer never got to are overwritten,
+// so the consumer only ever sees the newest one and neither side ever waits.
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+const uint32_t TRIPLE_BUFFER_INDEX_MASK = 3;
+const uint32_t TRIPLE_BUFFER_FRESH_BIT = 4; // the middle slot holds a value the consumer hasn't taken yet
+
+template<typename T>
+struct TripleBuffer {
+	std::array<T, 3> slots{};
+	std::atomic<uint32_t> middle{ 1 };
+	uint32_t write_index = 0; // only touched by the producer
+	uint32_t read_index = 2; // only touched by the consumer
+};
+
+// Producer side: fill the slot returned by get_triple_buffer_write_slot, then publish it
+template<typename T>
+T& get_triple_buffer_write_slot(TripleBuffer<T>& buffer) {
+	return buffer.slots[buffer.write_index];
+}
+
+template<typename T>
+void publish_triple_buffer(TripleBuffer<T>& buffer) {
+	uint32_t previous = buffer.middle.exchange(buffer.write_index | TRIPLE_BUFFER_FRESH_BIT, std::memory_order_acq_rel);
+	buffer.write_index = previous & TRIPLE_BUFFER_INDEX_MASK;
+}
+
+// Consumer side: the newest published value, or the same one as last time if nothing new was published.
+// Stays valid until the next call
+template<typename T>
+const T& read_triple_buffer(TripleBuffer<T>& buffer) {
+	if (buffer.middle.load(std::memory_order_relaxed) & TRIPLE_BUFFER_FRESH_BIT) {
+		uint32_t previous = buffer.middle.exchange(buffer.read_index, std::memory_order_acq_rel);
+		buffer.read_index = previous & TRIPLE_BUFFER_INDEX_MASK;
+	}
+
+	return buffer.slots[buffer.read_index];
+}
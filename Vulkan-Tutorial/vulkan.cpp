@@ -1,53 +1,254 @@
 #include "vulkan.h"
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
+Vulkan init_vulkan(const Platform& platform, const Settings& settings) {
+	if (!settings.trace_path.empty()) {
+		start_profile_collector();
+	}
+	PROFILE_ZONE("init_vulkan");
+	set_host_allocator_enabled(!settings.system_allocator);
 
-Vulkan init_vulkan(HINSTANCE hinst, HWND hwnd) {
 	if (ENABLE_VALIDATION_LAYERS) {
 		enable_validation_layers();
 	}
 
 	Vulkan vulkan;
-	vulkan.instance = create_instance();
-	vulkan.surface = create_surface(vulkan.instance, hwnd, hinst);
-	vulkan.physical_device = create_physical_device(vulkan.instance, vulkan.surface);
-	vulkan.device = create_logical_device(vulkan.physical_device, vulkan.surface, vulkan.graphics_queue, vulkan.present_queue);
-	vulkan.swap_chain = create_swap_chain(vulkan.physical_device, vulkan.surface, vulkan.device, IVec2{WIN_WIDTH, WIN_HEIGHT}, vulkan.swap_chain_images, vulkan.swap_chain_format, vulkan.swap_chain_extent);
-	vulkan.swap_chain_image_views = create_swap_chain_image_views(vulkan.swap_chain_images, vulkan.swap_chain_format, vulkan.device);
-	vulkan.render_pass = create_render_pass(vulkan.swap_chain_format, vulkan.device, vulkan.physical_device);
-	vulkan.descriptor_set_layout = create_descriptor_set_layout(vulkan.device);
-	vulkan.graphics_pipeline = create_graphics_pipeline(vulkan.device, vulkan.swap_chain_extent, vulkan.render_pass, vulkan.pipeline_layout, vulkan.descriptor_set_layout);
-	vulkan.command_pool = create_command_pool(vulkan.physical_device, vulkan.surface, vulkan.device);
-	create_depth_resources(vulkan.device, vulkan.physical_device, vulkan.swap_chain_extent, vulkan.depth_image, vulkan.depth_image_memory, vulkan.depth_image_view);
-	vulkan.swap_chain_framebuffers = create_framebuffers(vulkan.swap_chain_image_views, vulkan.depth_image_view, vulkan.render_pass, vulkan.swap_chain_extent, vulkan.device);
-	create_texture_image(vulkan.device, vulkan.physical_device, vulkan.texture_image, vulkan.texture_image_memory, vulkan.command_pool, vulkan.graphics_queue);
-	vulkan.texture_image_view = create_texture_image_view(vulkan.device, vulkan.texture_image);
-	vulkan.texture_sampler = create_texture_sampler(vulkan.device, vulkan.physical_device);
-	
-	load_model(vulkan.vertices, vulkan.indices);
-	vulkan.vertex_buffer = create_vertex_buffer(vulkan.vertices, vulkan.device, vulkan.physical_device, vulkan.vertex_buffer_memory, vulkan.command_pool, vulkan.graphics_queue);
-	vulkan.index_buffer = create_index_buffer(vulkan.indices, vulkan.device, vulkan.physical_device, vulkan.command_pool, vulkan.graphics_queue, vulkan.index_buffer_memory);
-	create_uniform_buffers(vulkan.device, vulkan.physical_device, vulkan.uniform_buffers, vulkan.uniform_buffers_memory, vulkan.uniform_buffers_mapped);
-	vulkan.descriptor_pool = create_descriptor_pool(vulkan.device);
-	vulkan.descriptor_sets = create_descriptor_sets(vulkan.descriptor_set_layout, vulkan.descriptor_pool, vulkan.device, vulkan.uniform_buffers, vulkan.texture_image_view, vulkan.texture_sampler);
-	vulkan.command_buffers = create_command_buffers(vulkan.command_pool, vulkan.device);
-	create_sync_objects(vulkan.device, vulkan.image_available_semaphores, vulkan.render_finished_semaphores, vulkan.in_flight_fences);
+	vulkan.jobs = std::make_unique<JobSystem>();
+	start_job_system(*vulkan.jobs, std::thread::hardware_concurrency());
+	vulkan.headless = platform.headless;
+	vulkan.present_policy = settings.present_policy;
+	vulkan.wait_before_acquire = settings.wait_before_acquire;
+	vulkan.dynamic_resolution = create_dynamic_resolution(settings.benchmark ? 0 : settings.target_frame_rate, settings.min_render_scale, settings.render_scale);
+	bool time_frames = vulkan.dynamic_resolution.enabled; // read by a task that runs alongside the one that may turn it off
+	vulkan.model_node = add_transform_node(vulkan.transforms, TRANSFORM_NO_PARENT);
+	TexturePixels texture_pixels{};
+
+	// Tasks write disjoint members of vulkan. Anything that records into command_pool or submits to the queue
+	// has to be ordered after the previous user, so the uploads form a chain
+	TaskGraph startup;
+	uint32_t decode_texture = add_task(startup, "decode texture", {}, [&] {
+		texture_pixels = load_texture_pixels(TEXTURE_PATH);
+	});
+	uint32_t parse_model = add_task(startup, "load model", {}, [&] {
+		load_model(MODEL_PATH, vulkan.vertices, vulkan.indices, vulkan.draw_items);
+		vulkan.occluders.push_back(load_occluder_mesh(OCCLUDER_PATH));
+		for (const DrawItem& draw_item : vulkan.draw_items) {
+			vulkan.occludee_bounds.push_back(draw_item.bounds);
+		}
+		vulkan.occlusion_buffer = create_occlusion_buffer(OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT);
+	});
+	uint32_t create_device = add_task(startup, "create device", {}, [&] {
+		vulkan.instance = create_instance(vulkan.headless);
+		if (!vulkan.headless) {
+			vulkan.surface = create_surface(vulkan.instance, platform);
+		}
+		vulkan.physical_device = create_physical_device(vulkan.instance, vulkan.surface);
+		vulkan.device = create_logical_device(vulkan.physical_device, vulkan.surface, vulkan.graphics_queue, vulkan.present_queue);
+		vulkan.timeline = create_timeline(vulkan.device);
+	});
+	uint32_t create_images = add_task(startup, "create swap chain", { create_device }, [&] {
+		if (vulkan.headless) {
+			create_offscreen_images(vulkan.device, vulkan.physical_device, get_platform_size(platform), vulkan.swap_chain_images, vulkan.offscreen_images_memory,
+				vulkan.swap_chain_format, vulkan.swap_chain_extent);
+		}
+		else {
+			vulkan.swap_chain = create_swap_chain(vulkan.physical_device, vulkan.surface, vulkan.device, IVec2{WIN_WIDTH, WIN_HEIGHT}, vulkan.present_policy, VK_NULL_HANDLE,
+				vulkan.swap_chain_support, vulkan.swap_chain_images, vulkan.swap_chain_format, vulkan.swap_chain_extent);
+		}
+		create_swap_chain_image_views(vulkan.swap_chain_images, vulkan.swap_chain_format, vulkan.device, vulkan.swap_chain_image_views);
+		// The scene image is always copied or blitted out of once the pass is done
+		vulkan.render_pass = create_render_pass(vulkan.swap_chain_format, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, vulkan.device, vulkan.physical_device);
+		// Without a filtered blit the scene can only be copied across, so it has to be drawn at full size
+		if (!is_filtered_blit_supported(vulkan.physical_device, vulkan.swap_chain_format)) {
+			if (vulkan.dynamic_resolution.max_scale < 1.0f || vulkan.dynamic_resolution.enabled) {
+				LOG_WARNING("Swap chain format can't be blitted with linear filtering, rendering at full resolution");
+			}
+			vulkan.dynamic_resolution = create_dynamic_resolution(0, 1.0f, 1.0f);
+		}
+	});
+	uint32_t create_pipeline = add_task(startup, "create pipeline", { create_images }, [&] {
+		vulkan.descriptor_set_layout = create_descriptor_set_layout(vulkan.device);
+		vulkan.graphics_pipeline = create_graphics_pipeline(vulkan.device, vulkan.swap_chain_extent, vulkan.render_pass, vulkan.pipeline_layout, vulkan.descriptor_set_layout);
+	});
+	uint32_t create_targets = add_task(startup, "create framebuffers", { create_images }, [&] {
+		create_depth_resources(vulkan.device, vulkan.physical_device, vulkan.swap_chain_extent, vulkan.depth_image, vulkan.depth_image_memory, vulkan.depth_image_view);
+		create_scene_resources(vulkan.device, vulkan.physical_device, vulkan.swap_chain_extent, vulkan.swap_chain_format, vulkan.scene_image, vulkan.scene_image_memory,
+			vulkan.scene_image_view);
+		vulkan.render_target_extent = vulkan.swap_chain_extent;
+		vulkan.scene_framebuffer = create_scene_framebuffer(vulkan.scene_image_view, vulkan.depth_image_view, vulkan.render_pass, vulkan.swap_chain_extent, vulkan.device);
+		update_render_extent(vulkan);
+		vulkan.command_buffer_cache = create_command_buffer_cache(vulkan.physical_device, vulkan.surface, vulkan.device, vulkan.swap_chain_images.size());
+	});
+	uint32_t create_pools = add_task(startup, "create pools", { create_device }, [&] {
+		vulkan.command_pool = create_command_pool(vulkan.physical_device, vulkan.surface, vulkan.device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		vulkan.descriptor_pool = create_descriptor_pool(vulkan.device);
+		vulkan.gpu_profiler = create_gpu_profiler(vulkan.device, vulkan.physical_device, get_queue_families(vulkan.physical_device, vulkan.surface).graphics_family.value(),
+			MAX_FRAMES_IN_FLIGHT, vulkan.command_pool, vulkan.graphics_queue, vulkan.timeline, settings.trace_path, time_frames);
+		vulkan.pipeline_statistics = create_pipeline_statistics(vulkan.device, vulkan.physical_device, MAX_FRAMES_IN_FLIGHT, settings.pipeline_statistics);
+	});
+	uint32_t upload_texture = add_task(startup, "upload texture", { decode_texture, create_pools }, [&] {
+		create_texture_image(vulkan.device, vulkan.physical_device, texture_pixels, vulkan.texture_image, vulkan.texture_image_memory, vulkan.command_pool,
+			vulkan.graphics_queue, vulkan.timeline, vulkan.gpu_profiler);
+		free_texture_pixels(texture_pixels);
+		vulkan.texture_image_view = create_texture_image_view(vulkan.device, vulkan.texture_image);
+		vulkan.texture_sampler = create_texture_sampler(vulkan.device, vulkan.physical_device);
+	});
+	uint32_t upload_model = add_task(startup, "upload model", { parse_model, upload_texture }, [&] {
+		vulkan.vertex_buffer = create_vertex_buffer(vulkan.vertices, vulkan.device, vulkan.physical_device, vulkan.vertex_buffer_memory, vulkan.command_pool, vulkan.graphics_queue,
+			vulkan.timeline, vulkan.deletion_queue, vulkan.gpu_profiler);
+		vulkan.index_buffer = create_index_buffer(vulkan.indices, vulkan.device, vulkan.physical_device, vulkan.command_pool, vulkan.graphics_queue,
+			vulkan.timeline, vulkan.deletion_queue, vulkan.gpu_profiler, vulkan.index_buffer_memory);
+	});
+	add_task(startup, "create frame resources", { create_pipeline, create_targets, upload_model }, [&] {
+		vulkan.frames_in_flight = std::clamp(settings.frames_in_flight, 1u, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
+		vulkan.recording_thread_count = std::min(get_job_thread_count(*vulkan.jobs), MAX_RECORDING_THREADS);
+		create_frame_resources(vulkan);
+	});
+
+	run_task_graph(startup, *vulkan.jobs);
+	report_task_graph(startup, "Startup");
 
 	return vulkan;
 }
 
-VkInstance create_instance() {
+// Everything there is one of per frame in flight
+void create_frame_resources(Vulkan& vulkan) {
+	create_uniform_buffers(vulkan.device, vulkan.physical_device, vulkan.frames_in_flight, vulkan.uniform_buffers, vulkan.uniform_buffers_memory, vulkan.uniform_buffers_mapped);
+	vulkan.descriptor_sets = create_descriptor_sets(vulkan.descriptor_set_layout, vulkan.descriptor_pool, vulkan.device, vulkan.uniform_buffers,
+		vulkan.texture_image_view, vulkan.texture_sampler, vulkan.frames_in_flight);
+	vulkan.frame_command_pools = create_frame_command_pools(vulkan.physical_device, vulkan.surface, vulkan.device, vulkan.frames_in_flight, vulkan.recording_thread_count);
+	create_sync_objects(vulkan.device, vulkan.frames_in_flight, vulkan.image_available_semaphores, vulkan.render_finished_semaphores);
+	vulkan.frame_timeline_values.assign(vulkan.frames_in_flight, 0);
+	vulkan.frame_arenas.clear();
+	for (uint32_t i = 0; i < vulkan.frames_in_flight; ++i) {
+		vulkan.frame_arenas.push_back(create_frame_arena(FRAME_ARENA_CAPACITY));
+	}
+
+	// Cached command buffers have the old descriptor sets baked in
+	invalidate_command_buffer_cache(vulkan.command_buffer_cache);
+	vulkan.current_frame = 0;
+}
+
+void destroy_frame_resources(Vulkan& vulkan) {
+	for (size_t i = 0; i < vulkan.uniform_buffers.size(); ++i) {
+		vkDestroyBuffer(vulkan.device, vulkan.uniform_buffers[i], get_host_allocator(HOST_ARENA_BUFFER));
+		free_device_memory(vulkan.device, vulkan.uniform_buffers_memory[i]);
+	}
+
+	for (size_t i = 0; i < vulkan.image_available_semaphores.size(); ++i) {
+		vkDestroySemaphore(vulkan.device, vulkan.image_available_semaphores[i], get_host_allocator(HOST_ARENA_SYNC));
+		vkDestroySemaphore(vulkan.device, vulkan.render_finished_semaphores[i], get_host_allocator(HOST_ARENA_SYNC));
+	}
+
+	for (FrameCommandPools& frame_pools : vulkan.frame_command_pools) {
+		vkDestroyCommandPool(vulkan.device, frame_pools.primary_pool, get_host_allocator(HOST_ARENA_COMMAND));
+		for (VkCommandPool worker_pool : frame_pools.worker_pools) {
+			vkDestroyCommandPool(vulkan.device, worker_pool, get_host_allocator(HOST_ARENA_COMMAND));
+		}
+	}
+
+	// Frees the descriptor sets
+	vkResetDescriptorPool(vulkan.device, vulkan.descriptor_pool, 0);
+}
+
+void set_frames_in_flight(Vulkan& vulkan, uint32_t frames_in_flight) {
+	frames_in_flight = std::clamp(frames_in_flight, 1u, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
+	if (frames_in_flight == vulkan.frames_in_flight) {
+		return;
+	}
+
+	// Every frame slot is being replaced, so wait for the newest submission rather than idling the device
+	wait_for_timeline_value(vulkan.device, vulkan.timeline, vulkan.timeline.last_submitted_value);
+	destroy_frame_resources(vulkan);
+	vulkan.frames_in_flight = frames_in_flight;
+	create_frame_resources(vulkan);
+	LOG_INFO("Frames in flight: %u", frames_in_flight);
+}
+
+void report_frame_pacing(const Vulkan& vulkan) {
+	std::cout << "Frame pacing (frames in flight / frames / mean frame ms / mean GPU wait ms / CPU-GPU overlap):\n";
+	for (uint32_t i = 1; i <= static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT); ++i) {
+		const FramePacingStats& stats = vulkan.frame_pacing_stats[i];
+		if (stats.frame_count == 0) {
+			continue;
+		}
+
+		double mean_frame_ms = stats.frame_seconds * 1000.0 / stats.frame_count;
+		double mean_wait_ms = stats.gpu_wait_seconds * 1000.0 / stats.frame_count;
+		double overlap = stats.frame_seconds > 0.0 ? 1.0 - stats.gpu_wait_seconds / stats.frame_seconds : 0.0;
+		std::cout << '\t' << i << " / " << stats.frame_count << " / " << mean_frame_ms << " / " << mean_wait_ms << " / " << overlap * 100.0 << "%\n";
+	}
+}
+
+// A minimized window puts the swap chain recreation off, the caller retries it like after a resize
+RecreateSwapChainResult set_present_policy(Vulkan& vulkan, const Platform& platform, PresentPolicy present_policy, bool wait_before_acquire) {
+	vulkan.wait_before_acquire = wait_before_acquire;
+	LOG_INFO("Present mode: %s, wait before acquire: %s", get_present_policy_name(present_policy), wait_before_acquire ? "yes" : "no");
+	if (present_policy == vulkan.present_policy) {
+		return RECREATE_SWAP_CHAIN_SUCCESS;
+	}
+
+	// The present mode is baked into the swap chain
+	vulkan.present_policy = present_policy;
+	return recreate_swap_chain(vulkan, platform);
+}
+
+// CPU side frame pacing for low latency. Waits for the GPU to finish everything submitted so far before
+// the caller samples input, so the next frame is built from the freshest input instead of queueing up
+// behind frames that were built from older input. Returns true if it waited, in which case the caller
+// should handle whatever input arrived in the meantime before calling draw_frame.
+bool pace_frame(Vulkan& vulkan) {
+	if (!vulkan.wait_before_acquire || vulkan.frame_paced) {
+		return false;
+	}
+
+	std::chrono::steady_clock::time_point wait_start = std::chrono::steady_clock::now();
+	wait_for_timeline_value(vulkan.device, vulkan.timeline, vulkan.timeline.last_submitted_value);
+	vulkan.pacing_wait_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - wait_start).count();
+	vulkan.frame_paced = true;
+
+	return true;
+}
+
+// Swaps in a different model while rendering. The old buffers are left to the deletion queue and the new
+// ones are uploaded without waiting, frames submitted after the upload see the new data in queue order
+void replace_model(Vulkan& vulkan, const std::string& path) {
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<DrawItem> draw_items;
+	load_model(path, vertices, indices, draw_items);
+
+	defer_destroy_buffer(vulkan.deletion_queue, vulkan.timeline, vulkan.vertex_buffer);
+	defer_free_memory(vulkan.deletion_queue, vulkan.timeline, vulkan.vertex_buffer_memory);
+	defer_destroy_buffer(vulkan.deletion_queue, vulkan.timeline, vulkan.index_buffer);
+	defer_free_memory(vulkan.deletion_queue, vulkan.timeline, vulkan.index_buffer_memory);
+
+	vulkan.vertices = std::move(vertices);
+	vulkan.indices = std::move(indices);
+	vulkan.draw_items = std::move(draw_items);
+	clear_pipeline_statistics(vulkan.pipeline_statistics);
+	vulkan.occludee_bounds.clear();
+	for (const DrawItem& draw_item : vulkan.draw_items) {
+		vulkan.occludee_bounds.push_back(draw_item.bounds);
+	}
+
+	vulkan.vertex_buffer = create_vertex_buffer(vulkan.vertices, vulkan.device, vulkan.physical_device, vulkan.vertex_buffer_memory, vulkan.command_pool, vulkan.graphics_queue,
+		vulkan.timeline, vulkan.deletion_queue, vulkan.gpu_profiler);
+	vulkan.index_buffer = create_index_buffer(vulkan.indices, vulkan.device, vulkan.physical_device, vulkan.command_pool, vulkan.graphics_queue,
+		vulkan.timeline, vulkan.deletion_queue, vulkan.gpu_profiler, vulkan.index_buffer_memory);
+
+	// Cached buffers have the old vertex and index buffers bound
+	invalidate_command_buffer_cache(vulkan.command_buffer_cache);
+}
+
+VkInstance create_instance(bool headless) {
 	// create instance
 	uint32_t extension_count = 0;
 	vkEnumerateInstanceExtensionProperties(nullptr, &extension_count, nullptr);
 	std::vector<VkExtensionProperties> extensions(extension_count);
 	vkEnumerateInstanceExtensionProperties(nullptr, &extension_count, extensions.data());
-	std::cout << "Available Vulkan instance extensions:\n";
+	LOG_DEBUG("Available Vulkan instance extensions:");
 	for (const VkExtensionProperties& extension : extensions) {
-		std::cout << '\t' << extension.extensionName << '\n';
+		LOG_DEBUG("\t%s", extension.extensionName);
 	}
 
 	VkApplicationInfo app_info{};
@@ -56,15 +257,19 @@ VkInstance create_instance() {
 	app_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	app_info.pEngineName = "No Engine";
 	app_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	app_info.apiVersion = VK_API_VERSION_1_0;
+	app_info.apiVersion = VK_API_VERSION_1_2; // timeline semaphores
 
 	VkInstanceCreateInfo instance_create_info{};
 	instance_create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	instance_create_info.pApplicationInfo = &app_info;
 
 	std::vector<char const*> inst_extensions;
-	inst_extensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
-	inst_extensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+	if (!headless) {
+		inst_extensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+#ifdef _WIN32
+		inst_extensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+#endif
+	}
 
 	instance_create_info.enabledExtensionCount = static_cast<uint32_t>(inst_extensions.size());
 	instance_create_info.ppEnabledExtensionNames = inst_extensions.size() > 0 ? &inst_extensions[0] : nullptr;
@@ -83,7 +288,7 @@ VkInstance create_instance() {
 
 	// struct w/ creation info, custom alloc. callbacks, pointer to handle to new object
 	VkInstance instance;
-	if (vkCreateInstance(&instance_create_info, nullptr, &instance) != VK_SUCCESS) {
+	if (vkCreateInstance(&instance_create_info, get_host_allocator(HOST_ARENA_INSTANCE), &instance) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create VkInstance!");
 	}
 
@@ -112,18 +317,22 @@ void enable_validation_layers() {
 	}
 }
 
-VkSurfaceKHR create_surface(VkInstance instance, HWND hwnd, HINSTANCE hinst) {
+VkSurfaceKHR create_surface(VkInstance instance, const Platform& platform) {
+#ifdef _WIN32
 	VkWin32SurfaceCreateInfoKHR surface_create_info{};
 	surface_create_info.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
-	surface_create_info.hwnd = hwnd;
-	surface_create_info.hinstance = hinst;
+	surface_create_info.hwnd = platform.hwnd;
+	surface_create_info.hinstance = platform.hinst;
 
 	VkSurfaceKHR surface;
-	if (vkCreateWin32SurfaceKHR(instance, &surface_create_info, nullptr, &surface) != VK_SUCCESS) {
+	if (vkCreateWin32SurfaceKHR(instance, &surface_create_info, get_host_allocator(HOST_ARENA_INSTANCE), &surface) != VK_SUCCESS) {
 		throw std::runtime_error("Vulkan failed to create window surface!");
 	}
 
 	return surface;
+#else
+	throw std::runtime_error("No window surface on this platform, run with --headless!");
+#endif
 }
 
 VkPhysicalDevice create_physical_device(VkInstance instance, VkSurfaceKHR surface) {
@@ -172,14 +381,33 @@ VkDevice create_logical_device(VkPhysicalDevice physical_device, VkSurfaceKHR su
 
 	VkPhysicalDeviceFeatures device_features{};
 	device_features.samplerAnisotropy = VK_TRUE;
+	// Optional, only used with --pipeline-stats
+	VkPhysicalDeviceFeatures supported_features;
+	vkGetPhysicalDeviceFeatures(physical_device, &supported_features);
+	device_features.pipelineStatisticsQuery = supported_features.pipelineStatisticsQuery;
+
+	VkPhysicalDeviceVulkan12Features vulkan_12_features{};
+	vulkan_12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	vulkan_12_features.timelineSemaphore = VK_TRUE;
 
 	VkDeviceCreateInfo create_info{};
 	create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	create_info.pNext = &vulkan_12_features;
 	create_info.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size());
 	create_info.pQueueCreateInfos = queue_create_infos.data();
 	create_info.pEnabledFeatures = &device_features;
-	create_info.enabledExtensionCount = static_cast<uint32_t>(DEVICE_EXTENSIONS.size());
-	create_info.ppEnabledExtensionNames = DEVICE_EXTENSIONS.data();
+	// Headless has nothing to present to, so no swap chain extension. The memory budget is optional
+	std::vector<const char*> extensions;
+	if (surface != VK_NULL_HANDLE) {
+		extensions = DEVICE_EXTENSIONS;
+	}
+	bool memory_budget_supported = is_device_extension_supported(physical_device, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	if (memory_budget_supported) {
+		extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
+	set_memory_budget_enabled(memory_budget_supported);
+	create_info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	create_info.ppEnabledExtensionNames = extensions.data();
 	if (ENABLE_VALIDATION_LAYERS) {
 		create_info.enabledLayerCount = static_cast<uint32_t>(VALIDATION_LAYERS.size());
 		create_info.ppEnabledLayerNames = VALIDATION_LAYERS.data();
@@ -189,7 +417,7 @@ VkDevice create_logical_device(VkPhysicalDevice physical_device, VkSurfaceKHR su
 	}
 
 	VkDevice device;
-	if (vkCreateDevice(physical_device, &create_info, nullptr, &device) != VK_SUCCESS) {
+	if (vkCreateDevice(physical_device, &create_info, get_host_allocator(HOST_ARENA_DEVICE), &device) != VK_SUCCESS) {
 		throw std::runtime_error("Vulkan failed to create logical device!");
 	}
 
@@ -199,9 +427,9 @@ VkDevice create_logical_device(VkPhysicalDevice physical_device, VkSurfaceKHR su
 	return device;
 }
 
-VkSwapchainKHR create_swap_chain(VkPhysicalDevice physical_device, VkSurfaceKHR surface, VkDevice device, IVec2 window_size, 
-std::vector<VkImage>& out_images, VkFormat& out_format, VkExtent2D& out_extent) {
-	SwapChainSupportInfo swap_chain_support = get_swap_chain_support(physical_device, surface);
+VkSwapchainKHR create_swap_chain(VkPhysicalDevice physical_device, VkSurfaceKHR surface, VkDevice device, IVec2 window_size, PresentPolicy present_policy,
+VkSwapchainKHR old_swap_chain, SwapChainSupportInfo& swap_chain_support, std::vector<VkImage>& out_images, VkFormat& out_format, VkExtent2D& out_extent) {
+	get_swap_chain_support(physical_device, surface, swap_chain_support);
 
 	// Choose surface format
 	VkSurfaceFormatKHR surface_format;
@@ -221,17 +449,34 @@ std::vector<VkImage>& out_images, VkFormat& out_format, VkExtent2D& out_extent)
 	out_format = surface_format.format;
 
 	// Choose present mode
-	VkPresentModeKHR present_mode;
+	VkPresentModeKHR preferred_present_mode;
+	switch (present_policy) {
+	case PRESENT_POLICY_FIFO_RELAXED:
+		preferred_present_mode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+		break;
+	case PRESENT_POLICY_MAILBOX:
+		preferred_present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+		break;
+	case PRESENT_POLICY_IMMEDIATE:
+		preferred_present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+		break;
+	default:
+		preferred_present_mode = VK_PRESENT_MODE_FIFO_KHR;
+		break;
+	}
+
+	// FIFO is the only mode guaranteed to be available
+	VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;
 	bool found_preferred_present_mode = false;
 	for (const VkPresentModeKHR& available_present_mode : swap_chain_support.present_modes) {
-		if (available_present_mode == VK_PRESENT_MODE_MAILBOX_KHR) {
+		if (available_present_mode == preferred_present_mode) {
 			present_mode = available_present_mode;
 			found_preferred_present_mode = true;
 		}
 	}
 
 	if (!found_preferred_present_mode) {
-		present_mode = VK_PRESENT_MODE_FIFO_KHR;
+		LOG_WARNING("Present mode %s not supported, falling back to fifo", get_present_policy_name(present_policy));
 	}
 
 	// Set swap extent
@@ -272,7 +517,10 @@ std::vector<VkImage>& out_images, VkFormat& out_format, VkExtent2D& out_extent)
 	create_info.imageColorSpace = surface_format.colorSpace;
 	create_info.imageExtent = out_extent;
 	create_info.imageArrayLayers = 1;
-	create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	if (!(swap_chain_support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+		throw std::runtime_error("Swap chain images can't be transfer destinations!");
+	}
+	create_info.imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT; // only ever written by the upscale from the scene image
 
 	QueueFamilyIndices indices = get_queue_families(physical_device, surface);
 	uint32_t queue_family_indices[] = { indices.graphics_family.value(), indices.present_family.value() };
@@ -294,10 +542,10 @@ std::vector<VkImage>& out_images, VkFormat& out_format, VkExtent2D& out_extent)
 	create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	create_info.presentMode = present_mode;
 	create_info.clipped = VK_TRUE;
-	create_info.oldSwapchain = VK_NULL_HANDLE;
+	create_info.oldSwapchain = old_swap_chain; // lets the driver hand over resources and keep presenting during a resize
 	
 	VkSwapchainKHR swap_chain;
-	if (vkCreateSwapchainKHR(device, &create_info, nullptr, &swap_chain) != VK_SUCCESS) {
+	if (vkCreateSwapchainKHR(device, &create_info, get_host_allocator(HOST_ARENA_SWAP_CHAIN), &swap_chain) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create swap chain!");
 	}
 
@@ -308,10 +556,25 @@ std::vector<VkImage>& out_images, VkFormat& out_format, VkExtent2D& out_extent)
 	return swap_chain; // maybe construct here at end instead of peppering throughout function?
 }
 
-std::vector<VkImageView> create_swap_chain_image_views(std::vector<VkImage>& images, VkFormat format, VkDevice device) {
+void create_offscreen_images(VkDevice device, VkPhysicalDevice physical_device, IVec2 size, std::vector<VkImage>& out_images,
+std::vector<VkDeviceMemory>& out_images_memory, VkFormat& out_format, VkExtent2D& out_extent) {
+	// RGBA rather than the BGRA the swap chain prefers, so frames read back as-is
+	out_format = VK_FORMAT_R8G8B8A8_SRGB;
+	out_extent = { size.x, size.y };
+	out_images.resize(OFFSCREEN_IMAGE_COUNT);
+	out_images_memory.resize(OFFSCREEN_IMAGE_COUNT);
+
+	for (uint32_t i = 0; i < OFFSCREEN_IMAGE_COUNT; ++i) {
+		create_vulkan_image(out_extent.width, out_extent.height, device, physical_device, out_format, VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_RENDER_TARGET,
+			out_images[i], out_images_memory[i]);
+	}
+}
+
+// Fills out_image_views in place so recreating the swap chain reuses its storage
+void create_swap_chain_image_views(std::vector<VkImage>& images, VkFormat format, VkDevice device, std::vector<VkImageView>& out_image_views) {
 	// TODO: This should use create_vulkan_image_view
-	std::vector<VkImageView> image_views;
-	image_views.resize(images.size());
+	out_image_views.resize(images.size());
 	for (size_t i = 0; i < images.size(); ++i) {
 		VkImageViewCreateInfo create_info{};
 		create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -328,15 +591,13 @@ std::vector<VkImageView> create_swap_chain_image_views(std::vector<VkImage>& ima
 		create_info.subresourceRange.baseArrayLayer = 0;
 		create_info.subresourceRange.layerCount = 1;
 
-		if (vkCreateImageView(device, &create_info, nullptr, &image_views[i]) != VK_SUCCESS) {
+		if (vkCreateImageView(device, &create_info, get_host_allocator(HOST_ARENA_IMAGE), &out_image_views[i]) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create image views!");
 		}
 	}
-
-	return image_views;
 }
 
-VkRenderPass create_render_pass(VkFormat swap_chain_image_format, VkDevice device, VkPhysicalDevice physical_device) {
+VkRenderPass create_render_pass(VkFormat swap_chain_image_format, VkImageLayout final_layout, VkDevice device, VkPhysicalDevice physical_device) {
 	VkAttachmentDescription color_attachment{};
 	color_attachment.format = swap_chain_image_format;
 	color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -345,7 +606,7 @@ VkRenderPass create_render_pass(VkFormat swap_chain_image_format, VkDevice devic
 	color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	color_attachment.finalLayout = final_layout;
 
 	VkAttachmentDescription depth_attachment{};
 	depth_attachment.format = find_depth_format(physical_device);
@@ -379,7 +640,19 @@ VkRenderPass create_render_pass(VkFormat swap_chain_image_format, VkDevice devic
 	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
 	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
+	// The previous frame's upscale reads the same scene image, so it has to finish before this one clears it,
+	// and this frame's upscale has to wait for the color writes
+	dependency.srcStageMask |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+	VkSubpassDependency upscale_dependency{};
+	upscale_dependency.srcSubpass = 0;
+	upscale_dependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+	upscale_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	upscale_dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	upscale_dependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	upscale_dependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
 	std::array<VkAttachmentDescription, 2> attachments = { color_attachment, depth_attachment };
+	std::array<VkSubpassDependency, 2> dependencies = { dependency, upscale_dependency };
 
 	VkRenderPassCreateInfo render_pass_info{};
 	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -387,15 +660,14 @@ VkRenderPass create_render_pass(VkFormat swap_chain_image_format, VkDevice devic
 	render_pass_info.pAttachments = attachments.data();
 	render_pass_info.subpassCount = 1;
 	render_pass_info.pSubpasses = &subpass;
-	render_pass_info.dependencyCount = 1;
-	render_pass_info.pDependencies = &dependency;
+	render_pass_info.dependencyCount = static_cast<uint32_t>(dependencies.size());
+	render_pass_info.pDependencies = dependencies.data();
 
 	VkRenderPass render_pass;
-	if (vkCreateRenderPass(device, &render_pass_info, nullptr, &render_pass) != VK_SUCCESS) {
+	if (vkCreateRenderPass(device, &render_pass_info, get_host_allocator(HOST_ARENA_FRAMEBUFFER), &render_pass) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create render pass!");
 	}
 
-
 	return render_pass;
 }
 
@@ -424,7 +696,7 @@ VkDescriptorSetLayout create_descriptor_set_layout(VkDevice device) {
 	layout_info.pBindings = bindings.data();
 
 	VkDescriptorSetLayout descriptor_set_layout;
-	if (vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &descriptor_set_layout) != VK_SUCCESS) {
+	if (vkCreateDescriptorSetLayout(device, &layout_info, get_host_allocator(HOST_ARENA_DESCRIPTOR), &descriptor_set_layout) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create descriptor set layout!");
 	}
 
@@ -542,7 +814,7 @@ VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D swap_chain_exten
 	pipeline_layout_info.pushConstantRangeCount = 0;
 	pipeline_layout_info.pPushConstantRanges = nullptr;
 
-	if (vkCreatePipelineLayout(device, &pipeline_layout_info, nullptr, &out_layout) != VK_SUCCESS) {
+	if (vkCreatePipelineLayout(device, &pipeline_layout_info, get_host_allocator(HOST_ARENA_PIPELINE), &out_layout) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create pipeline layout!");
 	}
 
@@ -577,12 +849,12 @@ VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D swap_chain_exten
 	pipeline_info.basePipelineIndex = -1;
 
 	VkPipeline pipeline;
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &pipeline) != VK_SUCCESS) {
+	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, get_host_allocator(HOST_ARENA_PIPELINE), &pipeline) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create graphics pipeline!");
 	}
 
-	vkDestroyShaderModule(device, frag_shader_module, nullptr);
-	vkDestroyShaderModule(device, vert_shader_module, nullptr);
+	vkDestroyShaderModule(device, frag_shader_module, get_host_allocator(HOST_ARENA_PIPELINE));
+	vkDestroyShaderModule(device, vert_shader_module, get_host_allocator(HOST_ARENA_PIPELINE));
 
 	return pipeline;
 }
@@ -594,49 +866,47 @@ VkShaderModule create_shader_module(const std::vector<char>& code, VkDevice devi
 	create_info.pCode = reinterpret_cast<const uint32_t*>(code.data()); // TODO: Understand this
 
 	VkShaderModule shader_module;
-	if (vkCreateShaderModule(device, &create_info, nullptr, &shader_module) != VK_SUCCESS) {
+	if (vkCreateShaderModule(device, &create_info, get_host_allocator(HOST_ARENA_PIPELINE), &shader_module) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create shader module!");
 	}
 
 	return shader_module;
 }
 
-std::vector<VkFramebuffer> create_framebuffers(std::vector<VkImageView>& swap_chain_image_views, VkImageView depth_image_view, VkRenderPass render_pass, VkExtent2D swap_chain_extent, VkDevice device) {
-	std::vector<VkFramebuffer> swap_chain_framebuffers;
-	swap_chain_framebuffers.resize(swap_chain_image_views.size());
-	for (size_t i = 0; i < swap_chain_image_views.size(); ++i) {
-		std::array<VkImageView, 2> attachments = {
-			swap_chain_image_views[i],
-			depth_image_view
-		};
+VkFramebuffer create_scene_framebuffer(VkImageView scene_image_view, VkImageView depth_image_view, VkRenderPass render_pass, VkExtent2D swap_chain_extent, VkDevice device) {
+	std::array<VkImageView, 2> attachments = {
+		scene_image_view,
+		depth_image_view
+	};
 
-		VkFramebufferCreateInfo framebuffer_info{};
-		framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		framebuffer_info.renderPass = render_pass;
-		framebuffer_info.attachmentCount = static_cast<uint32_t>(attachments.size());
-		framebuffer_info.pAttachments = attachments.data();
-		framebuffer_info.width = swap_chain_extent.width;
-		framebuffer_info.height = swap_chain_extent.height;
-		framebuffer_info.layers = 1;
-
-		if (vkCreateFramebuffer(device, &framebuffer_info, nullptr, &swap_chain_framebuffers[i]) != VK_SUCCESS) {
-			throw std::runtime_error("Faled to create framebuffer");
-		}
+	// Swap chain sized even when the images are larger, the render area picks the part actually drawn
+	VkFramebufferCreateInfo framebuffer_info{};
+	framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebuffer_info.renderPass = render_pass;
+	framebuffer_info.attachmentCount = static_cast<uint32_t>(attachments.size());
+	framebuffer_info.pAttachments = attachments.data();
+	framebuffer_info.width = swap_chain_extent.width;
+	framebuffer_info.height = swap_chain_extent.height;
+	framebuffer_info.layers = 1;
+
+	VkFramebuffer framebuffer;
+	if (vkCreateFramebuffer(device, &framebuffer_info, get_host_allocator(HOST_ARENA_FRAMEBUFFER), &framebuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Faled to create framebuffer");
 	}
 
-	return swap_chain_framebuffers;
+	return framebuffer;
 }
 
-VkCommandPool create_command_pool(VkPhysicalDevice physical_device, VkSurfaceKHR surface, VkDevice device) {
+VkCommandPool create_command_pool(VkPhysicalDevice physical_device, VkSurfaceKHR surface, VkDevice device, VkCommandPoolCreateFlags flags) {
 	QueueFamilyIndices queue_family_indices = get_queue_families(physical_device, surface);
 
 	VkCommandPoolCreateInfo pool_info{};
 	pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	pool_info.flags = flags;
 	pool_info.queueFamilyIndex = queue_family_indices.graphics_family.value();
 
 	VkCommandPool command_pool;
-	if (vkCreateCommandPool(device, &pool_info, nullptr, &command_pool) != VK_SUCCESS) {
+	if (vkCreateCommandPool(device, &pool_info, get_host_allocator(HOST_ARENA_COMMAND), &command_pool) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create command pool!");
 	}
 
@@ -644,13 +914,13 @@ VkCommandPool create_command_pool(VkPhysicalDevice physical_device, VkSurfaceKHR
 }
 
 VkBuffer create_vertex_buffer(std::vector<Vertex>& vertices, VkDevice device, VkPhysicalDevice physical_device,
-VkDeviceMemory& out_buffer_memory, VkCommandPool command_pool, VkQueue graphics_queue) {
+VkDeviceMemory& out_buffer_memory, VkCommandPool command_pool, VkQueue graphics_queue, Timeline& timeline, DeletionQueue& deletion_queue, GpuProfiler& profiler) {
 	VkDeviceSize buffer_size = sizeof(vertices[0]) * vertices.size();
 
 	VkBuffer staging_buffer;
 	VkDeviceMemory staging_buffer_memory;
 	staging_buffer = create_vulkan_buffer(device, physical_device, buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		staging_buffer_memory);
+		MEMORY_CATEGORY_STAGING, staging_buffer_memory);
 
 	void* data;
 	vkMapMemory(device, staging_buffer_memory, 0, buffer_size, 0, &data);
@@ -658,23 +928,26 @@ VkDeviceMemory& out_buffer_memory, VkCommandPool command_pool, VkQueue graphics_
 	vkUnmapMemory(device, staging_buffer_memory);
 
 	VkBuffer vertex_buffer = create_vulkan_buffer(device, physical_device, buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, out_buffer_memory);
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_VERTEX, out_buffer_memory);
+
+	copy_vulkan_buffer(staging_buffer, vertex_buffer, buffer_size, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		device, command_pool, graphics_queue, timeline, deletion_queue, profiler);
 
-	copy_vulkan_buffer(staging_buffer, vertex_buffer, buffer_size, device, command_pool, graphics_queue);
-	vkDestroyBuffer(device, staging_buffer, nullptr);
-	vkFreeMemory(device, staging_buffer_memory, nullptr);
+	// The copy hasn't necessarily run yet
+	defer_destroy_buffer(deletion_queue, timeline, staging_buffer);
+	defer_free_memory(deletion_queue, timeline, staging_buffer_memory);
 
 	return vertex_buffer;
 }
 
 VkBuffer create_index_buffer(std::vector<uint32_t>& indices, VkDevice device, VkPhysicalDevice physical_device, VkCommandPool command_pool, 
-VkQueue graphics_queue, VkDeviceMemory& out_buffer_memory) {
+VkQueue graphics_queue, Timeline& timeline, DeletionQueue& deletion_queue, GpuProfiler& profiler, VkDeviceMemory& out_buffer_memory) {
 	VkDeviceSize buffer_size = sizeof(indices[0]) * indices.size();
 
 	VkBuffer staging_buffer;
 	VkDeviceMemory staging_buffer_memory;
 	staging_buffer = create_vulkan_buffer(device, physical_device, buffer_size, 
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer_memory);
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_CATEGORY_STAGING, staging_buffer_memory);
 
 	void* data;
 	vkMapMemory(device, staging_buffer_memory, 0, buffer_size, 0, &data);
@@ -682,32 +955,35 @@ VkQueue graphics_queue, VkDeviceMemory& out_buffer_memory) {
 	vkUnmapMemory(device, staging_buffer_memory);
 
 	VkBuffer index_buffer = create_vulkan_buffer(device, physical_device, buffer_size, 
-		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, out_buffer_memory);
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_INDEX, out_buffer_memory);
 
-	copy_vulkan_buffer(staging_buffer, index_buffer, buffer_size, device, command_pool, graphics_queue);
+	copy_vulkan_buffer(staging_buffer, index_buffer, buffer_size, VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+		device, command_pool, graphics_queue, timeline, deletion_queue, profiler);
 
-	vkDestroyBuffer(device, staging_buffer, nullptr);
-	vkFreeMemory(device, staging_buffer_memory, nullptr);
+	// The copy hasn't necessarily run yet
+	defer_destroy_buffer(deletion_queue, timeline, staging_buffer);
+	defer_free_memory(deletion_queue, timeline, staging_buffer_memory);
 
 	return index_buffer;
 }
 
-void create_uniform_buffers(VkDevice device, VkPhysicalDevice physical_device, std::vector<VkBuffer>& out_uniform_buffers, std::vector<VkDeviceMemory>& out_uniform_buffers_memory, 
-std::vector<void*>& out_uniform_buffers_mapped) {
+void create_uniform_buffers(VkDevice device, VkPhysicalDevice physical_device, uint32_t frame_count, std::vector<VkBuffer>& out_uniform_buffers, 
+std::vector<VkDeviceMemory>& out_uniform_buffers_memory, std::vector<void*>& out_uniform_buffers_mapped) {
 	VkDeviceSize buffer_size = sizeof(UniformBufferObject);
 
-	out_uniform_buffers.resize(MAX_FRAMES_IN_FLIGHT);
-	out_uniform_buffers_memory.resize(MAX_FRAMES_IN_FLIGHT);
-	out_uniform_buffers_mapped.resize(MAX_FRAMES_IN_FLIGHT);
+	out_uniform_buffers.resize(frame_count);
+	out_uniform_buffers_memory.resize(frame_count);
+	out_uniform_buffers_mapped.resize(frame_count);
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+	for (size_t i = 0; i < frame_count; ++i) {
 		out_uniform_buffers[i] = create_vulkan_buffer(device, physical_device, buffer_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			out_uniform_buffers_memory[i]);
+			MEMORY_CATEGORY_UNIFORM, out_uniform_buffers_memory[i]);
 		vkMapMemory(device, out_uniform_buffers_memory[i], 0, buffer_size, 0, &out_uniform_buffers_mapped[i]);
 	}
 }
 
 VkDescriptorPool create_descriptor_pool(VkDevice device) {
+	// Sized for the most frames in flight we allow, so changing the count only needs a pool reset
 	// 0 UBO for descriptor layout, 1 for combined image sampler layout 
 	std::array<VkDescriptorPoolSize, 2> pool_sizes{};
 	pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
@@ -722,7 +998,7 @@ VkDescriptorPool create_descriptor_pool(VkDevice device) {
 	pool_info.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
 
 	VkDescriptorPool descriptor_pool;
-	if (vkCreateDescriptorPool(device, &pool_info, nullptr, &descriptor_pool) != VK_SUCCESS) {
+	if (vkCreateDescriptorPool(device, &pool_info, get_host_allocator(HOST_ARENA_DESCRIPTOR), &descriptor_pool) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create descriptor pool!");
 	}
 
@@ -730,22 +1006,22 @@ VkDescriptorPool create_descriptor_pool(VkDevice device) {
 }
 
 std::vector<VkDescriptorSet> create_descriptor_sets(VkDescriptorSetLayout descriptor_set_layout, VkDescriptorPool descriptor_pool, 
-VkDevice device, std::vector<VkBuffer>& uniform_buffers, VkImageView texture_image_view, VkSampler texture_sampler) {
-	std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptor_set_layout);
+VkDevice device, std::vector<VkBuffer>& uniform_buffers, VkImageView texture_image_view, VkSampler texture_sampler, uint32_t frame_count) {
+	std::vector<VkDescriptorSetLayout> layouts(frame_count, descriptor_set_layout);
 
 	VkDescriptorSetAllocateInfo alloc_info{};
 	alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
 	alloc_info.descriptorPool = descriptor_pool;
-	alloc_info.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	alloc_info.descriptorSetCount = frame_count;
 	alloc_info.pSetLayouts = layouts.data();
 
 	std::vector<VkDescriptorSet> descriptor_sets;
-	descriptor_sets.resize(MAX_FRAMES_IN_FLIGHT);
+	descriptor_sets.resize(frame_count);
 	if (vkAllocateDescriptorSets(device, &alloc_info, descriptor_sets.data()) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to allocate descriptor sets!");
 	}
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+	for (size_t i = 0; i < frame_count; ++i) {
 		VkDescriptorBufferInfo buffer_info{};
 		buffer_info.buffer = uniform_buffers[i];
 		buffer_info.offset = 0;
@@ -779,67 +1055,139 @@ VkDevice device, std::vector<VkBuffer>& uniform_buffers, VkImageView texture_ima
 	return descriptor_sets;
 }
 
-std::vector<VkCommandBuffer> create_command_buffers(VkCommandPool command_pool, VkDevice device) {
-	std::vector<VkCommandBuffer> command_buffers;
-	command_buffers.resize(MAX_FRAMES_IN_FLIGHT);
+CommandBufferCache create_command_buffer_cache(VkPhysicalDevice physical_device, VkSurfaceKHR surface, VkDevice device, size_t image_count) {
+	CommandBufferCache cache;
+	// Cached buffers get re-recorded individually, so this pool does need per-buffer reset
+	cache.pool = create_command_pool(physical_device, surface, device, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	resize_command_buffer_cache(cache, device, image_count);
 
-	VkCommandBufferAllocateInfo allocate_info{};
-	allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocate_info.commandPool = command_pool;
-	allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocate_info.commandBufferCount = (uint32_t)command_buffers.size();
+	return cache;
+}
 
-	if (vkAllocateCommandBuffers(device, &allocate_info, command_buffers.data()) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to allocate command buffers!");
-	};
+void resize_command_buffer_cache(CommandBufferCache& cache, VkDevice device, size_t image_count) {
+	// Only ever grows. Buffers for images that went away may still be executing, and the pool frees them at shutdown anyway
+	size_t required_count = image_count * MAX_FRAMES_IN_FLIGHT;
+	if (cache.buffers.size() < required_count) {
+		size_t first_new = cache.buffers.size();
+		cache.buffers.resize(required_count);
+		cache.keys.resize(required_count, 0);
+
+		VkCommandBufferAllocateInfo allocate_info{};
+		allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocate_info.commandPool = cache.pool;
+		allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocate_info.commandBufferCount = static_cast<uint32_t>(required_count - first_new);
+
+		if (vkAllocateCommandBuffers(device, &allocate_info, &cache.buffers[first_new]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate cached command buffers!");
+		}
+	}
+}
+
+void invalidate_command_buffer_cache(CommandBufferCache& cache) {
+	std::fill(cache.keys.begin(), cache.keys.end(), 0);
+	cache.last_draw_list_key = 0;
+}
+
+uint64_t hash_draw_list(const std::vector<uint32_t>& visible_draw_items) {
+	// FNV-1a, with 0 reserved for "not recorded"
+	uint64_t hash = 14695981039346656037ull;
+	for (uint32_t draw_item_index : visible_draw_items) {
+		hash = (hash ^ draw_item_index) * 1099511628211ull;
+	}
+	hash = (hash ^ visible_draw_items.size()) * 1099511628211ull;
 
-	return command_buffers;
+	return hash == 0 ? 1 : hash;
+}
+
+std::vector<FrameCommandPools> create_frame_command_pools(VkPhysicalDevice physical_device, VkSurfaceKHR surface, VkDevice device, uint32_t frame_count, uint32_t worker_count) {
+	std::vector<FrameCommandPools> frame_command_pools(frame_count);
+
+	for (FrameCommandPools& frame_pools : frame_command_pools) {
+		// No RESET_COMMAND_BUFFER_BIT, the whole pool is reset at once each frame
+		frame_pools.primary_pool = create_command_pool(physical_device, surface, device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+
+		VkCommandBufferAllocateInfo allocate_info{};
+		allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocate_info.commandPool = frame_pools.primary_pool;
+		allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocate_info.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(device, &allocate_info, &frame_pools.primary_buffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate command buffers!");
+		}
+
+		frame_pools.worker_pools.resize(worker_count);
+		frame_pools.worker_buffers.resize(worker_count);
+		for (uint32_t i = 0; i < worker_count; ++i) {
+			frame_pools.worker_pools[i] = create_command_pool(physical_device, surface, device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+
+			allocate_info.commandPool = frame_pools.worker_pools[i];
+			allocate_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			if (vkAllocateCommandBuffers(device, &allocate_info, &frame_pools.worker_buffers[i]) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to allocate secondary command buffers!");
+			}
+		}
+	}
+
+	return frame_command_pools;
 }
 
 void create_depth_resources(VkDevice device, VkPhysicalDevice physical_device, VkExtent2D swap_chain_extent, 
 VkImage& out_depth_image, VkDeviceMemory& out_depth_image_memory, VkImageView& out_depth_image_view) {
 	VkFormat depth_format = find_depth_format(physical_device);
-	create_vulkan_image(swap_chain_extent.width, swap_chain_extent.height, device, physical_device, depth_format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, out_depth_image, out_depth_image_memory);
+	create_vulkan_image(swap_chain_extent.width, swap_chain_extent.height, device, physical_device, depth_format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		MEMORY_CATEGORY_DEPTH, out_depth_image, out_depth_image_memory);
 	out_depth_image_view = create_vulkan_image_view(out_depth_image, depth_format, VK_IMAGE_ASPECT_DEPTH_BIT, device);
 }
 
-void create_texture_image(VkDevice device, VkPhysicalDevice physical_device, VkImage& out_image, 
-VkDeviceMemory& out_image_memory, VkCommandPool command_pool, VkQueue graphics_queue) {
-	int tex_width;
-	int tex_height;
-	int tex_channels;
-	stbi_uc* pixels = stbi_load(TEXTURE_PATH.c_str(), &tex_width, &tex_height, &tex_channels, STBI_rgb_alpha);
+// Same format as the swap chain, so the upscale never has to convert
+void create_scene_resources(VkDevice device, VkPhysicalDevice physical_device, VkExtent2D swap_chain_extent, VkFormat format,
+VkImage& out_scene_image, VkDeviceMemory& out_scene_image_memory, VkImageView& out_scene_image_view) {
+	create_vulkan_image(swap_chain_extent.width, swap_chain_extent.height, device, physical_device, format, VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_RENDER_TARGET,
+		out_scene_image, out_scene_image_memory);
+	out_scene_image_view = create_vulkan_image_view(out_scene_image, format, VK_IMAGE_ASPECT_COLOR_BIT, device);
+}
+
+bool is_filtered_blit_supported(VkPhysicalDevice physical_device, VkFormat format) {
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+	VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+	return (properties.optimalTilingFeatures & required) == required;
+}
+
+void create_texture_image(VkDevice device, VkPhysicalDevice physical_device, const TexturePixels& texture, VkImage& out_image, 
+VkDeviceMemory& out_image_memory, VkCommandPool command_pool, VkQueue graphics_queue, Timeline& timeline, GpuProfiler& profiler) {
+	PROFILE_ZONE("create_texture_image");
+	int tex_width = texture.width;
+	int tex_height = texture.height;
 	VkDeviceSize image_size = tex_width * tex_height * 4;
-	
-	if(!pixels) {
-		throw std::runtime_error("Failed to load texture image!");
-	}
 
 	VkBuffer staging_buffer;
 	VkDeviceMemory staging_buffer_memory;
 	staging_buffer = create_vulkan_buffer(device, physical_device, image_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer_memory);
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MEMORY_CATEGORY_STAGING, staging_buffer_memory);
 
 	void* data;
 	vkMapMemory(device, staging_buffer_memory, 0, image_size, 0, &data);
-	memcpy(data, pixels, static_cast<size_t>(image_size));
+	memcpy(data, texture.pixels, static_cast<size_t>(image_size));
 	vkUnmapMemory(device, staging_buffer_memory);
 
-	stbi_image_free(pixels);
-
 	create_vulkan_image(tex_width, tex_height, device, physical_device, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
 		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, out_image, out_image_memory);
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MEMORY_CATEGORY_TEXTURE, out_image, out_image_memory);
 
 	transition_image_layout(out_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, 
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, command_pool, device, graphics_queue);
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, command_pool, device, graphics_queue, timeline);
 	copy_buffer_to_image(staging_buffer, out_image, static_cast<uint32_t>(tex_width), static_cast<uint32_t>(tex_height),
-		command_pool, device, graphics_queue);
+		command_pool, device, graphics_queue, timeline, profiler);
 	transition_image_layout(out_image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, command_pool, device, graphics_queue);
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, command_pool, device, graphics_queue, timeline);
 
-	vkDestroyBuffer(device, staging_buffer, nullptr);
-	vkFreeMemory(device, staging_buffer_memory, nullptr);
+	vkDestroyBuffer(device, staging_buffer, get_host_allocator(HOST_ARENA_BUFFER));
+	free_device_memory(device, staging_buffer_memory);
 }
 
 // TODO: refactor image view creation also found increate_swap_chain_image_views into create_image_view function
@@ -869,38 +1217,81 @@ VkSampler create_texture_sampler(VkDevice device, VkPhysicalDevice physical_devi
 	sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 
 	VkSampler texture_sampler;
-	if(vkCreateSampler(device, &sampler_info, nullptr, &texture_sampler) != VK_SUCCESS) {
+	if(vkCreateSampler(device, &sampler_info, get_host_allocator(HOST_ARENA_IMAGE), &texture_sampler) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create texture sampler!");
 	}
 
 	return texture_sampler;
 }
 	
-void create_sync_objects(VkDevice device, std::vector<VkSemaphore>& image_available_semaphores, std::vector<VkSemaphore>& render_finished_semaphores, std::vector<VkFence>& in_flight_fences) {
-	image_available_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	render_finished_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	in_flight_fences.resize(MAX_FRAMES_IN_FLIGHT);
+void create_sync_objects(VkDevice device, uint32_t frame_count, std::vector<VkSemaphore>& image_available_semaphores, std::vector<VkSemaphore>& render_finished_semaphores) {
+	// Binary semaphores are still needed for acquire and present, which can't use timeline semaphores.
+	// CPU-GPU synchronisation is done with the timeline instead of per frame fences
+	image_available_semaphores.resize(frame_count);
+	render_finished_semaphores.resize(frame_count);
 	
 	VkSemaphoreCreateInfo semaphore_info{};
 	semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-	
-	VkFenceCreateInfo fence_info{};
-	fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT; // To start in already signaled state
-
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-		if (vkCreateSemaphore(device, &semaphore_info, nullptr, &image_available_semaphores[i]) != VK_SUCCESS ||
-		vkCreateSemaphore(device, &semaphore_info, nullptr, &render_finished_semaphores[i]) != VK_SUCCESS ||
-		vkCreateFence(device, &fence_info, nullptr, &in_flight_fences[i]) != VK_SUCCESS) {
+
+	for (size_t i = 0; i < frame_count; ++i) {
+		if (vkCreateSemaphore(device, &semaphore_info, get_host_allocator(HOST_ARENA_SYNC), &image_available_semaphores[i]) != VK_SUCCESS ||
+		vkCreateSemaphore(device, &semaphore_info, get_host_allocator(HOST_ARENA_SYNC), &render_finished_semaphores[i]) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to create semaphores!");
 		}
 	}
 }
 
-void record_command_buffer(VkCommandBuffer command_buffer, uint32_t image_index, VkRenderPass render_pass,
-std::vector<VkFramebuffer>& swap_chain_framebuffers, VkExtent2D swap_chain_extent, VkPipeline graphics_pipeline,
+void record_command_buffer(FrameCommandPools& frame_pools, const FrameTarget& target, VkRenderPass render_pass, VkPipeline graphics_pipeline,
 VkBuffer vertex_buffer, VkBuffer index_buffer, VkPipelineLayout pipeline_layout, std::vector<VkDescriptorSet>& descriptor_sets, 
-std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t current_frame) {
+std::vector<DrawItem>& draw_items, std::vector<uint32_t>& visible_draw_items, uint32_t current_frame, const FrameQueries& queries, JobSystem& jobs) {
+	VkCommandBuffer command_buffer = frame_pools.primary_buffer;
+
+	VkCommandBufferBeginInfo begin_info{};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	begin_info.pInheritanceInfo = nullptr;
+
+	if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to begin recording command buffer!");
+	}
+
+	// All drawing happens in secondary buffers so the draw list can be split across jobs. Each chunk records into
+	// its own worker pool, so it doesn't matter which thread ends up running it
+	cmd_reset_pipeline_statistics(command_buffer, queries.statistics_pool, queries.first_statistics_query);
+	cmd_begin_gpu_zone(command_buffer, queries.timestamp_pool, queries.timestamp_query);
+	begin_main_render_pass(command_buffer, render_pass, target.framebuffer, target.render_extent, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+	uint32_t draw_count = static_cast<uint32_t>(visible_draw_items.size());
+	uint32_t worker_count = static_cast<uint32_t>(frame_pools.worker_buffers.size());
+	uint32_t chunk_count = std::clamp((draw_count + MIN_DRAWS_PER_RECORDING_THREAD - 1) / MIN_DRAWS_PER_RECORDING_THREAD, 1u, worker_count);
+	uint32_t draws_per_chunk = (draw_count + chunk_count - 1) / chunk_count;
+
+	parallel_for(jobs, chunk_count, 1, [&](uint32_t first_chunk, uint32_t last_chunk) {
+		for (uint32_t chunk = first_chunk; chunk < last_chunk; ++chunk) {
+			PROFILE_ZONE("record draws");
+			uint32_t first = std::min(chunk * draws_per_chunk, draw_count);
+			uint32_t last = std::min(first + draws_per_chunk, draw_count);
+			record_secondary_command_buffer(frame_pools.worker_buffers[chunk], render_pass, target.framebuffer, target.render_extent,
+				graphics_pipeline, vertex_buffer, index_buffer, pipeline_layout, descriptor_sets[current_frame], draw_items,
+				visible_draw_items.data() + first, visible_draw_items.data() + last, queries);
+		}
+	});
+
+	vkCmdExecuteCommands(command_buffer, chunk_count, frame_pools.worker_buffers.data());
+	vkCmdEndRenderPass(command_buffer);
+	cmd_end_gpu_zone(command_buffer, queries.timestamp_pool, queries.timestamp_query);
+	record_upscale(command_buffer, target);
+
+	if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+		throw std::runtime_error("Faled to record command buffer!");
+	}
+}
+
+void record_cached_command_buffer(VkCommandBuffer command_buffer, VkRenderPass render_pass, const FrameTarget& target,
+VkPipeline graphics_pipeline, VkBuffer vertex_buffer, VkBuffer index_buffer, VkPipelineLayout pipeline_layout, VkDescriptorSet descriptor_set,
+std::vector<DrawItem>& draw_items, std::vector<uint32_t>& visible_draw_items, const FrameQueries& queries) {
+	// Recorded inline on one thread. Worth it since it's replayed for many frames, and secondary buffers
+	// from the per-frame pools wouldn't survive the pool reset anyway
 	VkCommandBufferBeginInfo begin_info{};
 	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 	begin_info.flags = 0;
@@ -910,6 +1301,22 @@ std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t current_
 		throw std::runtime_error("Failed to begin recording command buffer!");
 	}
 
+	cmd_reset_pipeline_statistics(command_buffer, queries.statistics_pool, queries.first_statistics_query);
+	cmd_begin_gpu_zone(command_buffer, queries.timestamp_pool, queries.timestamp_query);
+	begin_main_render_pass(command_buffer, render_pass, target.framebuffer, target.render_extent, VK_SUBPASS_CONTENTS_INLINE);
+	record_draw_commands(command_buffer, target.render_extent, graphics_pipeline, vertex_buffer, index_buffer, pipeline_layout, descriptor_set,
+		draw_items, visible_draw_items.data(), visible_draw_items.data() + visible_draw_items.size(), queries);
+	vkCmdEndRenderPass(command_buffer);
+	cmd_end_gpu_zone(command_buffer, queries.timestamp_pool, queries.timestamp_query);
+	record_upscale(command_buffer, target);
+
+	if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+		throw std::runtime_error("Faled to record command buffer!");
+	}
+}
+
+void begin_main_render_pass(VkCommandBuffer command_buffer, VkRenderPass render_pass, VkFramebuffer framebuffer, VkExtent2D render_extent,
+VkSubpassContents contents) {
 	std::array<VkClearValue, 2> clear_values{};
 	clear_values[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
 	clear_values[1].depthStencil = { 1.0, 0 };
@@ -917,13 +1324,100 @@ std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t current_
 	VkRenderPassBeginInfo render_pass_info{};
 	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 	render_pass_info.renderPass = render_pass;
-	render_pass_info.framebuffer = swap_chain_framebuffers[image_index]; // the correct image on the swapchain determined by image_index
+	render_pass_info.framebuffer = framebuffer;
 	render_pass_info.renderArea.offset = { 0, 0 };
-	render_pass_info.renderArea.extent = swap_chain_extent;
+	render_pass_info.renderArea.extent = render_extent;
 	render_pass_info.clearValueCount = static_cast<uint32_t>(clear_values.size());
 	render_pass_info.pClearValues = clear_values.data();
 
-	vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+	vkCmdBeginRenderPass(command_buffer, &render_pass_info, contents);
+}
+
+// Copies the drawn part of the scene image over the whole target image, filtered when it has to be stretched.
+// Comes after the render pass zone, since the target is only written once the submit's wait for the
+// acquired image is over, and the wait shouldn't count towards the GPU time dynamic resolution goes by
+void record_upscale(VkCommandBuffer command_buffer, const FrameTarget& target) {
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = target.image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	// Transfer is the stage the submit waits for the acquired image at, so this chains onto that wait
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkImageSubresourceLayers subresource{};
+	subresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	subresource.mipLevel = 0;
+	subresource.baseArrayLayer = 0;
+	subresource.layerCount = 1;
+
+	bool stretched = target.render_extent.width != target.extent.width || target.render_extent.height != target.extent.height;
+	if (stretched) {
+		VkImageBlit blit{};
+		blit.srcSubresource = subresource;
+		blit.srcOffsets[1] = { static_cast<int32_t>(target.render_extent.width), static_cast<int32_t>(target.render_extent.height), 1 };
+		blit.dstSubresource = subresource;
+		blit.dstOffsets[1] = { static_cast<int32_t>(target.extent.width), static_cast<int32_t>(target.extent.height), 1 };
+		vkCmdBlitImage(command_buffer, target.scene_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &blit, VK_FILTER_LINEAR);
+	}
+	else {
+		VkImageCopy copy{};
+		copy.srcSubresource = subresource;
+		copy.dstSubresource = subresource;
+		copy.extent = { target.extent.width, target.extent.height, 1 };
+		vkCmdCopyImage(command_buffer, target.scene_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &copy);
+	}
+
+	// Only the layout changes here. Present waits on the submit's semaphore, and the headless readback orders
+	// its copy with a barrier of its own
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = target.final_layout;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = 0;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void record_secondary_command_buffer(VkCommandBuffer command_buffer, VkRenderPass render_pass, VkFramebuffer framebuffer, VkExtent2D render_extent,
+VkPipeline graphics_pipeline, VkBuffer vertex_buffer, VkBuffer index_buffer, VkPipelineLayout pipeline_layout, VkDescriptorSet descriptor_set,
+std::vector<DrawItem>& draw_items, const uint32_t* first_draw, const uint32_t* last_draw, const FrameQueries& queries) {
+	VkCommandBufferInheritanceInfo inheritance_info{};
+	inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritance_info.renderPass = render_pass;
+	inheritance_info.subpass = 0;
+	inheritance_info.framebuffer = framebuffer;
+
+	VkCommandBufferBeginInfo begin_info{};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	begin_info.pInheritanceInfo = &inheritance_info;
+
+	if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to begin recording secondary command buffer!");
+	}
+
+	record_draw_commands(command_buffer, render_extent, graphics_pipeline, vertex_buffer, index_buffer, pipeline_layout, descriptor_set,
+		draw_items, first_draw, last_draw, queries);
+
+	if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to record secondary command buffer!");
+	}
+}
+
+void record_draw_commands(VkCommandBuffer command_buffer, VkExtent2D render_extent, VkPipeline graphics_pipeline, VkBuffer vertex_buffer,
+VkBuffer index_buffer, VkPipelineLayout pipeline_layout, VkDescriptorSet descriptor_set, std::vector<DrawItem>& draw_items,
+const uint32_t* first_draw, const uint32_t* last_draw, const FrameQueries& queries) {
+	// Secondary buffers inherit none of this from the primary, so every chunk binds its own state
 	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline);
 
 	VkBuffer vertex_buffers[] = { vertex_buffer };
@@ -934,73 +1428,158 @@ std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t current_
 	VkViewport viewport{};
 	viewport.x = 0.0f;
 	viewport.y = 0.0f;
-	viewport.width = static_cast<float>(swap_chain_extent.width);
-	viewport.height = static_cast<float>(swap_chain_extent.height);
+	viewport.width = static_cast<float>(render_extent.width);
+	viewport.height = static_cast<float>(render_extent.height);
 	viewport.minDepth = 0.0f;
 	viewport.maxDepth = 1.0f;
 	vkCmdSetViewport(command_buffer, 0, 1, &viewport);
 
 	VkRect2D scissor{};
 	scissor.offset = { 0,0 };
-	scissor.extent = swap_chain_extent;
+	scissor.extent = render_extent;
 	vkCmdSetScissor(command_buffer, 0, 1, &scissor);
 
 	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, 
-		&descriptor_sets[current_frame], 0, nullptr);
-	vkCmdDrawIndexed(command_buffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
-
-	vkCmdEndRenderPass(command_buffer);
-
-	if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
-		throw std::runtime_error("Faled to record command buffer!");
+		&descriptor_set, 0, nullptr);
+	for (const uint32_t* draw = first_draw; draw != last_draw; ++draw) {
+		const DrawItem& draw_item = draw_items[*draw];
+		bool measured = queries.statistics_pool != VK_NULL_HANDLE && *draw < MAX_PIPELINE_STATISTICS_DRAWS;
+		if (measured) {
+			vkCmdBeginQuery(command_buffer, queries.statistics_pool, queries.first_statistics_query + *draw, 0);
+		}
+		vkCmdDrawIndexed(command_buffer, draw_item.index_count, 1, draw_item.first_index, 0, 0);
+		if (measured) {
+			vkCmdEndQuery(command_buffer, queries.statistics_pool, queries.first_statistics_query + *draw);
+		}
 	}
 }
 
-DrawFrameResult draw_frame(Vulkan& vulkan, HWND hwnd, double cam_position) {
-	vkWaitForFences(vulkan.device, 1, &vulkan.in_flight_fences[vulkan.current_frame], VK_TRUE, UINT64_MAX);
+DrawFrameResult draw_frame(Vulkan& vulkan, const SceneSnapshot& scene) {
+	PROFILE_ZONE("draw_frame");
+	std::chrono::steady_clock::time_point frame_start = std::chrono::steady_clock::now();
+	uint64_t heap_allocations_at_start = get_heap_allocation_count();
+	// Wait until the GPU is done with the last submission that used this frame slot's resources
+	wait_for_timeline_value(vulkan.device, vulkan.timeline, vulkan.frame_timeline_values[vulkan.current_frame]);
+	std::chrono::steady_clock::time_point frame_slot_free = std::chrono::steady_clock::now();
+	reset_frame_arena(vulkan.frame_arenas[vulkan.current_frame]);
+	read_pipeline_statistics(vulkan.pipeline_statistics, vulkan.device, vulkan.current_frame, static_cast<uint32_t>(vulkan.draw_items.size()));
+	if (!vulkan.deletion_queue.pending.empty() || !vulkan.gpu_profiler.pending_zones.empty()) {
+		uint64_t completed_value = get_completed_timeline_value(vulkan.device, vulkan.timeline);
+		process_deletion_queue(vulkan.deletion_queue, vulkan.device, completed_value);
+		// Includes this slot's previous render pass zone, which has to be read before it is rewritten
+		collect_gpu_zones(vulkan.gpu_profiler, vulkan.device, completed_value);
+	}
+	bool scale_changed = false;
+	for (double gpu_seconds : vulkan.gpu_profiler.frame_gpu_seconds) {
+		scale_changed |= update_dynamic_resolution(vulkan.dynamic_resolution, gpu_seconds);
+	}
+	vulkan.gpu_profiler.frame_gpu_seconds.clear();
+	if (scale_changed) {
+		update_render_extent(vulkan);
+	}
+	record_dynamic_resolution_frame(vulkan.dynamic_resolution);
+
+	// Each phase runs from the end of the previous one
+	FrameTimings& timings = vulkan.last_frame_timings;
+	timings = FrameTimings{};
+	std::chrono::steady_clock::time_point phase_start = frame_start;
+	auto end_phase = [&timings, &phase_start, heap_allocations_at_start](FramePhase phase) {
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		timings.phase_seconds[phase] = std::chrono::duration<double>(now - phase_start).count();
+		timings.total_seconds += timings.phase_seconds[phase];
+		timings.heap_allocations = get_heap_allocation_count() - heap_allocations_at_start;
+		phase_start = now;
+	};
+	end_phase(FRAME_PHASE_WAIT);
+
+	// Frame time is start to start, so it includes whatever the caller did between frames
+	if (vulkan.last_frame_start.time_since_epoch().count() != 0) {
+		FramePacingStats& stats = vulkan.frame_pacing_stats[vulkan.frames_in_flight];
+		stats.frame_count++;
+		stats.frame_seconds += std::chrono::duration<double>(frame_start - vulkan.last_frame_start).count();
+		stats.gpu_wait_seconds += std::chrono::duration<double>(frame_slot_free - frame_start).count() + vulkan.pacing_wait_seconds;
+	}
+	vulkan.last_frame_start = frame_start;
+	vulkan.pacing_wait_seconds = 0.0;
+	vulkan.frame_paced = false;
 
 	uint32_t image_index;
-	VkResult acquire_image_result = vkAcquireNextImageKHR(vulkan.device, vulkan.swap_chain, UINT64_MAX, vulkan.image_available_semaphores[vulkan.current_frame], VK_NULL_HANDLE, &image_index);
-	if (acquire_image_result == VK_ERROR_OUT_OF_DATE_KHR) {
-		return DRAW_FRAME_RECREATION_REQUESTED;
+	if (vulkan.headless) {
+		// Offscreen images are only used in submission order, so there is nothing to wait for
+		image_index = vulkan.next_offscreen_image;
+		vulkan.next_offscreen_image = (vulkan.next_offscreen_image + 1) % OFFSCREEN_IMAGE_COUNT;
 	}
-	else if (acquire_image_result != VK_SUCCESS && acquire_image_result != VK_SUBOPTIMAL_KHR) {
-		throw std::runtime_error("Failed to acquire swap chain image!");
+	else {
+		VkResult acquire_image_result = vkAcquireNextImageKHR(vulkan.device, vulkan.swap_chain, UINT64_MAX, vulkan.image_available_semaphores[vulkan.current_frame], VK_NULL_HANDLE, &image_index);
+		if (acquire_image_result == VK_ERROR_OUT_OF_DATE_KHR) {
+			return DRAW_FRAME_RECREATION_REQUESTED;
+		}
+		else if (acquire_image_result != VK_SUCCESS && acquire_image_result != VK_SUBOPTIMAL_KHR) {
+			throw std::runtime_error("Failed to acquire swap chain image!");
+		}
 	}
+	vulkan.last_image_index = image_index;
+	end_phase(FRAME_PHASE_ACQUIRE);
 
-	// Only reset the fence once we know we are submitting work
-	vkResetFences(vulkan.device, 1, &vulkan.in_flight_fences[vulkan.current_frame]);
+	// Uniforms first, the culling needs the same matrices the GPU will use. This is where input becomes visible
+	std::chrono::steady_clock::time_point input_sampled = std::chrono::steady_clock::now();
+	UniformBufferObject ubo = update_uniform_buffer(vulkan.current_frame, vulkan.swap_chain_extent, vulkan.uniform_buffers_mapped, scene,
+		vulkan.transforms, vulkan.model_node, input_sampled);
+	end_phase(FRAME_PHASE_UPDATE);
+	cull_draw_items(vulkan, ubo);
+	end_phase(FRAME_PHASE_CULL);
 
-	vkResetCommandBuffer(vulkan.command_buffers[vulkan.current_frame], 0);
-	record_command_buffer(vulkan.command_buffers[vulkan.current_frame], image_index, vulkan.render_pass, vulkan.swap_chain_framebuffers,
-		vulkan.swap_chain_extent, vulkan.graphics_pipeline, vulkan.vertex_buffer, vulkan.index_buffer, vulkan.pipeline_layout, vulkan.descriptor_sets, 
-		vulkan.vertices, vulkan.indices, vulkan.current_frame);
-
-	update_uniform_buffer(vulkan.current_frame, vulkan.swap_chain_extent, vulkan.uniform_buffers_mapped, cam_position);
+	VkCommandBuffer command_buffer = get_frame_command_buffer(vulkan, image_index);
+	end_phase(FRAME_PHASE_RECORD);
 
 	VkSubmitInfo submit_info{};
 	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
 	VkSemaphore wait_semaphores[] = { vulkan.image_available_semaphores[vulkan.current_frame]};
-	VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submit_info.waitSemaphoreCount = 1;
+	// The acquired image is first touched by the upscale, so the scene can be drawn before it is available
+	VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_TRANSFER_BIT };
+	submit_info.waitSemaphoreCount = vulkan.headless ? 0 : 1;
 	submit_info.pWaitSemaphores = wait_semaphores;
 	submit_info.pWaitDstStageMask = wait_stages;
 	submit_info.commandBufferCount = 1;
-	submit_info.pCommandBuffers = &vulkan.command_buffers[vulkan.current_frame];
+	submit_info.pCommandBuffers = &command_buffer;
 
-	VkSemaphore signal_semaphores[] = { vulkan.render_finished_semaphores[vulkan.current_frame]};
-	submit_info.signalSemaphoreCount = 1;
+	// The binary semaphore is for present, the timeline value marks this frame slot as in use until it is reached.
+	// Headless doesn't present, so only signals the timeline
+	uint64_t frame_value = next_timeline_value(vulkan.timeline);
+	VkSemaphore signal_semaphores[] = { vulkan.timeline.semaphore, vulkan.render_finished_semaphores[vulkan.current_frame] };
+	uint64_t signal_values[] = { frame_value, 0 }; // binary semaphores ignore their value
+	uint32_t signal_count = vulkan.headless ? 1 : 2;
+	submit_info.signalSemaphoreCount = signal_count;
 	submit_info.pSignalSemaphores = signal_semaphores;
 
-	if (vkQueueSubmit(vulkan.graphics_queue, 1, &submit_info, vulkan.in_flight_fences[vulkan.current_frame]) != VK_SUCCESS) {
+	VkTimelineSemaphoreSubmitInfo timeline_info{};
+	timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timeline_info.signalSemaphoreValueCount = signal_count;
+	timeline_info.pSignalSemaphoreValues = signal_values;
+	submit_info.pNext = &timeline_info;
+
+	if (vkQueueSubmit(vulkan.graphics_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to submit draw command buffer!");
 	}
+	vulkan.frame_timeline_values[vulkan.current_frame] = frame_value;
+	add_gpu_zone(vulkan.gpu_profiler, "render pass", get_frame_zone_query(vulkan.gpu_profiler, vulkan.current_frame), frame_value);
+	if (vulkan.pipeline_statistics.query_pool != VK_NULL_HANDLE) {
+		vulkan.pipeline_statistics.pending[vulkan.current_frame] = true;
+	}
+	std::chrono::steady_clock::time_point submitted = std::chrono::steady_clock::now();
+	end_phase(FRAME_PHASE_SUBMIT);
+
+	if (vulkan.headless) {
+		vulkan.current_frame = (vulkan.current_frame + 1) % vulkan.frames_in_flight;
+		add_frame_phase_zones(vulkan.gpu_profiler, frame_start, timings);
+		return DRAW_FRAME_SUCCESS;
+	}
 
 	VkPresentInfoKHR present_info{};
 	present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	present_info.waitSemaphoreCount = 1;
-	present_info.pWaitSemaphores = signal_semaphores;
+	present_info.pWaitSemaphores = &vulkan.render_finished_semaphores[vulkan.current_frame];
 
 	VkSwapchainKHR swap_chains[] = { vulkan.swap_chain };
 	present_info.swapchainCount = 1;
@@ -1008,8 +1587,12 @@ DrawFrameResult draw_frame(Vulkan& vulkan, HWND hwnd, double cam_position) {
 	present_info.pImageIndices = &image_index;
 	present_info.pResults = nullptr;
 
-	vulkan.current_frame = (vulkan.current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+	vulkan.current_frame = (vulkan.current_frame + 1) % vulkan.frames_in_flight;
 	VkResult present_queue_result = vkQueuePresentKHR(vulkan.present_queue, &present_info);
+	end_phase(FRAME_PHASE_PRESENT);
+	add_frame_phase_zones(vulkan.gpu_profiler, frame_start, timings);
+	record_frame_latency(vulkan.latency, get_latency_policy_index(vulkan.present_policy, vulkan.wait_before_acquire),
+		input_sampled, submitted, std::chrono::steady_clock::now());
 	if (present_queue_result == VK_ERROR_OUT_OF_DATE_KHR || present_queue_result == VK_SUBOPTIMAL_KHR || vulkan.framebuffer_resized) {
 		return DRAW_FRAME_RECREATION_REQUESTED;
 	} 
@@ -1020,35 +1603,142 @@ DrawFrameResult draw_frame(Vulkan& vulkan, HWND hwnd, double cam_position) {
 	return DRAW_FRAME_SUCCESS;
 }
 
-void update_uniform_buffer(uint32_t current_image, VkExtent2D swap_chain_extent, std::vector<void*>& uniform_buffers_mapped, double cam_position) {
-	static std::chrono::steady_clock::time_point start_time = std::chrono::high_resolution_clock::now();
+VkCommandBuffer get_frame_command_buffer(Vulkan& vulkan, uint32_t image_index) {
+	CommandBufferCache& cache = vulkan.command_buffer_cache;
+	uint64_t draw_list_key = hash_draw_list(vulkan.visible_draw_items);
+	bool draw_list_unchanged = draw_list_key == cache.last_draw_list_key;
+	cache.last_draw_list_key = draw_list_key;
+
+	// Same draws as last frame, so assume the scene has settled and replay (or record once) the cached buffer.
+	// Nothing else that goes into it can change without invalidate_command_buffer_cache being called
+	if (draw_list_unchanged) {
+		size_t slot = image_index * MAX_FRAMES_IN_FLIGHT + vulkan.current_frame;
+		if (cache.keys[slot] != draw_list_key) {
+			// Last submitted from this same frame slot, so the timeline value waited on in draw_frame covers it
+			vkResetCommandBuffer(cache.buffers[slot], 0);
+			record_cached_command_buffer(cache.buffers[slot], vulkan.render_pass, get_frame_target(vulkan, image_index),
+				vulkan.graphics_pipeline, vulkan.vertex_buffer, vulkan.index_buffer, vulkan.pipeline_layout, vulkan.descriptor_sets[vulkan.current_frame],
+				vulkan.draw_items, vulkan.visible_draw_items, get_frame_queries(vulkan));
+			cache.keys[slot] = draw_list_key;
+		}
+
+		return cache.buffers[slot];
+	}
+
+	// Everything recorded from this frame's pools was retired by the timeline value waited on in draw_frame
+	FrameCommandPools& frame_pools = vulkan.frame_command_pools[vulkan.current_frame];
+	vkResetCommandPool(vulkan.device, frame_pools.primary_pool, 0);
+	for (VkCommandPool worker_pool : frame_pools.worker_pools) {
+		vkResetCommandPool(vulkan.device, worker_pool, 0);
+	}
+	record_command_buffer(frame_pools, get_frame_target(vulkan, image_index), vulkan.render_pass,
+		vulkan.graphics_pipeline, vulkan.vertex_buffer, vulkan.index_buffer, vulkan.pipeline_layout, vulkan.descriptor_sets, 
+		vulkan.draw_items, vulkan.visible_draw_items, vulkan.current_frame, get_frame_queries(vulkan), *vulkan.jobs);
+
+	return frame_pools.primary_buffer;
+}
+
+FrameTarget get_frame_target(const Vulkan& vulkan, uint32_t image_index) {
+	FrameTarget target{};
+	target.framebuffer = vulkan.scene_framebuffer;
+	target.scene_image = vulkan.scene_image;
+	target.render_extent = vulkan.render_extent;
+	target.image = vulkan.swap_chain_images[image_index];
+	target.extent = vulkan.swap_chain_extent;
+	// Offscreen images end up as a copy source rather than being presented
+	target.final_layout = vulkan.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	return target;
+}
+
+// From the current dynamic resolution scale. Cached buffers have the render extent baked in
+void update_render_extent(Vulkan& vulkan) {
+	IVec2 render_size = get_render_size(vulkan.dynamic_resolution, IVec2{ vulkan.swap_chain_extent.width, vulkan.swap_chain_extent.height });
+	vulkan.render_extent = { render_size.x, render_size.y };
+	invalidate_command_buffer_cache(vulkan.command_buffer_cache);
+}
+
+FrameQueries get_frame_queries(const Vulkan& vulkan) {
+	FrameQueries queries{};
+	queries.timestamp_pool = vulkan.gpu_profiler.query_pool;
+	queries.timestamp_query = get_frame_zone_query(vulkan.gpu_profiler, vulkan.current_frame);
+	queries.statistics_pool = vulkan.pipeline_statistics.query_pool;
+	queries.first_statistics_query = get_first_statistics_query(vulkan.pipeline_statistics, vulkan.current_frame);
 
-	std::chrono::steady_clock::time_point current_time = std::chrono::high_resolution_clock::now();
-	float time = std::chrono::duration<float, std::chrono::seconds::period>(current_time - start_time).count();
+	return queries;
+}
+
+// The scene as of now, between the two newest simulation steps
+UniformBufferObject update_uniform_buffer(uint32_t current_image, VkExtent2D swap_chain_extent, std::vector<void*>& uniform_buffers_mapped, const SceneSnapshot& scene,
+TransformHierarchy& transforms, uint32_t model_node, std::chrono::steady_clock::time_point now) {
+	SceneState state = interpolate_scene(scene, now);
+	set_local_rotation(transforms, model_node, get_model_rotation(static_cast<float>(state.time)));
+	update_world_matrices(transforms);
 
-	UniformBufferObject ubo{};
-	ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.view = glm::lookAt(glm::vec3(cam_position, cam_position, cam_position), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.proj = glm::perspective(glm::radians(45.0f), swap_chain_extent.width / (float)swap_chain_extent.height, 0.1f, 10.0f);
-	ubo.proj[1][1] *= -1;
+	UniformBufferObject ubo = build_uniform_buffer_object(get_world_matrix(transforms, model_node), swap_chain_extent.width / (float)swap_chain_extent.height,
+		state.cam_position);
 	memcpy(uniform_buffers_mapped[current_image], &ubo, sizeof(ubo));
+
+	return ubo;
+}
+
+void cull_draw_items(Vulkan& vulkan, const UniformBufferObject& ubo) {
+	PROFILE_ZONE("cull_draw_items");
+	// Occluders and draw items both live in model space
+	glm::mat4 model_view_projection = ubo.proj * ubo.view * ubo.model;
+
+	if (!vulkan.occluders.empty()) {
+		rasterize_occluders(vulkan.occlusion_buffer, vulkan.occluders, model_view_projection, *vulkan.jobs, vulkan.frame_arenas[vulkan.current_frame]);
+	}
+
+	cull_occludees(vulkan.occlusion_buffer, vulkan.occludee_bounds, model_view_projection, vulkan.visible_draw_items);
 }
 
-RecreateSwapChainResult recreate_swap_chain(Vulkan& vulkan, HWND hwnd) {
-	IVec2 window_size = get_window_size(hwnd);
+RecreateSwapChainResult recreate_swap_chain(Vulkan& vulkan, const Platform& platform) {
+	// Offscreen images never go out of date
+	if (vulkan.headless) {
+		return RECREATE_SWAP_CHAIN_SUCCESS;
+	}
+
+	IVec2 window_size = get_platform_size(platform);
 	if (window_size.x == 0 || window_size.y == 0) {
 		return RECREATE_SWAP_CHAIN_WINDOW_MINIMIZED;
 	}
 	
-	vkDeviceWaitIdle(vulkan.device);
-
-	cleanup_swap_chain(vulkan.device, vulkan.swap_chain_framebuffers, vulkan.swap_chain_image_views, vulkan.swap_chain,
-		vulkan.depth_image_view, vulkan.depth_image, vulkan.depth_image_memory);
-	vulkan.swap_chain = create_swap_chain(vulkan.physical_device, vulkan.surface, vulkan.device, window_size, 
-		vulkan.swap_chain_images, vulkan.swap_chain_format, vulkan.swap_chain_extent);
-	vulkan.swap_chain_image_views = create_swap_chain_image_views(vulkan.swap_chain_images, vulkan.swap_chain_format, vulkan.device);
-	create_depth_resources(vulkan.device, vulkan.physical_device, vulkan.swap_chain_extent, vulkan.depth_image, vulkan.depth_image_memory, vulkan.depth_image_view);
-	vulkan.swap_chain_framebuffers = create_framebuffers(vulkan.swap_chain_image_views, vulkan.depth_image_view, vulkan.render_pass, vulkan.swap_chain_extent, vulkan.device);
+	// Frames still in flight keep using the old swap chain, image views and framebuffer, so they are retired
+	// to the deletion queue rather than destroyed, and nothing here waits for the GPU.
+	// Strictly, presentation of the old images isn't covered by the timeline, but the old swap chain is
+	// retired by passing it as oldSwapchain and its last frame has finished rendering when it is destroyed
+	VkSwapchainKHR old_swap_chain = vulkan.swap_chain;
+	vulkan.swap_chain = create_swap_chain(vulkan.physical_device, vulkan.surface, vulkan.device, window_size, vulkan.present_policy,
+		old_swap_chain, vulkan.swap_chain_support, vulkan.swap_chain_images, vulkan.swap_chain_format, vulkan.swap_chain_extent);
+	defer_destroy_swap_chain(vulkan.deletion_queue, vulkan.timeline, old_swap_chain);
+	defer_destroy_framebuffer(vulkan.deletion_queue, vulkan.timeline, vulkan.scene_framebuffer);
+	for (VkImageView image_view : vulkan.swap_chain_image_views) {
+		defer_destroy_image_view(vulkan.deletion_queue, vulkan.timeline, image_view);
+	}
+	create_swap_chain_image_views(vulkan.swap_chain_images, vulkan.swap_chain_format, vulkan.device, vulkan.swap_chain_image_views);
+
+	// Framebuffers may be smaller than their attachments, so the depth and scene images only need replacing when they grow
+	bool render_targets_fit = vulkan.swap_chain_extent.width <= vulkan.render_target_extent.width &&
+		vulkan.swap_chain_extent.height <= vulkan.render_target_extent.height;
+	if (!render_targets_fit) {
+		defer_destroy_image_view(vulkan.deletion_queue, vulkan.timeline, vulkan.depth_image_view);
+		defer_destroy_image(vulkan.deletion_queue, vulkan.timeline, vulkan.depth_image);
+		defer_free_memory(vulkan.deletion_queue, vulkan.timeline, vulkan.depth_image_memory);
+		defer_destroy_image_view(vulkan.deletion_queue, vulkan.timeline, vulkan.scene_image_view);
+		defer_destroy_image(vulkan.deletion_queue, vulkan.timeline, vulkan.scene_image);
+		defer_free_memory(vulkan.deletion_queue, vulkan.timeline, vulkan.scene_image_memory);
+		create_depth_resources(vulkan.device, vulkan.physical_device, vulkan.swap_chain_extent, vulkan.depth_image, vulkan.depth_image_memory, vulkan.depth_image_view);
+		create_scene_resources(vulkan.device, vulkan.physical_device, vulkan.swap_chain_extent, vulkan.swap_chain_format, vulkan.scene_image, vulkan.scene_image_memory,
+			vulkan.scene_image_view);
+		vulkan.render_target_extent = vulkan.swap_chain_extent;
+	}
+	vulkan.scene_framebuffer = create_scene_framebuffer(vulkan.scene_image_view, vulkan.depth_image_view, vulkan.render_pass, vulkan.swap_chain_extent, vulkan.device);
+
+	// Cached buffers reference the old images and extents
+	resize_command_buffer_cache(vulkan.command_buffer_cache, vulkan.device, vulkan.swap_chain_images.size());
+	update_render_extent(vulkan);
 
 	return RECREATE_SWAP_CHAIN_SUCCESS;
 }
@@ -1068,8 +1758,14 @@ QueueFamilyIndices get_queue_families(const VkPhysicalDevice physical_device, Vk
 			indices.graphics_family = i;
 		}
 
+		// Without a surface (headless) there is no presenting, so the graphics queue stands in
 		VkBool32 present_support = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, i, surface, &present_support);
+		if (surface == VK_NULL_HANDLE) {
+			present_support = (queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+		}
+		else {
+			vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, i, surface, &present_support);
+		}
 
 		if (present_support) {
 			indices.present_family = i;
@@ -1090,26 +1786,38 @@ bool queue_families_validated(QueueFamilyIndices indices) {
 		&& indices.present_family.has_value();
 }
 
-SwapChainSupportInfo get_swap_chain_support(VkPhysicalDevice device, VkSurfaceKHR surface) {
-	SwapChainSupportInfo info;
-
-	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &info.capabilities);
+// Fills out_info in place, so the one kept in Vulkan doesn't allocate again when the swap chain is recreated
+void get_swap_chain_support(VkPhysicalDevice device, VkSurfaceKHR surface, SwapChainSupportInfo& out_info) {
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &out_info.capabilities);
 
 	uint32_t format_count;
 	vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &format_count, nullptr);
+	out_info.formats.resize(format_count);
 	if (format_count != 0) {
-		info.formats.resize(format_count);
-		vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &format_count, info.formats.data());
+		vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &format_count, out_info.formats.data());
 	}
 
 	uint32_t present_mode_count;
 	vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &present_mode_count, nullptr);
+	out_info.present_modes.resize(present_mode_count);
 	if (present_mode_count != 0) {
-		info.present_modes.resize(present_mode_count);
-		vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &present_mode_count, info.present_modes.data());
+		vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &present_mode_count, out_info.present_modes.data());
 	}
+}
 
-	return info;
+bool is_device_extension_supported(VkPhysicalDevice device, const char* extension_name) {
+	uint32_t extension_count;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
+	std::vector<VkExtensionProperties> available_extensions(extension_count);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, available_extensions.data());
+
+	for (const VkExtensionProperties& extension : available_extensions) {
+		if (strcmp(extension.extensionName, extension_name) == 0) {
+			return true;
+		}
+	}
+
+	return false;
 }
 
 int rate_device_suitability(VkPhysicalDevice device, VkSurfaceKHR surface) {
@@ -1127,7 +1835,21 @@ int rate_device_suitability(VkPhysicalDevice device, VkSurfaceKHR surface) {
 	VkPhysicalDeviceFeatures device_features;
 	vkGetPhysicalDeviceFeatures(device, &device_features);
 
-	if (!device_features.geometryShader) {
+	// Geometry shaders aren't used, and requiring them rules out SwiftShader
+
+	// Check timeline semaphore support (Vulkan 1.2)
+	if (device_properties.apiVersion < VK_API_VERSION_1_2) {
+		return 0;
+	}
+
+	VkPhysicalDeviceVulkan12Features vulkan_12_features{};
+	vulkan_12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	VkPhysicalDeviceFeatures2 device_features_2{};
+	device_features_2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	device_features_2.pNext = &vulkan_12_features;
+	vkGetPhysicalDeviceFeatures2(device, &device_features_2);
+
+	if (!vulkan_12_features.timelineSemaphore) {
 		return 0;
 	}
 
@@ -1138,23 +1860,21 @@ int rate_device_suitability(VkPhysicalDevice device, VkSurfaceKHR surface) {
 		return 0;
 	}
 
-	// Check for required extensions
-	uint32_t extension_count;
-	vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
-	std::vector<VkExtensionProperties> available_extensions(extension_count);
-	vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, available_extensions.data());
-	std::set<std::string> required_extensions(DEVICE_EXTENSIONS.begin(), DEVICE_EXTENSIONS.end());
-
-	for (const VkExtensionProperties& extension : available_extensions) {
-		required_extensions.erase(extension.extensionName);
+	// Headless doesn't need the swap chain extension or support
+	if (surface == VK_NULL_HANDLE) {
+		return device_features.samplerAnisotropy ? score : 0;
 	}
 
-	if (!required_extensions.empty()) {
-		return 0;
+	// Check for required extensions
+	for (const char* extension : DEVICE_EXTENSIONS) {
+		if (!is_device_extension_supported(device, extension)) {
+			return 0;
+		}
 	}
 
 	// Check swap chain support
-	SwapChainSupportInfo swap_chain_support = get_swap_chain_support(device, surface);
+	SwapChainSupportInfo swap_chain_support;
+	get_swap_chain_support(device, surface, swap_chain_support);
 
 	bool swap_chain_adequate = !swap_chain_support.formats.empty() && !swap_chain_support.present_modes.empty();
 	if (!swap_chain_adequate) {
@@ -1241,7 +1961,8 @@ uint32_t get_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties,
 	throw std::runtime_error("Failed to find suitable memory type");
 }
 
-VkBuffer create_vulkan_buffer(VkDevice device, VkPhysicalDevice physical_device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkDeviceMemory& out_buffer_memory) {
+VkBuffer create_vulkan_buffer(VkDevice device, VkPhysicalDevice physical_device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+MemoryCategory category, VkDeviceMemory& out_buffer_memory) {
 	VkBufferCreateInfo buffer_info{};
 	buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	buffer_info.size = size;
@@ -1249,7 +1970,7 @@ VkBuffer create_vulkan_buffer(VkDevice device, VkPhysicalDevice physical_device,
 	buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
 	VkBuffer buffer;
-	if (vkCreateBuffer(device, &buffer_info, nullptr, &buffer) != VK_SUCCESS) {
+	if (vkCreateBuffer(device, &buffer_info, get_host_allocator(HOST_ARENA_BUFFER), &buffer) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create buffer!");
 	}
 
@@ -1266,9 +1987,10 @@ VkBuffer create_vulkan_buffer(VkDevice device, VkPhysicalDevice physical_device,
 	// Eventually, you'll want to create a custom allocator that splits this allocation among many different
 	// objects by using offset parameters.
 	// VulkanMemoryAllocator repo is intended to make this easier, though I would probably want to do it myself
-	if (vkAllocateMemory(device, &allocate_info, nullptr, &out_buffer_memory) != VK_SUCCESS) {
+	if (vkAllocateMemory(device, &allocate_info, get_host_allocator(HOST_ARENA_MEMORY), &out_buffer_memory) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to allocate buffer memory!");
 	}
+	track_device_memory(out_buffer_memory, category, allocate_info.allocationSize, allocate_info.memoryTypeIndex);
 
 	vkBindBufferMemory(device, buffer, out_buffer_memory, 0);
 
@@ -1276,7 +1998,7 @@ VkBuffer create_vulkan_buffer(VkDevice device, VkPhysicalDevice physical_device,
 }
 
 void create_vulkan_image(uint32_t width, uint32_t height, VkDevice device, VkPhysicalDevice physical_device, VkFormat format, VkImageTiling tiling, 
-VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& out_image, VkDeviceMemory& out_image_memory) {
+VkImageUsageFlags usage, VkMemoryPropertyFlags properties, MemoryCategory category, VkImage& out_image, VkDeviceMemory& out_image_memory) {
 	VkImageCreateInfo image_info{};
 	image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 	image_info.imageType = VK_IMAGE_TYPE_2D;
@@ -1293,7 +2015,7 @@ VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& out_image, V
 	image_info.samples = VK_SAMPLE_COUNT_1_BIT;
 	image_info.flags = 0;
 
-	if (vkCreateImage(device, &image_info, nullptr, &out_image) != VK_SUCCESS) {
+	if (vkCreateImage(device, &image_info, get_host_allocator(HOST_ARENA_IMAGE), &out_image) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create image!");
 	}
 
@@ -1305,9 +2027,10 @@ VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& out_image, V
 	alloc_info.allocationSize = mem_requirements.size;
 	alloc_info.memoryTypeIndex = get_memory_type(mem_requirements.memoryTypeBits, properties, physical_device);
 
-	if (vkAllocateMemory(device, &alloc_info, nullptr, &out_image_memory) != VK_SUCCESS) {
+	if (vkAllocateMemory(device, &alloc_info, get_host_allocator(HOST_ARENA_MEMORY), &out_image_memory) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to allocate image memory!");
 	}
+	track_device_memory(out_image_memory, category, alloc_info.allocationSize, alloc_info.memoryTypeIndex);
 
 	vkBindImageMemory(device, out_image, out_image_memory, 0);
 }
@@ -1325,7 +2048,7 @@ VkImageView create_vulkan_image_view(VkImage image, VkFormat format, VkImageAspe
 	view_info.subresourceRange.layerCount = 1;
 
 	VkImageView image_view;
-	if(vkCreateImageView(device, &view_info, nullptr, &image_view) != VK_SUCCESS) {
+	if(vkCreateImageView(device, &view_info, get_host_allocator(HOST_ARENA_IMAGE), &image_view) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create texture image view!");
 	}
 
@@ -1333,7 +2056,7 @@ VkImageView create_vulkan_image_view(VkImage image, VkFormat format, VkImageAspe
 }
 
 void transition_image_layout(VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout,
-VkCommandPool command_pool, VkDevice device, VkQueue graphics_queue) {
+VkCommandPool command_pool, VkDevice device, VkQueue graphics_queue, Timeline& timeline) {
 	VkCommandBuffer command_buffer = begin_single_time_commands(command_pool, device);
 
 	VkImageMemoryBarrier barrier{};
@@ -1379,12 +2102,14 @@ VkCommandPool command_pool, VkDevice device, VkQueue graphics_queue) {
 		1, &barrier
 	);
 
-	end_single_time_commands(command_buffer, graphics_queue, device, command_pool);
+	end_single_time_commands(command_buffer, graphics_queue, timeline, device, command_pool);
 } 
 
 void copy_buffer_to_image(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height,
-VkCommandPool command_pool, VkDevice device, VkQueue graphics_queue) {
+VkCommandPool command_pool, VkDevice device, VkQueue graphics_queue, Timeline& timeline, GpuProfiler& profiler) {
 	VkCommandBuffer command_buffer = begin_single_time_commands(command_pool, device);
+	uint32_t timestamp_query = allocate_upload_zone(profiler);
+	cmd_begin_gpu_zone(command_buffer, profiler.query_pool, timestamp_query);
 
 	VkBufferImageCopy region{};
 	region.bufferOffset = 0;
@@ -1405,18 +2130,39 @@ VkCommandPool command_pool, VkDevice device, VkQueue graphics_queue) {
 		1,
 		&region
 	);
+	cmd_end_gpu_zone(command_buffer, profiler.query_pool, timestamp_query);
 
-	end_single_time_commands(command_buffer, graphics_queue, device, command_pool);
+	end_single_time_commands(command_buffer, graphics_queue, timeline, device, command_pool);
+	add_gpu_zone(profiler, "texture upload", timestamp_query, timeline.last_submitted_value);
 }
 
-void copy_vulkan_buffer(VkBuffer src, VkBuffer dst, VkDeviceSize size, VkDevice device, VkCommandPool command_pool, VkQueue graphics_queue) {
+// Doesn't wait for the copy. The barrier makes the result visible to dst_stage in later submissions on the
+// same queue, and the command buffer is freed through the deletion queue once the copy has run
+void copy_vulkan_buffer(VkBuffer src, VkBuffer dst, VkDeviceSize size, VkAccessFlags dst_access, VkPipelineStageFlags dst_stage, VkDevice device,
+VkCommandPool command_pool, VkQueue graphics_queue, Timeline& timeline, DeletionQueue& deletion_queue, GpuProfiler& profiler) {
 	VkCommandBuffer command_buffer = begin_single_time_commands(command_pool, device);
+	uint32_t timestamp_query = allocate_upload_zone(profiler);
+	cmd_begin_gpu_zone(command_buffer, profiler.query_pool, timestamp_query);
 
 	VkBufferCopy copy_region{};
 	copy_region.size = size;
 	vkCmdCopyBuffer(command_buffer, src, dst, 1, &copy_region);
 
-	end_single_time_commands(command_buffer, graphics_queue, device, command_pool);
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = dst_access;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = dst;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	cmd_end_gpu_zone(command_buffer, profiler.query_pool, timestamp_query);
+
+	uint64_t upload_value = submit_single_time_commands(command_buffer, graphics_queue, timeline);
+	add_gpu_zone(profiler, "buffer upload", timestamp_query, upload_value);
+	defer_free_command_buffer(deletion_queue, timeline, command_pool, command_buffer);
 }
 
 VkCommandBuffer begin_single_time_commands(VkCommandPool command_pool, VkDevice device) {
@@ -1438,106 +2184,94 @@ VkCommandBuffer begin_single_time_commands(VkCommandPool command_pool, VkDevice
 	return command_buffer;
 }
 
-void end_single_time_commands(VkCommandBuffer command_buffer, VkQueue graphics_queue, VkDevice device, VkCommandPool command_pool) {
+// Returns the timeline value that signals when the commands have run
+uint64_t submit_single_time_commands(VkCommandBuffer command_buffer, VkQueue graphics_queue, Timeline& timeline) {
 	vkEndCommandBuffer(command_buffer);
 
+	uint64_t upload_value = next_timeline_value(timeline);
+	VkTimelineSemaphoreSubmitInfo timeline_info{};
+	timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timeline_info.signalSemaphoreValueCount = 1;
+	timeline_info.pSignalSemaphoreValues = &upload_value;
+
 	VkSubmitInfo submit_info{};
 	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.pNext = &timeline_info;
 	submit_info.commandBufferCount = 1;
 	submit_info.pCommandBuffers = &command_buffer;
+	submit_info.signalSemaphoreCount = 1;
+	submit_info.pSignalSemaphores = &timeline.semaphore;
 
 	vkQueueSubmit(graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
-	vkQueueWaitIdle(graphics_queue);
-	vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
-}
-
-void load_model(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string warn;
-	std::string err;
-
-	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, MODEL_PATH.c_str())) {
-		throw std::runtime_error(warn + err);
-	}
-
-	std::unordered_map<Vertex, uint32_t> unique_vertices{};
-	for (const tinyobj::shape_t& shape : shapes) { // TODO: tutorial used auto here. idk
-		for (const tinyobj::index_t& index : shape.mesh.indices) {
-			Vertex vertex{};
-
-			vertex.position = {
-				attrib.vertices[3 * index.vertex_index + 0],
-				attrib.vertices[3 * index.vertex_index + 1],
-				attrib.vertices[3 * index.vertex_index + 2]
-			};
-
-			vertex.texture_coordinates = {
-				attrib.texcoords[2 * index.texcoord_index + 0],
-				1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-			};
 
-			vertex.color = { 1.0f, 1.0f, 1.0f };
-
-			if (unique_vertices.count(vertex) == 0) {
-				unique_vertices[vertex] = static_cast<uint32_t>(vertices.size());
-				vertices.push_back(vertex);
-			}
+	return upload_value;
+}
 
-			indices.push_back(unique_vertices[vertex]);
-		}
-	}
+void end_single_time_commands(VkCommandBuffer command_buffer, VkQueue graphics_queue, Timeline& timeline, VkDevice device, VkCommandPool command_pool) {
+	// Wait for just our own value, rather than for everything else on the queue
+	uint64_t upload_value = submit_single_time_commands(command_buffer, graphics_queue, timeline);
+	wait_for_timeline_value(device, timeline, upload_value);
+	vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
 }
 
-void cleanup_swap_chain(VkDevice device, std::vector<VkFramebuffer>& framebuffers, std::vector<VkImageView>& image_views, VkSwapchainKHR swap_chain, 
-VkImageView depth_image_view, VkImage depth_image, VkDeviceMemory depth_image_memory) {
-	vkDestroyImageView(device, depth_image_view, nullptr);
-	vkDestroyImage(device, depth_image, nullptr);
-	vkFreeMemory(device, depth_image_memory, nullptr);
+void cleanup_swap_chain(VkDevice device, VkFramebuffer scene_framebuffer, std::vector<VkImageView>& image_views, VkSwapchainKHR swap_chain, 
+VkImageView depth_image_view, VkImage depth_image, VkDeviceMemory depth_image_memory, VkImageView scene_image_view, VkImage scene_image,
+VkDeviceMemory scene_image_memory) {
+	vkDestroyImageView(device, depth_image_view, get_host_allocator(HOST_ARENA_IMAGE));
+	vkDestroyImage(device, depth_image, get_host_allocator(HOST_ARENA_IMAGE));
+	free_device_memory(device, depth_image_memory);
+	vkDestroyImageView(device, scene_image_view, get_host_allocator(HOST_ARENA_IMAGE));
+	vkDestroyImage(device, scene_image, get_host_allocator(HOST_ARENA_IMAGE));
+	free_device_memory(device, scene_image_memory);
 	
-	for (VkFramebuffer framebuffer : framebuffers) {
-		vkDestroyFramebuffer(device, framebuffer, nullptr);
-	}
+	vkDestroyFramebuffer(device, scene_framebuffer, get_host_allocator(HOST_ARENA_FRAMEBUFFER));
 
 	for (VkImageView image_view : image_views) {
-		vkDestroyImageView(device, image_view, nullptr);
+		vkDestroyImageView(device, image_view, get_host_allocator(HOST_ARENA_IMAGE));
 	}
 
-	vkDestroySwapchainKHR(device, swap_chain, nullptr);
+	vkDestroySwapchainKHR(device, swap_chain, get_host_allocator(HOST_ARENA_SWAP_CHAIN));
 }
 
 void cleanup_vulkan(Vulkan& vulkan) {
-	cleanup_swap_chain(vulkan.device, vulkan.swap_chain_framebuffers, vulkan.swap_chain_image_views, vulkan.swap_chain,
-		vulkan.depth_image_view, vulkan.depth_image, vulkan.depth_image_memory); // TODO: swap chain stuff in its own struct to reflect the recreation dependency?
-
-	vkDestroyBuffer(vulkan.device, vulkan.vertex_buffer, nullptr);
-	vkFreeMemory(vulkan.device, vulkan.vertex_buffer_memory, nullptr);
-
-	vkDestroyBuffer(vulkan.device, vulkan.index_buffer, nullptr);
-	vkFreeMemory(vulkan.device, vulkan.index_buffer_memory, nullptr);
-
-	vkDestroyPipeline(vulkan.device, vulkan.graphics_pipeline, nullptr);
-	vkDestroyPipelineLayout(vulkan.device, vulkan.pipeline_layout, nullptr);
-	vkDestroyRenderPass(vulkan.device, vulkan.render_pass, nullptr);
-
-	vkDestroySampler(vulkan.device, vulkan.texture_sampler, nullptr);
-	vkDestroyImageView(vulkan.device, vulkan.texture_image_view, nullptr);
-	vkDestroyImage(vulkan.device, vulkan.texture_image, nullptr);
-	vkFreeMemory(vulkan.device, vulkan.texture_image_memory, nullptr);
-
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-		vkDestroyBuffer(vulkan.device, vulkan.uniform_buffers[i], nullptr);
-		vkFreeMemory(vulkan.device, vulkan.uniform_buffers_memory[i], nullptr);
-		vkDestroySemaphore(vulkan.device, vulkan.image_available_semaphores[i], nullptr);
-		vkDestroySemaphore(vulkan.device, vulkan.render_finished_semaphores[i], nullptr);
-		vkDestroyFence(vulkan.device, vulkan.in_flight_fences[i], nullptr);
-	}
-	vkDestroyDescriptorPool(vulkan.device, vulkan.descriptor_pool, nullptr);
-	vkDestroyDescriptorSetLayout(vulkan.device, vulkan.descriptor_set_layout, nullptr);
-
-	vkDestroyCommandPool(vulkan.device, vulkan.command_pool, nullptr);
-	vkDestroyDevice(vulkan.device, nullptr);
-	vkDestroySurfaceKHR(vulkan.instance, vulkan.surface, nullptr);
-	vkDestroyInstance(vulkan.instance, nullptr);
+	destroy_gpu_profiler(vulkan.gpu_profiler, vulkan.device);
+	destroy_pipeline_statistics(vulkan.pipeline_statistics, vulkan.device);
+	flush_deletion_queue(vulkan.deletion_queue, vulkan.device);
+	cleanup_swap_chain(vulkan.device, vulkan.scene_framebuffer, vulkan.swap_chain_image_views, vulkan.swap_chain,
+		vulkan.depth_image_view, vulkan.depth_image, vulkan.depth_image_memory, vulkan.scene_image_view, vulkan.scene_image,
+		vulkan.scene_image_memory); // TODO: swap chain stuff in its own struct to reflect the recreation dependency?
+
+	// Unlike swap chain images, offscreen images belong to us
+	for (size_t i = 0; i < vulkan.offscreen_images_memory.size(); ++i) {
+		vkDestroyImage(vulkan.device, vulkan.swap_chain_images[i], get_host_allocator(HOST_ARENA_IMAGE));
+		free_device_memory(vulkan.device, vulkan.offscreen_images_memory[i]);
+	}
+
+	vkDestroyBuffer(vulkan.device, vulkan.vertex_buffer, get_host_allocator(HOST_ARENA_BUFFER));
+	free_device_memory(vulkan.device, vulkan.vertex_buffer_memory);
+
+	vkDestroyBuffer(vulkan.device, vulkan.index_buffer, get_host_allocator(HOST_ARENA_BUFFER));
+	free_device_memory(vulkan.device, vulkan.index_buffer_memory);
+
+	vkDestroyPipeline(vulkan.device, vulkan.graphics_pipeline, get_host_allocator(HOST_ARENA_PIPELINE));
+	vkDestroyPipelineLayout(vulkan.device, vulkan.pipeline_layout, get_host_allocator(HOST_ARENA_PIPELINE));
+	vkDestroyRenderPass(vulkan.device, vulkan.render_pass, get_host_allocator(HOST_ARENA_FRAMEBUFFER));
+
+	vkDestroySampler(vulkan.device, vulkan.texture_sampler, get_host_allocator(HOST_ARENA_IMAGE));
+	vkDestroyImageView(vulkan.device, vulkan.texture_image_view, get_host_allocator(HOST_ARENA_IMAGE));
+	vkDestroyImage(vulkan.device, vulkan.texture_image, get_host_allocator(HOST_ARENA_IMAGE));
+	free_device_memory(vulkan.device, vulkan.texture_image_memory);
+
+	destroy_frame_resources(vulkan);
+	vkDestroyDescriptorPool(vulkan.device, vulkan.descriptor_pool, get_host_allocator(HOST_ARENA_DESCRIPTOR));
+	vkDestroyDescriptorSetLayout(vulkan.device, vulkan.descriptor_set_layout, get_host_allocator(HOST_ARENA_DESCRIPTOR));
+
+	vkDestroyCommandPool(vulkan.device, vulkan.command_buffer_cache.pool, get_host_allocator(HOST_ARENA_COMMAND));
+	vkDestroyCommandPool(vulkan.device, vulkan.command_pool, get_host_allocator(HOST_ARENA_COMMAND));
+	destroy_timeline(vulkan.device, vulkan.timeline);
+	report_memory_leaks();
+	vkDestroyDevice(vulkan.device, get_host_allocator(HOST_ARENA_DEVICE));
+	vkDestroySurfaceKHR(vulkan.instance, vulkan.surface, get_host_allocator(HOST_ARENA_INSTANCE));
+	vkDestroyInstance(vulkan.instance, get_host_allocator(HOST_ARENA_INSTANCE));
+	stop_job_system(*vulkan.jobs);
 } 
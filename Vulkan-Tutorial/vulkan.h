@@ -7,8 +7,10 @@
 // asynchronously. ("Images" vulkan tutorial)
 
 #pragma once
+#ifdef _WIN32
 #define VK_USE_PLATFORM_WIN32_KHR
 #define NOMINMAX
+#endif
 
 #include <iostream>
 #include <stdexcept>
@@ -24,6 +26,8 @@
 #include <array>
 #include <chrono>
 #include <unordered_map>
+#include <thread>
+#include <memory>
 
 #include <vulkan/vulkan.h>
 #define GLM_FORCE_RADIANS
@@ -35,7 +39,29 @@
 
 #include "window_size.h"
 #include "file_helpers.h"
-#include "win32.h"
+#include "platform.h"
+#include "occlusion.h"
+#include "model.h"
+#include "texture.h"
+#include "camera.h"
+#include "simulation.h"
+#include "settings.h"
+#include "timeline.h"
+#include "latency.h"
+#include "deletion_queue.h"
+#include "frame_arena.h"
+#include "allocation_counter.h"
+#include "benchmark.h"
+#include "gpu_profiler.h"
+#include "host_allocator.h"
+#include "memory_tracker.h"
+#include "pipeline_stats.h"
+#include "profile.h"
+#include "log.h"
+#include "task_graph.h"
+#include "job_system.h"
+#include "dynamic_resolution.h"
+#include "transform_hierarchy.h"
 
 #ifdef NDEBUG
 const bool ENABLE_VALIDATION_LAYERS = false;
@@ -51,35 +77,59 @@ const std::vector<const char*> DEVICE_EXTENSIONS = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
-const int MAX_FRAMES_IN_FLIGHT = 2;
+const uint32_t OFFSCREEN_IMAGE_COUNT = 3; // stands in for the swap chain images when headless
+const int MAX_FRAMES_IN_FLIGHT = 4; // upper bound, the count actually used is Vulkan::frames_in_flight
+const uint32_t MAX_RECORDING_THREADS = 8;
+const uint32_t MIN_DRAWS_PER_RECORDING_THREAD = 64; // below this a thread costs more than it saves
 const std::string MODEL_PATH = "models/viking_room.obj";
 const std::string TEXTURE_PATH = "textures/viking_room.png";
+const std::string OCCLUDER_PATH = "models/viking_room_occluders.obj"; // simplified walls of the model, for occlusion culling
+
+// Command pools for one frame in flight. The main thread records the primary buffer and each recording job
+// records a secondary buffer from its own pool, so no pool is ever touched by two threads. The pools are
+// reset as a whole once the frame's timeline value has been reached instead of resetting buffers one by one.
+struct FrameCommandPools {
+	VkCommandPool primary_pool;
+	VkCommandBuffer primary_buffer;
+	std::vector<VkCommandPool> worker_pools;
+	std::vector<VkCommandBuffer> worker_buffers;
+};
 
-// Possibly belongs in its own platform agnostic file
-struct Vertex {
-	glm::vec3 position;
-	glm::vec3 color;
-	glm::vec2 texture_coordinates;
+// Primary command buffers recorded once and replayed for as long as the draw list stays the same, so a
+// static scene costs nothing to record. The target image and descriptor set are baked in, so there is one
+// per swap chain image and frame in flight, indexed image_index * MAX_FRAMES_IN_FLIGHT + current_frame.
+struct CommandBufferCache {
+	VkCommandPool pool;
+	std::vector<VkCommandBuffer> buffers;
+	std::vector<uint64_t> keys; // draw list each buffer was recorded with, 0 when it needs recording
+	uint64_t last_draw_list_key = 0;
+};
+
+// Where a frame is drawn. The scene goes into the top left render_extent of the scene framebuffer, which is
+// then scaled up to cover the whole of image, see dynamic_resolution.h
+struct FrameTarget {
+	VkFramebuffer framebuffer; // scene color and depth
+	VkImage scene_image;
+	VkExtent2D render_extent;
+	VkImage image; // swap chain or offscreen image
+	VkExtent2D extent;
+	VkImageLayout final_layout; // present source, or transfer source when headless
+};
 
-	bool operator==(const Vertex& other) const {
-		return position == other.position && color == other.color && texture_coordinates == other.texture_coordinates;
-	}
+// Queries the frame's primary command buffer writes, baked into cached buffers along with everything else
+struct FrameQueries {
+	VkQueryPool timestamp_pool;
+	uint32_t timestamp_query; // GPU_ZONE_NONE when not profiling
+	VkQueryPool statistics_pool; // null when not collecting pipeline statistics
+	uint32_t first_statistics_query; // query of draw item 0
 };
 
-namespace std {
-	template<> struct hash<Vertex> {
-		size_t operator()(Vertex const& vertex) const {
-			return ((hash<glm::vec3>()(vertex.position) ^
-				(hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
-				(hash<glm::vec2>()(vertex.texture_coordinates) << 1);
-		}
-	};
-}
-
-struct UniformBufferObject {
-	glm::mat4 model;
-	glm::mat4 view;
-	glm::mat4 proj;
+// Accumulated separately for each frames in flight count so they can be compared. Time spent blocked on
+// the timeline is time the CPU wasn't running ahead of the GPU, so overlap is 1 - GPU wait / frame time.
+struct FramePacingStats {
+	uint64_t frame_count = 0;
+	double frame_seconds = 0.0;
+	double gpu_wait_seconds = 0.0;
 };
 
 struct QueueFamilyIndices {
@@ -110,12 +160,13 @@ struct Vulkan {
 	VkDevice device;
 	VkQueue graphics_queue;
 	VkQueue present_queue;
-	VkSurfaceKHR surface;
-	VkSwapchainKHR swap_chain;
+	VkSurfaceKHR surface = VK_NULL_HANDLE; // stays null when headless
+	VkSwapchainKHR swap_chain = VK_NULL_HANDLE;
 	std::vector<VkImage> swap_chain_images;
 	VkFormat swap_chain_format;
 	VkExtent2D swap_chain_extent;
 	std::vector<VkImageView> swap_chain_image_views;
+	SwapChainSupportInfo swap_chain_support; // refilled on every recreation, reusing its storage
 	VkPipeline graphics_pipeline;
 	VkRenderPass render_pass;
 	VkDescriptorSetLayout descriptor_set_layout;
@@ -125,9 +176,9 @@ struct Vulkan {
 	std::vector<VkDeviceMemory> uniform_buffers_memory;
 	std::vector<void*> uniform_buffers_mapped;
 	VkPipelineLayout pipeline_layout;
-	std::vector<VkFramebuffer> swap_chain_framebuffers;
-	VkCommandPool command_pool;
-	std::vector<VkCommandBuffer> command_buffers;
+	VkCommandPool command_pool; // one off upload commands
+	std::vector<FrameCommandPools> frame_command_pools;
+	CommandBufferCache command_buffer_cache;
 	VkDescriptorPool descriptor_pool;
 	std::vector<VkDescriptorSet> descriptor_sets;
 	VkImage texture_image;
@@ -137,83 +188,165 @@ struct Vulkan {
 	VkImage depth_image;
 	VkDeviceMemory depth_image_memory;
 	VkImageView depth_image_view;
+
+	// The scene is rendered into part of this and scaled up into the swap chain image. It and the depth image
+	// can be larger than the swap chain, they are kept when the window shrinks
+	VkImage scene_image;
+	VkDeviceMemory scene_image_memory;
+	VkImageView scene_image_view;
+	VkFramebuffer scene_framebuffer; // swap chain sized
+	VkExtent2D render_target_extent;
+	DynamicResolution dynamic_resolution;
+	VkExtent2D render_extent; // the part of the scene image drawn into
+
+	// Headless renders into these instead of swap chain images. They are stored in swap_chain_images so
+	// everything downstream of the images is shared, only acquire and present differ
+	bool headless = false;
+	std::vector<VkDeviceMemory> offscreen_images_memory;
+	uint32_t next_offscreen_image = 0;
+	uint32_t last_image_index = 0; // the image the latest draw_frame rendered to
+	DeletionQueue deletion_queue;
 	
 	std::vector<VkSemaphore> image_available_semaphores;
 	std::vector<VkSemaphore> render_finished_semaphores;
-	std::vector<VkFence> in_flight_fences;
+	Timeline timeline;
+	std::vector<uint64_t> frame_timeline_values; // value each frame slot last signaled, 0 if never submitted
+	std::vector<FrameArena> frame_arenas; // scratch memory for one frame, reset once the slot's timeline value is reached
 
 	bool framebuffer_resized = false;
 	uint32_t current_frame = 0;
+	uint32_t frames_in_flight = 2;
+	uint32_t recording_thread_count = 1;
+	std::unique_ptr<JobSystem> jobs; // behind a pointer so Vulkan stays movable
+	std::array<FramePacingStats, MAX_FRAMES_IN_FLIGHT + 1> frame_pacing_stats;
+	std::chrono::steady_clock::time_point last_frame_start;
+
+	PresentPolicy present_policy = PRESENT_POLICY_MAILBOX;
+	bool wait_before_acquire = false;
+	bool frame_paced = false; // pace_frame has already waited for the frame about to be drawn
+	double pacing_wait_seconds = 0.0;
+	LatencyTracker latency;
+	FrameTimings last_frame_timings; // CPU time of each draw_frame phase, for the benchmark
+	GpuProfiler gpu_profiler;
+	PipelineStatistics pipeline_statistics;
+
+	TransformHierarchy transforms;
+	uint32_t model_node; // the whole loaded model is a single root node for now
 
 	std::vector<Vertex> vertices;
 	std::vector<uint32_t> indices;
 	VkBuffer vertex_buffer;
 	VkDeviceMemory vertex_buffer_memory;
+
+	// CPU occlusion culling. Occluders are simplified meshes (room walls etc.) loaded next to the model, when
+	// there are none the draw items are still frustum culled against the empty buffer.
+	std::vector<DrawItem> draw_items;
+	std::vector<OccluderMesh> occluders;
+	OcclusionBuffer occlusion_buffer;
+	std::vector<OcclusionBox> occludee_bounds;
+	std::vector<uint32_t> visible_draw_items;
 };
 
-Vulkan init_vulkan(HINSTANCE hinst, HWND hwnd);
+Vulkan init_vulkan(const Platform& platform, const Settings& settings);
+void create_frame_resources(Vulkan& vulkan);
+void destroy_frame_resources(Vulkan& vulkan);
+void set_frames_in_flight(Vulkan& vulkan, uint32_t frames_in_flight);
+void report_frame_pacing(const Vulkan& vulkan);
+RecreateSwapChainResult set_present_policy(Vulkan& vulkan, const Platform& platform, PresentPolicy present_policy, bool wait_before_acquire);
+bool pace_frame(Vulkan& vulkan);
+void replace_model(Vulkan& vulkan, const std::string& path);
 void enable_validation_layers();
-VkInstance create_instance();
-VkSurfaceKHR create_surface(VkInstance instance, HWND hwnd, HINSTANCE hinst);
+VkInstance create_instance(bool headless);
+VkSurfaceKHR create_surface(VkInstance instance, const Platform& platform);
 VkPhysicalDevice create_physical_device(VkInstance instance, VkSurfaceKHR surface);
 VkDevice create_logical_device(VkPhysicalDevice physical_device, VkSurfaceKHR surface, VkQueue& graphics_queue, VkQueue& present_queue);
-VkSwapchainKHR create_swap_chain(VkPhysicalDevice physical_device, VkSurfaceKHR surface, VkDevice device, IVec2 window_size,
-	std::vector<VkImage>& out_images, VkFormat& out_format, VkExtent2D& out_extent);
-std::vector<VkImageView> create_swap_chain_image_views(std::vector<VkImage>& images, VkFormat format, VkDevice device);
-VkRenderPass create_render_pass(VkFormat swap_chain_image_format, VkDevice device, VkPhysicalDevice physical_device);
+VkSwapchainKHR create_swap_chain(VkPhysicalDevice physical_device, VkSurfaceKHR surface, VkDevice device, IVec2 window_size, PresentPolicy present_policy,
+	VkSwapchainKHR old_swap_chain, SwapChainSupportInfo& swap_chain_support, std::vector<VkImage>& out_images, VkFormat& out_format, VkExtent2D& out_extent);
+void create_offscreen_images(VkDevice device, VkPhysicalDevice physical_device, IVec2 size, std::vector<VkImage>& out_images,
+	std::vector<VkDeviceMemory>& out_images_memory, VkFormat& out_format, VkExtent2D& out_extent);
+void create_swap_chain_image_views(std::vector<VkImage>& images, VkFormat format, VkDevice device, std::vector<VkImageView>& out_image_views);
+VkRenderPass create_render_pass(VkFormat swap_chain_image_format, VkImageLayout final_layout, VkDevice device, VkPhysicalDevice physical_device);
 VkDescriptorSetLayout create_descriptor_set_layout(VkDevice device);
 VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D swap_chain_extent, VkRenderPass render_pass, VkPipelineLayout& out_layout, VkDescriptorSetLayout descriptor_set_layout);
 VkShaderModule create_shader_module(const std::vector<char>& code, VkDevice device);
-std::vector<VkFramebuffer> create_framebuffers(std::vector<VkImageView>& swap_chain_image_views, VkImageView depth_image_view, VkRenderPass render_pass, VkExtent2D swap_chain_extent, VkDevice device);
-VkCommandPool create_command_pool(VkPhysicalDevice physical_device, VkSurfaceKHR surface, VkDevice device);
+VkFramebuffer create_scene_framebuffer(VkImageView scene_image_view, VkImageView depth_image_view, VkRenderPass render_pass, VkExtent2D swap_chain_extent, VkDevice device);
+VkCommandPool create_command_pool(VkPhysicalDevice physical_device, VkSurfaceKHR surface, VkDevice device, VkCommandPoolCreateFlags flags);
 VkBuffer create_vertex_buffer(std::vector<Vertex>& vertices, VkDevice device, VkPhysicalDevice physical_device, 
-	VkDeviceMemory& out_buffer_memory, VkCommandPool command_pool, VkQueue graphics_queue);
+	VkDeviceMemory& out_buffer_memory, VkCommandPool command_pool, VkQueue graphics_queue, Timeline& timeline, DeletionQueue& deletion_queue, GpuProfiler& profiler);
 VkBuffer create_index_buffer(std::vector<uint32_t>& indices, VkDevice device, VkPhysicalDevice physical_device, VkCommandPool command_pool, 
-	VkQueue graphics_queue, VkDeviceMemory& out_buffer_memory);
-void create_uniform_buffers(VkDevice device, VkPhysicalDevice physical_device, std::vector<VkBuffer>& out_uniform_buffers, std::vector<VkDeviceMemory>& out_uniform_buffers_memory,
+	VkQueue graphics_queue, Timeline& timeline, DeletionQueue& deletion_queue, GpuProfiler& profiler, VkDeviceMemory& out_buffer_memory);
+void create_uniform_buffers(VkDevice device, VkPhysicalDevice physical_device, uint32_t frame_count, std::vector<VkBuffer>& out_uniform_buffers, std::vector<VkDeviceMemory>& out_uniform_buffers_memory,
 	std::vector<void*>& out_uniform_buffers_mapped);
 VkDescriptorPool create_descriptor_pool(VkDevice device);
 std::vector<VkDescriptorSet> create_descriptor_sets(VkDescriptorSetLayout descriptor_set_layout, VkDescriptorPool descriptor_pool,
-	VkDevice device, std::vector<VkBuffer>& uniform_buffers, VkImageView texture_image_view, VkSampler texture_sampler);
-std::vector<VkCommandBuffer> create_command_buffers(VkCommandPool command_pool, VkDevice device);
+	VkDevice device, std::vector<VkBuffer>& uniform_buffers, VkImageView texture_image_view, VkSampler texture_sampler, uint32_t frame_count);
+CommandBufferCache create_command_buffer_cache(VkPhysicalDevice physical_device, VkSurfaceKHR surface, VkDevice device, size_t image_count);
+void resize_command_buffer_cache(CommandBufferCache& cache, VkDevice device, size_t image_count);
+void invalidate_command_buffer_cache(CommandBufferCache& cache);
+uint64_t hash_draw_list(const std::vector<uint32_t>& visible_draw_items);
+std::vector<FrameCommandPools> create_frame_command_pools(VkPhysicalDevice physical_device, VkSurfaceKHR surface, VkDevice device, uint32_t frame_count, uint32_t worker_count);
 void create_depth_resources(VkDevice device, VkPhysicalDevice physical_device, VkExtent2D swap_chain_extent,
 	VkImage& out_depth_image, VkDeviceMemory& out_depth_image_memory, VkImageView& out_depth_image_view);
-void create_texture_image(VkDevice device, VkPhysicalDevice physical_device, VkImage& out_image,
-	VkDeviceMemory& out_image_memory, VkCommandPool command_pool, VkQueue graphics_queue);
+void create_scene_resources(VkDevice device, VkPhysicalDevice physical_device, VkExtent2D swap_chain_extent, VkFormat format,
+	VkImage& out_scene_image, VkDeviceMemory& out_scene_image_memory, VkImageView& out_scene_image_view);
+bool is_filtered_blit_supported(VkPhysicalDevice physical_device, VkFormat format);
+void create_texture_image(VkDevice device, VkPhysicalDevice physical_device, const TexturePixels& texture, VkImage& out_image,
+	VkDeviceMemory& out_image_memory, VkCommandPool command_pool, VkQueue graphics_queue, Timeline& timeline, GpuProfiler& profiler);
 VkImageView create_texture_image_view(VkDevice device, VkImage texture_image);
 VkSampler create_texture_sampler(VkDevice device, VkPhysicalDevice physical_device);
-void create_sync_objects(VkDevice device, std::vector<VkSemaphore>& image_available_semaphores, std::vector<VkSemaphore>& render_finished_semaphores, std::vector<VkFence>& in_flight_fences);
+void create_sync_objects(VkDevice device, uint32_t frame_count, std::vector<VkSemaphore>& image_available_semaphores, std::vector<VkSemaphore>& render_finished_semaphores);
 
-void record_command_buffer(VkCommandBuffer command_buffer, uint32_t image_index, VkRenderPass render_pass,
-	std::vector<VkFramebuffer>& swap_chain_framebuffers, VkExtent2D swap_chain_extent, VkPipeline graphics_pipeline,
+void record_command_buffer(FrameCommandPools& frame_pools, const FrameTarget& target, VkRenderPass render_pass, VkPipeline graphics_pipeline,
 	VkBuffer vertex_buffer, VkBuffer index_buffer, VkPipelineLayout pipeline_layout, std::vector<VkDescriptorSet>& descriptor_sets,
-	std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t current_frame);
-DrawFrameResult draw_frame(Vulkan& vulkan, HWND hwnd, double cam_position);
-void update_uniform_buffer(uint32_t current_image, VkExtent2D swap_chain_extent, std::vector<void*>& uniform_buffers_mapped, double cam_position);
-RecreateSwapChainResult recreate_swap_chain(Vulkan& vulkan, HWND hwnd);
+	std::vector<DrawItem>& draw_items, std::vector<uint32_t>& visible_draw_items, uint32_t current_frame, const FrameQueries& queries, JobSystem& jobs);
+void record_cached_command_buffer(VkCommandBuffer command_buffer, VkRenderPass render_pass, const FrameTarget& target,
+	VkPipeline graphics_pipeline, VkBuffer vertex_buffer, VkBuffer index_buffer, VkPipelineLayout pipeline_layout, VkDescriptorSet descriptor_set,
+	std::vector<DrawItem>& draw_items, std::vector<uint32_t>& visible_draw_items, const FrameQueries& queries);
+void begin_main_render_pass(VkCommandBuffer command_buffer, VkRenderPass render_pass, VkFramebuffer framebuffer, VkExtent2D render_extent,
+	VkSubpassContents contents);
+void record_upscale(VkCommandBuffer command_buffer, const FrameTarget& target);
+void record_secondary_command_buffer(VkCommandBuffer command_buffer, VkRenderPass render_pass, VkFramebuffer framebuffer, VkExtent2D render_extent,
+	VkPipeline graphics_pipeline, VkBuffer vertex_buffer, VkBuffer index_buffer, VkPipelineLayout pipeline_layout, VkDescriptorSet descriptor_set,
+	std::vector<DrawItem>& draw_items, const uint32_t* first_draw, const uint32_t* last_draw, const FrameQueries& queries);
+void record_draw_commands(VkCommandBuffer command_buffer, VkExtent2D render_extent, VkPipeline graphics_pipeline, VkBuffer vertex_buffer,
+	VkBuffer index_buffer, VkPipelineLayout pipeline_layout, VkDescriptorSet descriptor_set, std::vector<DrawItem>& draw_items,
+	const uint32_t* first_draw, const uint32_t* last_draw, const FrameQueries& queries);
+DrawFrameResult draw_frame(Vulkan& vulkan, const SceneSnapshot& scene);
+VkCommandBuffer get_frame_command_buffer(Vulkan& vulkan, uint32_t image_index);
+FrameTarget get_frame_target(const Vulkan& vulkan, uint32_t image_index);
+void update_render_extent(Vulkan& vulkan);
+FrameQueries get_frame_queries(const Vulkan& vulkan);
+UniformBufferObject update_uniform_buffer(uint32_t current_image, VkExtent2D swap_chain_extent, std::vector<void*>& uniform_buffers_mapped, const SceneSnapshot& scene,
+	TransformHierarchy& transforms, uint32_t model_node, std::chrono::steady_clock::time_point now);
+void cull_draw_items(Vulkan& vulkan, const UniformBufferObject& ubo);
+RecreateSwapChainResult recreate_swap_chain(Vulkan& vulkan, const Platform& platform);
 
 QueueFamilyIndices get_queue_families(const VkPhysicalDevice device, VkSurfaceKHR surface);
 bool queue_families_validated(QueueFamilyIndices indices);
-SwapChainSupportInfo get_swap_chain_support(VkPhysicalDevice device, VkSurfaceKHR surface);
+void get_swap_chain_support(VkPhysicalDevice device, VkSurfaceKHR surface, SwapChainSupportInfo& out_info);
 int rate_device_suitability(VkPhysicalDevice device, VkSurfaceKHR surface);
+bool is_device_extension_supported(VkPhysicalDevice device, const char* extension_name);
 VkFormat find_supported_format(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features, VkPhysicalDevice physical_device);
 VkFormat find_depth_format(VkPhysicalDevice physical_device);
 uint32_t get_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties, VkPhysicalDevice physical_device);
-VkBuffer create_vulkan_buffer(VkDevice device, VkPhysicalDevice physical_device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkDeviceMemory& out_buffer_memory);
-void copy_vulkan_buffer(VkBuffer src, VkBuffer dst, VkDeviceSize size, VkDevice device, VkCommandPool command_pool, VkQueue graphics_queue);
+VkBuffer create_vulkan_buffer(VkDevice device, VkPhysicalDevice physical_device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+	MemoryCategory category, VkDeviceMemory& out_buffer_memory);
+void copy_vulkan_buffer(VkBuffer src, VkBuffer dst, VkDeviceSize size, VkAccessFlags dst_access, VkPipelineStageFlags dst_stage, VkDevice device,
+	VkCommandPool command_pool, VkQueue graphics_queue, Timeline& timeline, DeletionQueue& deletion_queue, GpuProfiler& profiler);
 void create_vulkan_image(uint32_t width, uint32_t height, VkDevice device, VkPhysicalDevice physical_device, VkFormat format, VkImageTiling tiling,
-	VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& out_image, VkDeviceMemory& out_image_memory);
+	VkImageUsageFlags usage, VkMemoryPropertyFlags properties, MemoryCategory category, VkImage& out_image, VkDeviceMemory& out_image_memory);
 VkImageView create_vulkan_image_view(VkImage image, VkFormat format, VkImageAspectFlags aspect_flags, VkDevice device);
 void transition_image_layout(VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout,
-	VkCommandPool command_pool, VkDevice device, VkQueue graphics_queue);
+	VkCommandPool command_pool, VkDevice device, VkQueue graphics_queue, Timeline& timeline);
 void copy_buffer_to_image(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height,
-	VkCommandPool command_pool, VkDevice device, VkQueue graphics_queue);
+	VkCommandPool command_pool, VkDevice device, VkQueue graphics_queue, Timeline& timeline, GpuProfiler& profiler);
 VkCommandBuffer begin_single_time_commands(VkCommandPool command_pool, VkDevice device);
-void end_single_time_commands(VkCommandBuffer command_buffer, VkQueue graphics_queue, VkDevice device, VkCommandPool command_pool);
-void load_model(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+uint64_t submit_single_time_commands(VkCommandBuffer command_buffer, VkQueue graphics_queue, Timeline& timeline);
+void end_single_time_commands(VkCommandBuffer command_buffer, VkQueue graphics_queue, Timeline& timeline, VkDevice device, VkCommandPool command_pool);
 
-void cleanup_swap_chain(VkDevice device, std::vector<VkFramebuffer>& framebuffers, std::vector<VkImageView>& image_views, VkSwapchainKHR swap_chain,
-	VkImageView depth_image_view, VkImage depth_image, VkDeviceMemory depth_image_memory);
+void cleanup_swap_chain(VkDevice device, VkFramebuffer scene_framebuffer, std::vector<VkImageView>& image_views, VkSwapchainKHR swap_chain,
+	VkImageView depth_image_view, VkImage depth_image, VkDeviceMemory depth_image_memory, VkImageView scene_image_view, VkImage scene_image,
+	VkDeviceMemory scene_image_memory);
 void cleanup_vulkan(Vulkan& vulkan);
 
 static VkVertexInputBindingDescription get_vertex_binding_description();